@@ -2,25 +2,41 @@
 #define CRYPTID_BOTTLES_H
 
 #include <functional>
-#include <map>
 #include <vector>
 #include <Adafruit_SleepyDog.h>
 #include <WiFiNINA.h>
 #include <MQTT_Looped.h>
 #include "src/def.h"
 #include "src/color.h"
+#include "src/colorbench.h"
 #include "src/control.h"
+#include "src/layout.h"
+#include "src/palette.h"
 #include "src/pxl8.h"
 #include "src/bottle.h"
 #include "src/voltage.h"
+#include "src/memory.h"
+#include "src/governor.h"
+#include "src/frame.h"
+#include "src/log.h"
+#include "src/spatial.h"
+#include "src/stream.h"
+#include "src/sweep.h"
+#include "src/network.h"
+#include "src/noise.h"
+#include "src/timesync.h"
+#include "src/tween.h"
+#include "src/whitebalance.h"
+#include "src/zone.h"
+#include "src/tick.h"
 #include "wifi-config.h"
 
-// Instead of using a timer, these approximations ensure the
-// same delay between actions. This means things don't execute
-// as precicely on schedule, but the animation is, in theory,
-// smoother.
-#define every_n_seconds(n, offset) if (loopCounter % (MAX_FPS * n) == offset)
-#define every_n_loops(n, offset) if (loopCounter % n == offset)
+// Instead of using a timer, these run on the first frame after
+// each interval passes. This means things don't execute as
+// precicely on schedule, but the animation is, in theory,
+// smoother. Offsets are in frames at MAX_FPS, to stagger actions.
+#define every_n_seconds(n, offset) if (intervalPassed((n) * 1000UL, (offset) * 1000UL / MAX_FPS))
+#define every_n_loops(n, offset) if (frame.index % n == offset)
 
 /**
  * @brief Call if fatal crash.
@@ -32,9 +48,74 @@ void err(uint32_t ledColor = 0xFF0000);
  */
 void ledStatus(status_t status);
 
+/**
+ * @brief Add a bottle. Call during setup, before the pixel driver starts.
+ *
+ * @param pin Pin index (not id on board)
+ * @param startPixel First pixel on strand that belongs to this bottle.
+ * @param length Number of pixels on strand.
+ */
+void addBottle(uint8_t pin, uint16_t startPixel, uint16_t length);
+
+/**
+ * @brief Render each bottle of a batch due this frame: all of them, or when interlaced, every nth
+ *        in rotation.
+ *
+ * @param batch
+ * @param frame
+ * @param render called with each bottle and its zone
+ */
+template<typename F>
+inline void renderBottles(const effect_batch_t& batch, const FrameContext& frame, F render) {
+  for (size_t i = frame.index % frame.interlace; i < batch.count; i += frame.interlace) {
+    render(batch.bottles[i], batch.zones[i]);
+  }
+}
+
+/**
+ * @brief Palette an effect draws from.
+ *
+ * @param animation
+ * @return palette, or nullptr for an effect that sets colors directly
+ */
+const Palette* effectPalette(bottle_animation_t animation);
+
+/**
+ * @brief Render an effect in the bottles running it.
+ *
+ * @param batch
+ * @param outgoing Whether it's the effect fading out, drawn to its own layer and leaving glow
+ *                 changes and faeries to the current effect.
+ */
+void renderEffect(const effect_batch_t& batch, bool outgoing);
+
+/**
+ * @brief Frame interval for a plan: that of its fastest effect, or the one given if faster. Static
+ *        effects can afford the extra frames.
+ *
+ * @param plan
+ * @param interval us, or 0 for none
+ * @return us, or 0 if every zone is off
+ */
+uint32_t planInterval(const ZonePlan& plan, uint32_t interval);
+
+/**
+ * @brief Run the next startup stage. Called each frame until startup is done.
+ */
+void startupStep(void);
+
 void setup(void);
 void loop(void);
 
+/**
+ * @brief Whether an interval boundary passed between the previous frame and this one.
+ *
+ * @param interval ms
+ * @param offset ms
+ * @return bool
+ */
+bool intervalPassed(uint32_t interval, uint32_t offset);
+
 /**
  * @brief Calculate SRAM free.
  *
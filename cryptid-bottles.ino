@@ -7,17 +7,51 @@
 // GLOBALS -----------------------------------------------------------------------------------------
 
 Pxl8 pxl8;
-MQTT_Looped interwebs(new WiFiClient(), WIFI_SSID, WIFI_PASS,
-  new IPAddress(MQTT_SERVER), 1883, MQTT_USER, MQTT_PASS, MQTT_CLIENT_ID);
+WiFiClient wifiClient;
+IPAddress mqttServer(MQTT_SERVER);
+MQTT_Looped interwebs(&wifiClient, WIFI_SSID, WIFI_PASS,
+  &mqttServer, 1883, MQTT_USER, MQTT_PASS, MQTT_CLIENT_ID);
 std::vector<Bottle*> bottles = {};
-Control control(&pxl8, &interwebs, &bottles);
+#ifdef STATIC_ALLOC
+StaticPool<Bottle, MAX_BOTTLES> bottlePool;
+#endif
+RandomStreams randomStreams;
+SpatialMap spatialMap;
+Sweep sweep(&pxl8, &spatialMap);
+// Bottles grouped by effect: the plan shown, and while switching, the one fading out.
+ZonePlan zonePlans[2];
+uint8_t planShown = 0;
+TweenPool tweens;
+Control control(&pxl8, &interwebs, &bottles, &randomStreams, &tweens);
 Adafruit_NeoPixel statusLED(1, 8, NEO_GRB + NEO_KHZ800);
 VoltageMonitor voltageMonitor;
+Governor governor;
+FrameContext frame(&randomStreams.get(RANDOM_FRAME), &tweens);
+#ifdef PERSIST_STATE
+FlashStoreBackend flashStore;
+StateStore stateStore(&flashStore);
+#endif
+#ifdef FRAME_STREAM
+FrameStream frameStream(&pxl8, &interwebs, &bottles);
+#endif
+#ifdef NETWORK_PIXELS
+NetworkPixels networkPixels(&pxl8, &bottles);
+#endif
+TimeSync timeSync(&interwebs);
+FrameTick frameTick;
+// FPS throttle: when the last frame started, in us.
+uint32_t prevMicros = 0;
+Palette rainbowPalette;
+Palette rainPalette;
+Palette whitePalette;
+startup_stage_t startupStage = STARTUP_PIXELS;
+bool networkReady = false;
 
 // STATUS LEDS -------------------------------------------------------------------------------------
 
 void err(uint32_t ledColor) {
-  Serial.println(F("FATAL ERROR"));
+  LOG(FATAL, ledColor);
+  logFlush();
   uint32_t c;
   for (;;) {
     c = 0;
@@ -57,217 +91,485 @@ void ledStatus(status_t status) {
 
 // SETUP -------------------------------------------------------------------------------------------
 
+void addBottle(uint8_t pin, uint16_t startPixel, uint16_t length) {
+#ifdef STATIC_ALLOC
+  Bottle* bottle = bottlePool.create(&pxl8, pin, startPixel, length, BOARD_BOTTLE_OFFSET + bottles.size());
+  if (bottle == nullptr) {
+    LOG(TOO_MANY_BOTTLES);
+    err(0xFF0000);
+  }
+#else
+  Bottle* bottle = new Bottle(&pxl8, pin, startPixel, length, BOARD_BOTTLE_OFFSET + bottles.size());
+#endif
+  bottles.push_back(bottle);
+}
+
 void setup(void) {
   Serial.begin(9600);
   // Wait for serial port to open.
   // while (!Serial) delay(10);
-  Serial.println(F("Starting..."));
-
-  // Configure WiFi featherwing.
-  WiFi.setPins(SPIWIFI_SS, SPIWIFI_ACK, ESP32_RESETN, ESP32_GPIO0, &SPIWIFI);
-
-  Serial.println(F("Reading voltage monitor..."));
-  if (!voltageMonitor.begin()) {
-    Serial.println(F("Failed to find INA219 chip"));
-    err(0xFF6000);
-  }
-  // By default the INA219 will be calibrated with a range of 32V, 2A.
-  // However uncomment one of the below to change the range.  A smaller
-  // range can't measure as large of values but will measure with slightly
-  // better precision.
-  // voltageMonitor.setCalibration_32V_1A();
-  // voltageMonitor.setCalibration_16V_400mA();
+  LOG(STARTING);
 
+#ifdef RANDOM_SEED
+  randomStreams.seed(RANDOM_SEED);
+#else
   // Seed by reading unused anolog pin.
-  randomSeed(analogRead(A0));
+  randomStreams.seed(analogRead(A0));
+#endif
 
   statusLED.begin();
   statusLED.setBrightness(64);
 
-  // Bottles !! Config pin, start, and length according to hardware !!
-  Serial.println(F("Setting up LEDs..."));
-  //                                 pin  1st  len
-  bottles.push_back(new Bottle(&pxl8,  0,   0,  25));
-  bottles.push_back(new Bottle(&pxl8,  0,  25,  25));
-  bottles.push_back(new Bottle(&pxl8,  1,   0,  20));
-  bottles.push_back(new Bottle(&pxl8,  1,  20,  30));
+  // Bottles, as laid out in src/layout.h.
+  LOG(SETTING_UP_LEDS);
+  // Reserve once so the vector never grows after setup.
+  bottles.reserve(LAYOUT_BOTTLES);
+  for (auto const& b : BOTTLE_LAYOUT) {
+    addBottle(b.pin, b.start, b.length);
+  }
+  // Where every pixel is, shared by effects that span bottles.
+  spatialMap.begin();
+  for (size_t i = 0; i < bottles.size(); i++) {
+    bottles[i]->setCoords(spatialMap.bottle(i));
+    bottles[i]->setWhiteOffset(BOTTLE_LAYOUT[i].wbOffset);
+  }
+  // Palettes for effects that render by palette index.
+  rainbowPalette.hues();
+  rainPalette.ramp(rgb_t{ 2, 160, 255 });
+  whitePalette.whites();
+
+  Random& r = randomStreams.get(RANDOM_GLOW);
   for (auto & bottle : bottles) {
-    uint16_t hs = random(0, 360);
-    bottle->setHue(hs, hs + random(30, 40));
-    bottle->setColor(control.getRandomWhiteBalance());
+    uint16_t hs = r.range(0, 360);
+    bottle->setHue(hs, hs + r.range(30, 40));
+    bottle->setWhiteBalance(control.getRandomWhiteBalance());
   };
 
+#ifdef PERSIST_STATE
+  // Restore the last state before the network is up.
+  if (stateStore.begin()) {
+    control.restore(&stateStore);
+  } else {
+    LOG(STATE_STORE_FAILED);
+  }
+#endif
+
+#ifdef NOISE_BENCHMARK
+  noiseBenchmark();
+#endif
+#ifdef COLOR_BENCHMARK
+  colorBenchmark();
+#endif
+
+  // Bottles grouped by their zone's effect, shown from the first frame without a fade.
+  zonePlans[planShown].build(control.zones, bottles);
+  control.zonesChanged = false;
+
   // Start pixel driver. Call after bottle setup.
   if (!pxl8.init()) {
-    Serial.println(F("Error starting NeoPXL8"));
+    LOG(PXL8_START_FAILED);
     err(0xFF0000);
   }
   pxl8.setBrightness(control.brightness);
+  pxl8.setOverlay(OVERLAY_PARTICLES, 255, BLEND_NORMAL);
+  pxl8.setOverlay(OVERLAY_ALERTS, ALERT_OPACITY, BLEND_NORMAL);
+  governor.begin(pxl8.longestStrand());
+  frameTick.begin();
+
+  // Sensors and network start from loop(), after the first frame is shown.
+  frame.reset(millis());
+  control.resetTimers(frame.time);
+  // The first frame is timed from here, so the governor doesn't count setup() as dropped frames.
+  prevMicros = micros();
+}
 
-  // Check connection to WiFi board.
-  if (WiFi.status() == WL_NO_MODULE) {
-    Serial.println(F("Communication with WiFi module failed"));
-    err(0xFF0080);
+void startupStep(void) {
+  switch (startupStage) {
+    case STARTUP_PIXELS:
+      // The first frame was just shown.
+      if (millis() > STARTUP_FIRST_FRAME_MS) {
+        LOG(FIRST_FRAME_LATE, millis(), STARTUP_FIRST_FRAME_MS);
+      }
+      break;
+    case STARTUP_SENSORS:
+      LOG(READING_VOLTAGE);
+      control.power_telemetry = voltageMonitor.begin();
+      if (!control.power_telemetry) {
+        LOG(INA219_MISSING);
+      }
+      // By default the INA219 will be calibrated with a range of 32V, 2A.
+      // However uncomment one of the below to change the range.  A smaller
+      // range can't measure as large of values but will measure with slightly
+      // better precision.
+      // voltageMonitor.setCalibration_32V_1A();
+      // voltageMonitor.setCalibration_16V_400mA();
+      break;
+    case STARTUP_NETWORK:
+      // Configure WiFi featherwing.
+      WiFi.setPins(SPIWIFI_SS, SPIWIFI_ACK, ESP32_RESETN, ESP32_GPIO0, &SPIWIFI);
+      // Check connection to WiFi board. Without it, keep running offline.
+      if (WiFi.status() == WL_NO_MODULE) {
+        LOG(WIFI_MODULE_FAILED);
+        statusLED.setPixelColor(0, 0xFF0080);
+        statusLED.show();
+      } else {
+        // Set up MQTT callbacks, etc.
+        control.initMQTT();
+        timeSync.begin();
+#ifdef FRAME_STREAM
+        frameStream.begin();
+#endif
+        networkReady = true;
+      }
+      // Set reboot after hanging for 1s.
+      LOG(WATCHDOG, Watchdog.enable(1000));
+      // Everything after this point should run from memory already allocated.
+      heapLock();
+      break;
+    default:
+      return;
   }
+  control.startup_ms[startupStage] = millis();
+  LOG(STARTUP_STAGE, startupStage, millis());
+  startupStage = (startup_stage_t)(startupStage + 1);
+}
+
+// LOOP --------------------------------------------------------------------------------------------
 
-  // Set up MQTT callbacks, etc.
-  control.initMQTT();
+const Palette* effectPalette(bottle_animation_t animation) {
+  switch (animation) {
+    case BOTTLE_ANIMATION_RAINBOW:
+      return &rainbowPalette;
+    case BOTTLE_ANIMATION_RAIN:
+      return &rainPalette;
+    case BOTTLE_ANIMATION_TEST_WB:
+      return &whitePalette;
+    default:
+      return nullptr;
+  }
+}
 
-  // Set reboot after hanging for 1s.
-  int cd = Watchdog.enable(1000);
-  Serial.print("Watchdog enabled with ");
-  Serial.print(cd, DEC);
-  Serial.println(" ms countdown.");
+void renderEffect(const effect_batch_t& batch, bool outgoing) {
+  pxl8.drawOutgoing(outgoing);
+  pxl8.setPalette(effectPalette(batch.animation));
+  frame.interlace = governor.interlace(batch.animation);
+  switch (batch.animation) {
+    case BOTTLE_ANIMATION_DEFAULT:
+    case BOTTLE_ANIMATION_FAERIES:
+      if (!outgoing && control.shouldChangeGlow(frame, batch)) {
+        control.updateRandomBottleHue(frame, batch);
+      }
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->glow(frame);
+      });
+      if (!outgoing && control.shouldShowFaerie(frame)) {
+        control.showFaerie(frame, batch);
+      }
+      break;
+    case BOTTLE_ANIMATION_GLOW:
+      if (!outgoing && control.shouldChangeGlow(frame, batch)) {
+        control.updateRandomBottleHue(frame, batch);
+      }
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->glow(frame);
+      });
+      break;
+    case BOTTLE_ANIMATION_GLOW_W:
+      if (!outgoing && control.shouldChangeGlow(frame, batch)) {
+        control.updateRandomBottleWhiteBalance(frame, batch);
+      }
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->glowColor(frame);
+      });
+      break;
+    case BOTTLE_ANIMATION_NOISE:
+      if (!outgoing && control.shouldChangeGlow(frame, batch)) {
+        control.updateRandomBottleHue(frame, batch);
+      }
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->noise(frame);
+      });
+      break;
+    case BOTTLE_ANIMATION_NOISE_W:
+      if (!outgoing && control.shouldChangeGlow(frame, batch)) {
+        control.updateRandomBottleWhiteBalance(frame, batch);
+      }
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->noiseColor(frame);
+      });
+      break;
+    case BOTTLE_ANIMATION_SWEEP:
+      sweep.render(frame, batch.mask, control.zones);
+      break;
+    case BOTTLE_ANIMATION_RAIN:
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->rain(frame);
+      });
+      break;
+    case BOTTLE_ANIMATION_RAINBOW:
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->rainbow(frame);
+      });
+      break;
+    case BOTTLE_ANIMATION_ILLUM:
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t zone) {
+        const zone_t& z = control.zones[zone];
+        if (z.white) {
+          bottle->illuminateWhite(z.white);
+        } else {
+          bottle->illuminate(z.color);
+        }
+      });
+      break;
+    case BOTTLE_ANIMATION_OFF:
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->blank();
+      });
+      break;
+    case BOTTLE_ANIMATION_TEST_WB:
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->loopColors(frame, TEST_WB_STEPS);
+      });
+      break;
+    case BOTTLE_ANIMATION_TEST:
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->testBlink(frame);
+      });
+      break;
+#ifdef NETWORK_PIXELS
+    case BOTTLE_ANIMATION_NETWORK:
+      // Pixels stop arriving once switched away, so the last frame received fades out.
+      if (!outgoing) {
+        networkPixels.render(frame);
+      }
+      break;
+#endif
+    case BOTTLE_ANIMATION_WARNING:
+    default:
+      renderBottles(batch, frame, [](Bottle* bottle, uint8_t) {
+        bottle->warning(frame);
+      });
+  }
 }
 
-// LOOP --------------------------------------------------------------------------------------------
+uint32_t planInterval(const ZonePlan& plan, uint32_t interval) {
+  for (uint8_t i = 0; i < plan.size(); i++) {
+    if (plan[i].animation != BOTTLE_ANIMATION_OFF) {
+      uint32_t effect = governor.frameInterval(plan[i].animation);
+      interval = interval ? min(interval, effect) : effect;
+    }
+  }
+  return interval;
+}
 
-// FPS throttle.
-uint32_t prevMicros;
+// Whether the bottles have been shown blank since the lights went off.
+bool blankShown = false;
+
+// Crossfade to the current effect, 0-255, moved by a tween. 255 when not switching.
+int16_t effectFade = 255;
 
 // Speed check.
 uint32_t prevMillis = 0;
 
-// Counts up every frame for "every so often" items.
-// By starting at 0, actions are called the first loop as well.
-uint32_t loopCounter = 0;
-
 void loop(void) {
   Watchdog.reset();
 
-  // FPS Throttle.
-  uint32_t t;
-  while (((t = micros()) - prevMicros) < (1000000L / MAX_FPS));
+  // FPS Throttle. Sleeps until the frame is due; with the lights off, only ticks slowly.
+  // While switching, the plan fading out counts too, so a fade out of a fast effect stays smooth.
+  uint32_t interval = 0;
+  if (control.pixelsOn) {
+    uint32_t fadingOut = effectFade < 255 ? planInterval(zonePlans[planShown ^ 1], 0) : 0;
+    interval = planInterval(zonePlans[planShown], fadingOut);
+  }
+  if (interval == 0) interval = 1000000UL / IDLE_FPS;
+  uint32_t t = frameTick.wait(prevMicros, interval);
+  governor.frameStart(t - prevMicros, interval);
   prevMicros = t;
 
+  // Everything rendered this frame sees the same time, shared across boards.
+  uint32_t now = timeSync.now(millis());
+  if (timeSync.stepped) {
+    frame.reset(now);
+    control.resetTimers(frame.time);
+  }
+  frame.advance(now);
+  // Only values still fading cost anything.
+  tweens.update(frame.time);
+
   // ---------- Animation ----------
 
+  // Switching effects crossfades from whatever was showing. Both plans render until it's done.
+  if (control.zonesChanged) {
+    control.zonesChanged = false;
+    planShown ^= 1;
+    zonePlans[planShown].build(control.zones, bottles);
+#ifndef NO_CROSSFADE
+    if (control.pixelsOn) {
+      pxl8.beginCrossfade();
+      effectFade = 0;
+      tweens.to(&effectFade, 255, EFFECT_FADE_MS);
+    }
+#endif
+  }
+  const ZonePlan& plan = zonePlans[planShown];
+  const ZonePlan& fadePlan = zonePlans[planShown ^ 1];
+  if (!control.pixelsOn) {
+    tweens.cancel(&effectFade);
+    effectFade = 255;
+  }
+  bool fading = effectFade < 255;
+  pxl8.setCrossfade(effectFade);
+  // Only one palette is shown a frame.
+  pxl8.setIndexed(plan.size() == 1 && (!fading || fadePlan.size() == 1));
+
+  // Particles are redrawn each frame.
+  pxl8.clearOverlay(OVERLAY_PARTICLES);
+
+#ifdef NETWORK_PIXELS
+  if (!plan.uses(BOTTLE_ANIMATION_NETWORK) || !control.pixelsOn) {
+    networkPixels.end();
+  }
+#endif
   if (control.pixelsOn) {
-    switch (control.bottleAnimation) {
-      case BOTTLE_ANIMATION_DEFAULT:
-      case BOTTLE_ANIMATION_FAERIES:
-        if (control.shouldChangeGlow()) {
-          control.updateRandomBottleHue();
-        }
-        for (auto & bottle : bottles) {
-          bottle->glow();
-        };
-        if (control.shouldShowFaerie()) {
-          control.showFaerie();
-        }
-        break;
-      case BOTTLE_ANIMATION_GLOW:
-        if (control.shouldChangeGlow()) {
-          control.updateRandomBottleHue();
-        }
-        for (auto & bottle : bottles) {
-          bottle->glow();
-        };
-        break;
-      case BOTTLE_ANIMATION_GLOW_W:
-        if (control.shouldChangeGlow()) {
-          control.updateRandomBottleWhiteBalance();
-        }
-        for (auto & bottle : bottles) {
-          bottle->glowColor();
-        };
-        break;
-      case BOTTLE_ANIMATION_RAIN:
-        for (auto & bottle : bottles) {
-          bottle->rain();
-        };
-        break;
-      case BOTTLE_ANIMATION_RAINBOW:
-        for (auto & bottle : bottles) {
-          bottle->rainbow();
-        };
-        break;
-      case BOTTLE_ANIMATION_ILLUM:
-        for (auto & bottle : bottles) {
-          bottle->illuminate(control.static_color);
-        };
-        break;
-      case BOTTLE_ANIMATION_TEST_WB:
-        for (auto & bottle : bottles) {
-          bottle->loopColors(&WHITE_TEMPERATURES_VECTOR);
-        };
-        break;
-      case BOTTLE_ANIMATION_TEST:
-        for (auto & bottle : bottles) {
-          bottle->testBlink();
-        };
-        break;
-      case BOTTLE_ANIMATION_WARNING:
-      default:
-        for (auto & bottle : bottles) {
-          bottle->warning();
-        };
+    // Each effect once over its bottles. The plan fading out first, so the current effect's
+    // palette is the one shown.
+    if (fading) {
+      for (uint8_t i = 0; i < fadePlan.size(); i++) {
+        renderEffect(fadePlan[i], true);
+      }
+    }
+    for (uint8_t i = 0; i < plan.size(); i++) {
+      renderEffect(plan[i], false);
     }
   }
+#ifdef NETWORK_ALERTS
+  // Pulse over the effect while the network is down.
+  if (control.pixelsOn && networkReady && !interwebs.wifiIsConnected()) {
+    for (auto & bottle : bottles) {
+      bottle->warningWiFi(frame);
+    }
+  } else if (control.pixelsOn && networkReady && !interwebs.mqttIsConnected()) {
+    for (auto & bottle : bottles) {
+      bottle->warningMQTT(frame);
+    }
+  } else {
+    pxl8.clearOverlay(OVERLAY_ALERTS);
+  }
+#endif
+  uint32_t renderMicros = micros() - t;
 
-  // Push all pixel changes to bottles.
-  pxl8.show();
+  // Push all pixel changes to bottles. Once blank, there's nothing to push while off.
+  if (control.pixelsOn || !blankShown) {
+    pxl8.show();
+    blankShown = !control.pixelsOn;
+  }
+  control.frameShown(micros());
 
-  // ---------- Interwebs ----------
+#ifdef LOG_FRAME_HASH
+  LOG(FRAME_HASH, frame.index, pxl8.frameHash());
+#endif
+#ifdef FRAME_STREAM
+  frameStream.loop(frame.time);
+#endif
 
-  interwebs.loop();
+  // ---------- Startup ----------
 
-  if (!interwebs.wifiIsConnected()) {
-    ledStatus(STATUS_WIFI_OFFLINE);
-  } else if (!interwebs.mqttIsConnected()) {
-    ledStatus(STATUS_MQTT_OFFLINE);
-  } else if (interwebs.mqttIsActive()) {
-    ledStatus(STATUS_MQTT_ACTIVE);
-  } else {
-    ledStatus(STATUS_OK);
+  // One stage per frame, so the bottles keep animating while the rest starts.
+  if (startupStage != STARTUP_DONE) {
+    startupStep();
   }
 
-  every_n_seconds(STATE_UPDATE_INTERVAL, 10) {
-    control.mqttCurrentStatus();
-  }
-  every_n_seconds(STATE_UPDATE_INTERVAL, 20) {
-    control.mqttCurrentSensors();
+  // ---------- Interwebs ----------
+
+  if (networkReady) {
+    interwebs.loop();
+    timeSync.loop(millis());
+
+    if (!interwebs.wifiIsConnected()) {
+      ledStatus(STATUS_WIFI_OFFLINE);
+    } else if (!interwebs.mqttIsConnected()) {
+      ledStatus(STATUS_MQTT_OFFLINE);
+    } else if (interwebs.mqttIsActive()) {
+      ledStatus(STATUS_MQTT_ACTIVE);
+    } else {
+      ledStatus(STATUS_OK);
+    }
+
+    every_n_seconds(STATE_UPDATE_INTERVAL, 10) {
+      control.mqttCurrentStatus();
+    }
+    every_n_seconds(STATE_UPDATE_INTERVAL, 20) {
+      control.sensorsRequested = true;
+    }
+    if (control.sensorsRequested) {
+      control.target_fps = governor.targetFps();
+      control.dropped_frames = governor.droppedFrames();
+      control.interlace = governor.currentInterlace();
+      control.sleep_pct = frameTick.sleepPercent();
+#ifdef NETWORK_PIXELS
+      control.net_packets_lost = networkPixels.packetsLost;
+      control.net_latency = networkPixels.latency;
+#endif
+    }
+    control.loop(frame.time);
   }
 
   // ---------- System Operation ----------
 
   // Check memory available.
   every_n_seconds(MEMORY_MEASURE_INTERVAL, 30) {
-    Serial.print(F("Free Memory: "));
-    Serial.print(freeMemory() * 0.001f, 2);
-    Serial.println(F(" KB")); // 192KB total
+    LOG(FREE_MEMORY, freeMemory()); // 192KB total
+#ifdef STATIC_ALLOC
+    LOG(HEAP_USE, heapViolations());
+#endif
   }
 
+#ifdef PERSIST_STATE
+  // Save state once it settles.
+  control.persist(&stateStore, frame.time);
+  stateStore.loop(frame.time);
+#endif
+
   // Log power measurements.
-  every_n_seconds(POWER_MEASURE_INTERVAL, 40) {
-    control.last_bus_voltage = voltageMonitor.getBusVoltage_V();
-  }
-  every_n_seconds(POWER_MEASURE_INTERVAL, 45) {
-    control.last_shunt_voltage = voltageMonitor.getShuntVoltage_mV();
-  }
-  every_n_seconds(POWER_MEASURE_INTERVAL, 55) {
-    control.last_load_voltage = voltageMonitor.getLoadVoltage();
-  }
-  every_n_seconds(POWER_MEASURE_INTERVAL, 65) {
-    control.last_current = voltageMonitor.getCurrent_mA();
-    control.last_avg_current = voltageMonitor.getCurrentAvg_mA();
-  }
-  every_n_seconds(POWER_MEASURE_INTERVAL, 70) {
-    control.last_power = voltageMonitor.getPower_mW();
+  if (control.power_telemetry) {
+    every_n_seconds(POWER_MEASURE_INTERVAL, 40) {
+      control.last_bus_voltage = voltageMonitor.getBusVoltage_V();
+    }
+    every_n_seconds(POWER_MEASURE_INTERVAL, 45) {
+      control.last_shunt_voltage = voltageMonitor.getShuntVoltage_mV();
+    }
+    every_n_seconds(POWER_MEASURE_INTERVAL, 55) {
+      control.last_load_voltage = voltageMonitor.getLoadVoltage();
+    }
+    every_n_seconds(POWER_MEASURE_INTERVAL, 65) {
+      control.last_current = voltageMonitor.getCurrent_mA();
+      control.last_avg_current = voltageMonitor.getCurrentAvg_mA();
+    }
+    every_n_seconds(POWER_MEASURE_INTERVAL, 70) {
+      control.last_power = voltageMonitor.getPower_mW();
+    }
   }
 
   // Speed check.
   uint32_t m = millis();
   if (prevMillis != 0 && m > prevMillis) { // skips first, ignores millis() overflow
     uint32_t s = m - prevMillis;
-    if (s > SLOW_FRAME_LIMIT) {
-      Serial.print(F("Slow frame (ms): "));
-      Serial.println(String(s));
+    if (s > interval / 1000 + SLOW_FRAME_LIMIT) {
+      LOG(SLOW_FRAME, s);
     }
   }
   prevMillis = m;
 
-  loopCounter++;
+  uint32_t frameMicros = micros() - t;
+  control.worst_frame_us = max(control.worst_frame_us, frameMicros);
+  // A crossfade or a frame shared by effects says nothing about any one of them.
+  if (control.pixelsOn && !fading && plan.size() == 1) {
+    governor.record(plan[0].animation, renderMicros, frameMicros);
+  }
+}
+
+bool intervalPassed(uint32_t interval, uint32_t offset) {
+  return (frame.time - offset) / interval != (frame.time - frame.delta - offset) / interval;
 }
 
 #ifdef __arm__
@@ -1,91 +1,53 @@
 #include "bottle.h"
+#include "log.h"
 
-Bottle::Bottle(Pxl8 *pxl8, uint8_t pin, uint16_t startPixel, uint16_t length)
-  : pxl8(pxl8), pin(pin), startPixel(startPixel), length(length), lastPixel(startPixel + length - 1) {
+Bottle::Bottle(Pxl8 *pxl8, uint8_t pin, uint16_t startPixel, uint16_t length, uint16_t index)
+  : pxl8(pxl8), pin(pin), index(index), startPixel(startPixel), length(length), lastPixel(startPixel + length - 1) {
   pxl8->addStrand(pin, length);
-  Serial.println("Bottle of " + String(length) + " pixels on pin " + String(pin) + " added.");
+  LOG(BOTTLE_ADDED, length, pin);
 }
 
 void Bottle::setHue(uint16_t start, uint16_t end) {
-  start = normalizeHue(start);
-  end = normalizeHue(end);
-  hueRange = { start, end };
-  endHueRange = { start, end };
+  hueStart = normalizeHue(start);
+  hueEnd = hueStart + normalizeHue((int)end - (int)start);
 }
 
-void Bottle::setHue(uint16_t start, uint16_t end, uint32_t ms) {
-  hueFadeStartTime = millis();
-  hueFadeSpeed = ms;
-  startHueRange = hueRange;
-  endHueRange = { normalizeHue(start), normalizeHue(end) };
+void Bottle::setHue(const FrameContext& ctx, uint16_t start, uint16_t end, uint32_t ms) {
+  // Carry on from wherever a fade in progress is, with the start back between 0 and 359.
+  int16_t s = normalizeHue((int)hueStart);
+  hueEnd = s + normalizeHue((int)hueEnd - (int)hueStart);
+  hueStart = s;
+  // The start goes the short way round, widdershins if need be; the end keeps the new width.
+  int16_t d = normalizeHue((int)start) - s;
+  if (d > 180) {
+    d -= 360;
+  } else if (d < -180) {
+    d += 360;
+  }
+  ctx.tweens->to(&hueStart, s + d, ms);
+  ctx.tweens->to(&hueEnd, s + d + normalizeHue((int)end - (int)start), ms);
 }
 
-void Bottle::setColor(rgb_t newColor) {
-  color = newColor;
-  endColor = newColor;
+void Bottle::setWhiteBalance(white_balance_t mired) {
+  mired16 = mired << 4;
 }
 
-void Bottle::setColor(rgb_t newColor, uint32_t ms) {
-  colorFadeStartTime = millis();
-  colorFadeSpeed = ms;
-  startColor = color;
-  endColor = newColor;
+void Bottle::setWhiteBalance(const FrameContext& ctx, white_balance_t mired, uint32_t ms) {
+  // Mireds rather than RGB, so the fade passes through the whites between.
+  ctx.tweens->to(&mired16, mired << 4, ms);
 }
 
-void Bottle::updateHue() {
-  if (hueRange.first != endHueRange.first || hueRange.second != endHueRange.second) {
-    uint32_t d = millis() - hueFadeStartTime;
-    float percent = float(d) / hueFadeSpeed;
-    if (percent >= 1) {
-      hueRange = endHueRange;
-      return;
-    }
-    float s1 = startHueRange.first;
-    float s2 = startHueRange.second;
-    float e1 = endHueRange.first;
-    float e2 = endHueRange.second;
-    // adj looping around zero
-    if (s2 < s1) s2 += 360;
-    if (e2 < e1) e2 += 360;
-    // widdershins
-    if (e1 - s1 > 180) {
-      s1 += 360;
-      s2 += 360;
-    } else if (s1 - e1 > 180) {
-      e1 += 360;
-      e2 += 360;
-    }
-    hueRange.first = normalizeHue(s1 + (e1 - s1) * percent);
-    hueRange.second = normalizeHue(s2 + (e2 - s2) * percent);
-  }
+uint32_t Bottle::whiteColor(int32_t m) {
+  rgb_t rgb = unpackRGB(whiteBalanceColor(m + whiteOffset * 16));
+  return pxl8->color(rgb.r, rgb.g, rgb.b);
 }
 
-void Bottle::updateColor() {
-  if (color.r != endColor.r || color.g != endColor.g || color.b != endColor.b) {
-    uint32_t d = millis() - colorFadeStartTime;
-    float percent = float(d) / colorFadeSpeed;
-    if (percent >= 1) {
-      color = endColor;
-      return;
-    }
-    color.r = normalizeRGB(startColor.r + float(endColor.r - startColor.r) * percent);
-    color.g = normalizeRGB(startColor.g + float(endColor.g - startColor.g) * percent);
-    color.b = normalizeRGB(startColor.b + float(endColor.b - startColor.b) * percent);
-  }
-}
-
-void Bottle::glow(float glowFrequency, float colorFrequency, waveshape_t waveShape) {
-  updateHue();
+void Bottle::glow(const FrameContext& ctx, float glowFrequency, float colorFrequency, waveshape_t waveShape) {
   // animation step
-  float t = millis() * 0.0004 * PI;
-  // if end range is below start, raise above; normalization will resolve
-  float hrSecond = hueRange.second;
-  if (hueRange.first > hrSecond) {
-    hrSecond += 360;
-  }
-  // hueRange.first < h < hueRange.second
-  float hLower = (hrSecond - hueRange.first) / 2;
-  float hUpper = hrSecond - hLower;
+  float t = ctx.time * 0.0004 * PI;
+  // hueStart < h < hueEnd, which never wraps; normalization will resolve
+  float hLower = (hueEnd - hueStart) / 2.0f;
+  float hUpper = hueEnd - hLower;
   // lightness amplitude adjustments
   // (255 - lLower) < l < 255
   uint8_t lLower = 120;
@@ -109,182 +71,210 @@ void Bottle::glow(float glowFrequency, float colorFrequency, waveshape_t waveSha
   }
 }
 
-void Bottle::glowColor(float glowFrequency) {
-  updateColor();
-  // sin(frequency * time * PI + pin_adjustment + pixel_adjustment * frequency* fluctuation_amount + lift)
-  // pin_adjustment: adjustment per pin to misalign animations
+void Bottle::glowColor(const FrameContext& ctx, float glowFrequency) {
+  // sin(frequency * time * PI + bottle_adjustment + pixel_adjustment * frequency* fluctuation_amount + lift)
+  // bottle_adjustment: adjustment per bottle to misalign animations
   // pixel_adjustment: adjustment per pixel to misalign pixels
   // 0 < fluctuation_amount < 1 (%)
   // lift = 1 - fluctuation_amount (%)
-  float t = glowFrequency * millis() * 0.0004 * PI + pin * 1000;
+  float t = glowFrequency * ctx.time * 0.0004 * PI + index * 1000;
   float pgf = 2000 * glowFrequency;
+  // Gamma is a power curve, so scaling the gamma corrected color by the gamma corrected
+  // adjustment matches gamma correcting the scaled color.
+  uint32_t c = whiteColor(mired16);
   for (uint16_t p = startPixel; p <= lastPixel; p++) {
     float adj = sin(t + p * pgf) * 0.4 + 0.6;
-    uint8_t r = min((float)color.r * adj, 255);
-    uint8_t g = min((float)color.g * adj, 255);
-    uint8_t b = min((float)color.b * adj, 255);
-    setPixelColor(p, r, g, b);
+    setPixelColor(p, scalePixel(c, alphaWeight(Adafruit_NeoPixel::gamma8(adj * 255))));
   }
 }
 
-void Bottle::spawnFaerie(float speed, rgb_t c) {
+void Bottle::noise(const FrameContext& ctx) {
+  uint16_t t = (ctx.time * NOISE_SPEED) >> 10;
+  int32_t hueWidth = hueEnd - hueStart;
+  for (uint16_t p = 0; p < length; p++) {
+    // Across and up the installation; depth shifts the field in time.
+    uint16_t x = (coords[p].x * NOISE_SCALE) >> 8;
+    uint16_t y = (coords[p].z * NOISE_SCALE) >> 8;
+    uint16_t z = t + ((coords[p].y * NOISE_SCALE) >> 8);
+    // Hue and brightness from unrelated parts of the field.
+    int32_t h = hueStart * 256 + hueWidth * noise8(x, y, z);
+    uint8_t l = 120 + ((noise8(x, y + 0x8000, z) * 136) >> 8);
+    setPixelColor(startPixel + p, pxl8->colorHSV(normalizeHue16Fixed(h), 255U, l));
+  }
+}
+
+void Bottle::noiseColor(const FrameContext& ctx) {
+  uint16_t t = (ctx.time * NOISE_SPEED) >> 10;
+  // As glowColor(), the gamma corrected color scaled by a gamma corrected adjustment.
+  uint32_t c = whiteColor(mired16);
+  for (uint16_t p = 0; p < length; p++) {
+    uint16_t x = (coords[p].x * NOISE_SCALE) >> 8;
+    uint16_t y = (coords[p].z * NOISE_SCALE) >> 8;
+    uint16_t z = t + ((coords[p].y * NOISE_SCALE) >> 8);
+    uint8_t l = 51 + ((noise8(x, y, z) * 205) >> 8);
+    setPixelColor(startPixel + p, scalePixel(c, alphaWeight(Adafruit_NeoPixel::gamma8(l))));
+  }
+}
+
+/**
+ * @brief A faerie's flight, at speed 1.
+ */
+static const keyframe_t FAERIE_FLIGHT[] = {
+  { FAERIE_FLY_IN,    300, EASE_OUT    },
+  { FAERIE_PAUSE_MID, 600, EASE_LINEAR },
+  { FAERIE_FLY_UP,    200, EASE_IN_OUT },
+  { FAERIE_PAUSE_TOP, 400, EASE_LINEAR },
+  { FAERIE_FLY_BACK,  300, EASE_IN     },
+};
+
+void Bottle::spawnFaerie(const FrameContext& ctx, uint16_t speed, rgb_t c) {
   faerieColor = c;
-  faerieKeyframes[0] = 300 / speed;
-  faerieKeyframes[1] = 600 / speed + faerieKeyframes[0];
-  faerieKeyframes[2] = 200 / speed + faerieKeyframes[1];
-  faerieKeyframes[3] = 400 / speed + faerieKeyframes[2];
-  faerieKeyframes[4] = 300 / speed + faerieKeyframes[3];
-  faerieAnimationStart = millis();
+  faerie.start(FAERIE_FLIGHT, ctx.time, speed);
 }
 
-bool Bottle::showFaerie() {
-  uint32_t frame = millis() - faerieAnimationStart;
+bool Bottle::showFaerie(const FrameContext& ctx) {
+  uint16_t progress;
+  const keyframe_t* step = faerie.resume(ctx.time, progress);
+  if (step == nullptr) return false;
   uint16_t midpoint = startPixel + length / 2;
-
-  if (frame <= faerieKeyframes[0]) {
-    float percent = (float)frame / faerieKeyframes[0];
-    faerieFly(startPixel, midpoint, 0, 100, percent);
-  }
-  else if (frame <= faerieKeyframes[1]) {
-    float percent = (float)frame / faerieKeyframes[1];
-    faerieStop(midpoint, false, percent);
-  }
-  else if (frame <= faerieKeyframes[2]) {
-    float percent = (float)frame / faerieKeyframes[2];
-    faerieFly(midpoint, lastPixel, 100, 100, percent);
-  }
-  else if (frame <= faerieKeyframes[3]) {
-    float percent = (float)frame / faerieKeyframes[3];
-    faerieStop(lastPixel, false, percent);
-  }
-  else if (frame <= faerieKeyframes[4]) {
-    float percent = (float)frame / faerieKeyframes[4];
-    faerieFly(lastPixel, startPixel, 100, 0, percent);
-  }
-  else {
-    faerieAnimationStart = 0;
-    return false;
+  switch (step->action) {
+    case FAERIE_FLY_IN:
+      faerieFly(startPixel, midpoint, 0, 255, progress);
+      break;
+    case FAERIE_PAUSE_MID:
+      faerieStop(midpoint, false, progress);
+      break;
+    case FAERIE_FLY_UP:
+      faerieFly(midpoint, lastPixel, 255, 255, progress);
+      break;
+    case FAERIE_PAUSE_TOP:
+      faerieStop(lastPixel, false, progress);
+      break;
+    case FAERIE_FLY_BACK:
+    default:
+      faerieFly(lastPixel, startPixel, 255, 0, progress);
+      break;
   }
   return true;
 }
 
-void Bottle::faerieFly(uint16_t startPos, uint16_t endPos, uint8_t startBright, uint8_t endBright, float percent) {
+void Bottle::faerieFly(uint16_t startPos, uint16_t endPos, uint8_t startBright, uint8_t endBright, uint16_t progress) {
   // faerie
-  uint16_t pos = startPos + ((endPos - startPos) * percent);
+  uint16_t pos = startPos + (int32_t)(endPos - startPos) * progress / 65536;
   // scale rgb by brightness from currentColor -> faerieColor
-  float blend = (startBright + ((endBright - startBright) * percent)) / 100;
-  setPixelColor(pos, blendRGB(getPixelColor(pos), faerieColor, blend));
+  uint8_t blend = startBright + (int32_t)(endBright - startBright) * progress / 65536;
+  uint32_t c = pxl8->color(faerieColor.r, faerieColor.g, faerieColor.b);
+  pxl8->overlay(OVERLAY_PARTICLES, pin, pos, c, blend);
   // light trail
   uint16_t pos2 = pos;
   if (startPos > endPos) pos2 += 1;
   else pos2 -= 1;
   if (pixelInBottle(pos2)) {
-    setPixelColor(pos2, blendRGB(getPixelColor(pos2), faerieColor, blend * 0.5f));
+    pxl8->overlay(OVERLAY_PARTICLES, pin, pos2, c, blend >> 1);
     // softer light trail
     uint16_t pos3 = pos2;
     if (startPos > endPos) pos3 += 1;
     else pos3 -= 1;
     if (pixelInBottle(pos3)) {
-      setPixelColor(pos3, blendRGB(getPixelColor(pos3), faerieColor, blend * 0.25f));
+      pxl8->overlay(OVERLAY_PARTICLES, pin, pos3, c, blend >> 2);
     }
   }
 }
 
-void Bottle::faerieStop(uint16_t pos, bool reverse, float percent) {
+void Bottle::faerieStop(uint16_t pos, bool reverse, uint16_t progress) {
+  uint32_t c = pxl8->color(faerieColor.r, faerieColor.g, faerieColor.b);
   // faerie
-  setPixelColor(pos, faerieColor.r, faerieColor.g, faerieColor.b);
-  // one pixel behind
+  pxl8->overlay(OVERLAY_PARTICLES, pin, pos, c, 255);
+  // one pixel behind, fading over the first 30% of the stop
   uint16_t pos2 = pos;
   if (reverse) pos2 += 1;
   else pos2 -= 1;
-  if (percent < 0.3f && pixelInBottle(pos2)) {
-    setPixelColor(pos2, blendRGB(getPixelColor(pos2), faerieColor, 0.5f * (0.3f - percent)));
-    // two pixels behind
+  if (progress < 19661 && pixelInBottle(pos2)) {
+    pxl8->overlay(OVERLAY_PARTICLES, pin, pos2, c, ((19661 - progress) * 255UL) >> 17);
+    // two pixels behind, over the first 13%
     uint16_t pos3 = pos2;
     if (reverse) pos3 += 1;
     else pos3 -= 1;
-    if (percent < 0.15f && pixelInBottle(pos3)) {
-      setPixelColor(pos3, blendRGB(getPixelColor(pos3), faerieColor, 0.25f * (0.13f - percent)));
+    if (progress < 8520 && pixelInBottle(pos3)) {
+      pxl8->overlay(OVERLAY_PARTICLES, pin, pos3, c, ((8520 - progress) * 255UL) >> 18);
     }
   }
 }
 
-void Bottle::rain(void) {
-  for (uint16_t p = startPixel; p <= lastPixel; p++) {
-    uint16_t v = 256 - ((millis() / 4 - pin * 32 + p * 256 / length) & 0xFF);
-    setPixelColor(p, v * 2 >> 8, v * 160 >> 8, v * 255 >> 8);
+void Bottle::rain(const FrameContext& ctx) {
+  uint32_t t = ctx.time / 4;
+  for (uint16_t p = 0; p < length; p++) {
+    // Streaks are the same length whatever the bottle, and start a little later along the shelf.
+    uint32_t phase = (uint32_t)coords[p].z * LAYOUT_SPAN_MM / (RAIN_DROP_MM * 256) - (coords[p].x >> 8);
+    uint16_t v = 256 - ((t + phase) & 0xFF);
+    pxl8->setPixelIndex(pin, startPixel + p, min(v, 255));
   }
 }
 
-void Bottle::rainbow(void) {
-  uint16_t t = millis() * 3;
+void Bottle::rainbow(const FrameContext& ctx) {
+  // Once around the palette along the bottle, turning every 65536 / 3 ms.
+  uint16_t t = ctx.time * 3;
   for (uint16_t p = startPixel; p <= lastPixel; p++) {
-    uint16_t hue = p * 65535 / length + t;
-    uint32_t c = pxl8->colorHSV(hue, 255U, 255U);
-    // Serial.println(String(c, HEX));
-    setPixelColor(p, c);
+    pxl8->setPixelIndex(pin, p, (uint8_t)((p * 65535 / length + t) >> 8));
   }
 }
 
 void Bottle::blank(void) {
-  for (uint16_t p = startPixel; p <= lastPixel; p++) {
-    setPixelColor(p, 0);
-  }
+  pxl8->fill(pin, startPixel, length, 0);
 }
 
 void Bottle::illuminate(rgb_t staticColor) {
-  for (uint16_t p = startPixel; p <= lastPixel; p++) {
-    setPixelColor(p, staticColor);
-  }
+  pxl8->fill(pin, startPixel, length, pxl8->color(staticColor.r, staticColor.g, staticColor.b));
+}
+
+void Bottle::illuminateWhite(white_balance_t mired) {
+  pxl8->fill(pin, startPixel, length, whiteColor((int32_t)mired << 4));
 }
 
 void Bottle::illuminate(void) {
-  for (uint16_t p = startPixel; p <= lastPixel; p++) {
-    setPixelColor(p, color);
-  }
+  pxl8->fill(pin, startPixel, length, whiteColor(mired16));
+}
+
+void Bottle::warning(const FrameContext& ctx) {
+  warning(ctx, 255, 0, 0);
 }
 
-void Bottle::warning(void) {
-  warning(255, 0, 0);
+void Bottle::warningWiFi(const FrameContext& ctx) {
+  pxl8->fillOverlay(OVERLAY_ALERTS, pin, startPixel, length, warningColor(ctx, 0, 0, 255), 255);
 }
 
-void Bottle::warningWiFi(void) {
-  warning(0, 0, 255);
+void Bottle::warningMQTT(const FrameContext& ctx) {
+  pxl8->fillOverlay(OVERLAY_ALERTS, pin, startPixel, length, warningColor(ctx, 255, 127, 0), 255);
 }
 
-void Bottle::warningMQTT(void) {
-  warning(255, 127, 0);
+void Bottle::warning(const FrameContext& ctx, uint8_t r, uint8_t g, uint8_t b) {
+  pxl8->fill(pin, startPixel, length, warningColor(ctx, r, g, b));
 }
 
-void Bottle::warning(uint8_t r, uint8_t g, uint8_t b) {
-  float br = 0.8 * sin(millis() / 2 * PI * 0.001) + 0.2;
+uint32_t Bottle::warningColor(const FrameContext& ctx, uint8_t r, uint8_t g, uint8_t b) {
+  float br = 0.8 * sin(ctx.time / 2 * PI * 0.001) + 0.2;
   float r2 = r / 2;
   float g2 = g / 2;
   float b2 = b / 2;
   uint8_t rs = r2 * br + r2;
   uint8_t gs = g2 * br + g2;
   uint8_t bs = b2 * br + b2;
-  for (uint16_t p = startPixel; p <= lastPixel; p++) {
-    setPixelColor(p, normalizeRGB(rs), normalizeRGB(gs), normalizeRGB(bs));
-  }
+  return pxl8->color(rs, gs, bs);
 }
 
-void Bottle::loopColors(const std::vector<const rgb_t*>* colors) {
-  uint16_t interval = millis() % 10000 * colors->size() * 0.0001;
-  for (uint16_t p = startPixel; p <= lastPixel; p++) {
-    rgb_t c = *colors->at(interval);
-    setPixelColor(p, c.r, c.g, c.b);
-  }
+void Bottle::loopColors(const FrameContext& ctx, size_t count) {
+  uint16_t interval = ctx.time % 10000 * count * 0.0001;
+  // Evenly spaced through the palette, shifted by this bottle's calibration.
+  int32_t i = interval * 255 / (count - 1) + whiteOffset * 255 / (MAX_WB_MIRED - MIN_WB_MIRED);
+  pxl8->fillIndex(pin, startPixel, length, min(max(i, (int32_t)0), (int32_t)255));
 }
 
-void Bottle::testBlink(void) {
+void Bottle::testBlink(const FrameContext& ctx) {
   uint32_t c = pxl8->color(0, 0, 0);
-  if (millis() / 500 & 1) {
+  if (ctx.time / 500 & 1) {
     c = pxl8->color(255, 255, 255);
   }
-  for (uint16_t p = startPixel; p <= lastPixel; p++) {
-    setPixelColor(p, c);
-  }
+  pxl8->fill(pin, startPixel, length, c);
 }
 
 void Bottle::setPixelColor(uint16_t pixel, uint32_t c) {
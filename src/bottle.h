@@ -5,6 +5,11 @@
 #include <vector>
 #include "pxl8.h"
 #include "def.h"
+#include "frame.h"
+#include "noise.h"
+#include "spatial.h"
+#include "timeline.h"
+#include "whitebalance.h"
 
 /**
  * @brief A strip of LEDs. In a bottle.
@@ -18,8 +23,9 @@ class Bottle {
      * @param pin Pin index (not id on board)
      * @param startPixel First pixel on strand that belongs to this bottle.
      * @param length Number of pixels on strand.
+     * @param index Index of the bottle across the installation, which offsets its animations.
      */
-    Bottle(Pxl8 *pxl8, uint8_t pin, uint16_t startPixel, uint16_t length);
+    Bottle(Pxl8 *pxl8, uint8_t pin, uint16_t startPixel, uint16_t length, uint16_t index = 0);
 
     /**
      * @brief Set the hue range of the bottle in degrees.
@@ -32,52 +38,92 @@ class Bottle {
     /**
      * @brief Set the hue range of the bottle in degrees.
      * 
+     * @param ctx Current frame.
      * @param start
      * @param end
      * @param ms fade time in millis
      */
-    void setHue(uint16_t start, uint16_t end, uint32_t ms);
+    void setHue(const FrameContext& ctx, uint16_t start, uint16_t end, uint32_t ms);
 
     /**
-     * @brief Set the color of the bottle.
-     * 
-     * @param newColor RGB 
+     * @brief Set where the bottle's pixels are. Call during setup.
+     *
+     * @param c one per pixel, from SpatialMap::bottle()
      */
-    void setColor(rgb_t newColor);
+    void setCoords(const pixel_coord_t* c) {
+      coords = c;
+    }
 
     /**
-     * @brief Set the color of the bottle.
-     * 
-     * @param newColor RGB
+     * @brief Set the white balance of the bottle.
+     *
+     * @param mired
+     */
+    void setWhiteBalance(white_balance_t mired);
+
+    /**
+     * @brief Fade the white balance of the bottle, along the blackbody curve.
+     *
+     * @param ctx Current frame.
+     * @param mired
      * @param ms fade time in millis
      */
-    void setColor(rgb_t newColor, uint32_t ms);
+    void setWhiteBalance(const FrameContext& ctx, white_balance_t mired, uint32_t ms);
+
+    /**
+     * @brief Set the calibration added to every white balance shown. See BOTTLE_LAYOUT.
+     *
+     * @param mireds
+     */
+    void setWhiteOffset(int8_t mireds) {
+      whiteOffset = mireds;
+    }
 
     /**
      * @brief Glow animation.
      *
+     * @param ctx Current frame.
      * @param glowFrequency Speed of brightness pulse.
      * @param colorFrequency Speed of hue pulse.
      * @param waveShape Waveshape. SINE will produce a smooth glow while SAWTOOTH will make the bottle sparkly.
      */
-    void glow(float glowFrequency = 1.25, float colorFrequency = 1, waveshape_t waveShape = SINE);
+    void glow(const FrameContext& ctx, float glowFrequency = 1.25, float colorFrequency = 1, waveshape_t waveShape = SINE);
 
     /**
-     * @brief Glow a specific color.
+     * @brief Glow in the bottle's white balance.
      *
+     * @param ctx Current frame.
      * @param glowFrequency Speed of brightness pulse.
      */
-    void glowColor(float glowFrequency = 1.25);
+    void glowColor(const FrameContext& ctx, float glowFrequency = 1.25);
 
     /**
-     * @brief Rain animation.
+     * @brief Drifting noise, picking hues within the hue range and brightness.
+     *
+     * @param ctx Current frame.
      */
-    void rain(void);
+    void noise(const FrameContext& ctx);
 
     /**
-     * @brief Rainbow animation.
+     * @brief Drifting noise in the bottle's white balance.
+     *
+     * @param ctx Current frame.
      */
-    void rainbow(void);
+    void noiseColor(const FrameContext& ctx);
+
+    /**
+     * @brief Rain animation, from a palette ramping up to the rain color.
+     *
+     * @param ctx Current frame.
+     */
+    void rain(const FrameContext& ctx);
+
+    /**
+     * @brief Rainbow animation, from a palette around the color wheel.
+     *
+     * @param ctx Current frame.
+     */
+    void rainbow(const FrameContext& ctx);
 
     /**
      * @brief Blank all pixels.
@@ -92,143 +138,179 @@ class Bottle {
     void illuminate(rgb_t staticColor);
 
     /**
-     * @brief Illuminate bottles the current bottle color.
+     * @brief Illuminate bottles a white balance, calibrated for this bottle.
+     *
+     * @param mired
+     */
+    void illuminateWhite(white_balance_t mired);
+
+    /**
+     * @brief Illuminate bottles the bottle's white balance.
      */
     void illuminate(void);
 
     /**
      * @brief Warning animation.
+     *
+     * @param ctx Current frame.
      */
-    void warning(void);
+    void warning(const FrameContext& ctx);
 
     /**
-     * @brief Warning animation for WiFi issue.
+     * @brief Warning for WiFi issue, on the alerts overlay.
+     *
+     * @param ctx Current frame.
      */
-    void warningWiFi(void);
+    void warningWiFi(const FrameContext& ctx);
 
     /**
-     * @brief Warning animation for MQTT issue.
+     * @brief Warning for MQTT issue, on the alerts overlay.
+     *
+     * @param ctx Current frame.
      */
-    void warningMQTT(void);
+    void warningMQTT(const FrameContext& ctx);
 
     /**
      * @brief Warning animation at specific color.
+     *
+     * @param ctx Current frame.
      */
-    void warning(uint8_t r, uint8_t g, uint8_t b);
+    void warning(const FrameContext& ctx, uint8_t r, uint8_t g, uint8_t b);
 
     /**
-     * @brief Loop a series of colors.
+     * @brief Step through white balances, from the palette of whites (see Palette::whites()).
      *
-     * @param colors pointer to vector of RGB colors
+     * @param ctx Current frame.
+     * @param count number of steps, at least 2
      */
-    void loopColors(const std::vector<const rgb_t*>* colors);
+    void loopColors(const FrameContext& ctx, size_t count);
 
     /**
      * @brief Test blink animation.
+     *
+     * @param ctx Current frame.
      */
-    void testBlink(void);
+    void testBlink(const FrameContext& ctx);
 
     /**
-     * @brief Animate a faerie. Call each loop until it returns false.
+     * @brief Animate a faerie on the particles overlay. Call each loop until it returns false.
      *
+     * @param ctx Current frame.
      * @return bool: Animation continues, display again next loop.
      */
-    bool showFaerie(void);
+    bool showFaerie(const FrameContext& ctx);
 
     /**
      * @brief Spawn a new faerie.
      * 
-     * @param speed animation speed multiplier
+     * @param ctx Current frame.
+     * @param speed animation speed multiplier, 8.8 fixed point
      * @param c RGB faerie color
      */
-    void spawnFaerie(float speed = 1, rgb_t c = { 255, 255, 255 });
-
-  private:
-    /**
-     * @brief Pointer to the pxl8 object for drawing.
-     */
-    Pxl8 *pxl8;
+    void spawnFaerie(const FrameContext& ctx, uint16_t speed = 256, rgb_t c = { 255, 255, 255 });
 
     /**
-     * @brief Pin index. This is the index, the nth bottle, and does not
-     *        directly reference pins on the board.
+     * @brief Pin index the bottle is on.
+     *
+     * @return pin index
      */
-    uint8_t pin;
+    uint8_t getPin(void) const {
+      return pin;
+    }
 
     /**
-     * @brief First pixel on LED strand that belongs to this bottle.
+     * @brief First pixel on the strand that belongs to the bottle.
+     *
+     * @return pixel
      */
-    uint16_t startPixel = 0;
+    uint16_t getStartPixel(void) const {
+      return startPixel;
+    }
 
     /**
-     * @brief Last pixel on LED strand that belongs to this bottle.
+     * @brief Number of pixels in the bottle.
+     *
+     * @return pixels
      */
-    uint16_t lastPixel = 0;
+    uint16_t getLength(void) const {
+      return length;
+    }
 
     /**
-     * @brief Number of pixels on the strand that belong to the bottle.
+     * @brief Index of the bottle across the installation.
+     *
+     * @return index
      */
-    uint16_t length;
+    uint16_t getIndex(void) const {
+      return index;
+    }
 
+  private:
     /**
-     * @brief Millis at start of faerie animation.
+     * @brief Pointer to the pxl8 object for drawing.
      */
-    uint32_t faerieAnimationStart = 0;
+    Pxl8 *pxl8;
 
     /**
-     * @brief Hue range.
+     * @brief Pin index. This is the index, the nth bottle, and does not
+     *        directly reference pins on the board.
      */
-    std::pair<uint16_t, uint16_t> hueRange = { 0, 30 };
+    uint8_t pin;
 
     /**
-     * @brief Starting hue range for fade.
+     * @brief Index of the bottle across all boards, so effects span boards coherently.
      */
-    std::pair<uint16_t, uint16_t> startHueRange = { 0, 30 };
+    uint16_t index;
 
     /**
-     * @brief Ending hue range for fade.
+     * @brief First pixel on LED strand that belongs to this bottle.
      */
-    std::pair<uint16_t, uint16_t> endHueRange = { 0, 30 };
+    uint16_t startPixel = 0;
 
     /**
-     * @brief Hue fade time in ms.
+     * @brief Last pixel on LED strand that belongs to this bottle.
      */
-    uint32_t hueFadeSpeed = 0;
+    uint16_t lastPixel = 0;
 
     /**
-     * @brief If fading hue, this is the start time.
+     * @brief Number of pixels on the strand that belong to the bottle.
      */
-    uint32_t hueFadeStartTime = 0;
+    uint16_t length;
 
     /**
-     * @brief Color.
+     * @brief Where each pixel is, from the first.
      */
-    rgb_t color = { 255, 255, 255 };
+    const pixel_coord_t* coords = nullptr;
 
     /**
-     * @brief Starting color.
+     * @brief Hue range in degrees, faded by tweens. The end may be past 360 so the range doesn't
+     *        wrap; the start is between 0 and 359 except while fading.
      */
-    rgb_t startColor = { 255, 255, 255 };
+    int16_t hueStart = 0;
+    int16_t hueEnd = 30;
 
     /**
-     * @brief Ending color.
+     * @brief White balance in mireds, 12.4 fixed point, faded by tweens.
      */
-    rgb_t endColor = { 255, 255, 255 };
+    int16_t mired16 = DEFAULT_WB_MIRED << 4;
 
     /**
-     * @brief Color fade time in ms.
+     * @brief Mireds added to every white balance shown.
      */
-    uint32_t colorFadeSpeed = 0;
+    int8_t whiteOffset = 0;
 
     /**
-     * @brief If fading color, this is the start time.
+     * @brief Calibrated color of a white balance.
+     *
+     * @param m mireds, 12.4 fixed point
+     * @return packed color, gamma applied
      */
-    uint32_t colorFadeStartTime = 0;
+    uint32_t whiteColor(int32_t m);
 
     /**
-     * @brief Faerie keyframe timing.
+     * @brief Faerie flight, see FAERIE_FLIGHT.
      */
-    uint32_t faerieKeyframes[5] = {};
+    Timeline faerie;
 
     /**
      * @brief Faerie color.
@@ -240,16 +322,6 @@ class Bottle {
      */
     uint32_t white = 0xFFFFFF;
 
-    /**
-     * @brief Update hue step between start and end range, if different.
-     */
-    void updateHue(void);
-
-    /**
-     * @brief Update color step between start and end, if different.
-     */
-    void updateColor(void);
-
     /**
      * @brief Whether a given pixel is out of bounds for this bottle.
      *
@@ -257,25 +329,33 @@ class Bottle {
      */
     inline bool pixelInBottle(uint16_t pixel);
 
+    /**
+     * @brief Pulsing warning color.
+     *
+     * @param ctx Current frame.
+     * @return Packed color.
+     */
+    uint32_t warningColor(const FrameContext& ctx, uint8_t r, uint8_t g, uint8_t b);
+
     /**
      * @brief Fly faerie from one pixel to another.
      *
      * @param startPos pixel on bottle strand
      * @param endPos pixel on bottle strand
-     * @param startBright 0-100
-     * @param endBright 0-100
-     * @param percent 0-100 percent through animation
+     * @param startBright 0-255
+     * @param endBright 0-255
+     * @param progress 0-65535 through the step
      */
-    void faerieFly(uint16_t startPos, uint16_t endPos, uint8_t startBright, uint8_t endBright, float percent);
+    void faerieFly(uint16_t startPos, uint16_t endPos, uint8_t startBright, uint8_t endBright, uint16_t progress);
 
     /**
      * @brief Stop flying at a pixel. The light trail will fade out.
      *
      * @param pos pixel on bottle strand
      * @param reverse is the faerie flying backwards
-     * @param percent 0-100 percent through animation
+     * @param progress 0-65535 through the step
      */
-    void faerieStop(uint16_t pos, bool reverse, float percent);
+    void faerieStop(uint16_t pos, bool reverse, uint16_t progress);
 
     /**
      * @brief Set a pixel a specific color.
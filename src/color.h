@@ -2,57 +2,85 @@
 #define CRYPTID_COLOR_H
 
 /**
- * @brief Normalize hue between 0 and 360. Useful for cases when hue calculations may escape range.
- * 
- * @param hue 
+ * @brief Normalize hue between 0 and 359. Useful for cases when hue calculations may escape range.
+ *
+ * @param hue
  * @return hue
  */
 static inline uint16_t normalizeHue(uint16_t hue) {
-  while (hue > 360) hue -= 360;
-  while (hue < 0) hue += 360;
-  return hue;
+  return hue % 360;
 }
 
 /**
- * @brief Normalize hue between 0 and 360. Useful for cases when hue calculations may escape range.
- * 
- * @param hue 
+ * @brief Normalize hue between 0 and 359. Useful for cases when hue calculations may escape range.
+ *
+ * @param hue
+ * @return hue
+ */
+static inline uint16_t normalizeHue(int hue) {
+  // Hues are rarely more than a turn out, where a loop of one or two subtracts beats the divide.
+  // Further out, the divide bounds the time.
+  if (hue > -720 && hue < 720) {
+    while (hue >= 360) hue -= 360;
+    while (hue < 0) hue += 360;
+    return (uint16_t)hue;
+  }
+  return (uint16_t)((hue % 360 + 360) % 360);
+}
+
+/**
+ * @brief Normalize hue between 0 and 359. Useful for cases when hue calculations may escape range.
+ *        Fractional degrees are floored.
+ *
+ * @param hue -23040 < hue
  * @return hue
  */
 static inline uint16_t normalizeHue(float hue) {
-  while (hue > 360) hue -= 360;
-  while (hue < 0) hue += 360;
-  return (uint16_t)hue;
+  // Offset by a multiple of 360 so truncation floors, without a branch.
+  return normalizeHue((int)(hue + 23040.0f) - 23040);
 }
 
 /**
- * @brief Normalize hue between 0 and 360. Useful for cases when hue calculations may escape range.
- * 
- * @param hue 
+ * @brief Normalize hue between 0 and 65535. Useful for cases when hue calculations may escape range.
+ *
+ * @param hue degrees
  * @return hue
  */
-static inline uint16_t normalizeHue(int hue) {
-  while (hue > 360) hue -= 360;
-  while (hue < 0) hue += 360;
-  return (uint16_t)hue;
+static inline uint16_t normalizeHue16(int hue) {
+  // 65535 / 360 ~= 182
+  return normalizeHue(hue) * 182U;
 }
 
 /**
  * @brief Normalize hue between 0 and 65535. Useful for cases when hue calculations may escape range.
- * 
- * @param hue 
+ *
+ * @param hue degrees, -23040 < hue
  * @return hue
  */
 static inline uint16_t normalizeHue16(float hue) {
-  while (hue > 360) hue -= 360;
-  while (hue < 0) hue += 360;
-  return (uint16_t)(hue / 360 * 65535);
+  // 1/256 degree fixed point, offset by a multiple of 360 so truncation floors.
+  uint32_t h8 = (uint32_t)(hue * 256.0f + 5898240.0f) % 92160U;
+  // 65535 / 92160 ~= 2912 / 4096
+  return (uint16_t)((h8 * 2912U) >> 12);
+}
+
+/**
+ * @brief Normalize hue between 0 and 65535, from fixed point degrees.
+ *
+ * @param hue8 1/256 degrees, -5898240 < hue8
+ * @return hue
+ */
+static inline uint16_t normalizeHue16Fixed(int32_t hue8) {
+  // Offset by a multiple of 360 degrees so the modulo is of a positive number.
+  uint32_t h8 = (uint32_t)(hue8 + 5898240) % 92160U;
+  // 65535 / 92160 ~= 2912 / 4096
+  return (uint16_t)((h8 * 2912U) >> 12);
 }
 
 /**
  * @brief Normalize value between 0 and 255. Useful when RGB value may escape range.
- * 
- * @param value 
+ *
+ * @param value
  * @return normalized value
  */
 static inline uint8_t normalizeRGB(float v) {
@@ -63,8 +91,8 @@ static inline uint8_t normalizeRGB(float v) {
 
 /**
  * @brief Normalize value between 0 and 255. Useful when RGB value may escape range.
- * 
- * @param value 
+ *
+ * @param value
  * @return normalized value
  */
 static inline uint8_t normalizeRGB(int v) {
@@ -88,32 +116,115 @@ typedef struct rgb_t {
     : r(normalizeRGB(r)), g(normalizeRGB(g)), b(normalizeRGB(b)) {}
 } rgb_t;
 
+/**
+ * @brief Pack RGB into a 0x00RRGGBB color.
+ *
+ * @param c RGB
+ * @return packed color
+ */
+static inline uint32_t packRGB(rgb_t c) {
+  return ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | c.b;
+}
+
+/**
+ * @brief Unpack a 0x00RRGGBB color.
+ *
+ * @param c packed color
+ * @return RGB
+ */
+static inline rgb_t unpackRGB(uint32_t c) {
+  return rgb_t{ (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c };
+}
+
+/**
+ * @brief Divide by 255, exact for 0 <= x <= 65534. That covers 255 * 255, the most a blend of
+ *        8-bit values sums to; 65535 gives 256 rather than 257.
+ *
+ * @param x
+ * @return x / 255
+ */
+static inline uint32_t div255(uint32_t x) {
+  return (x + 1 + (x >> 8)) >> 8;
+}
+
+/**
+ * @brief Blend one 8-bit value with another.
+ *
+ * @param current
+ * @param target
+ * @param alpha 0-255, 255 is entirely target
+ * @return blended value
+ */
+static inline uint8_t blend8(uint8_t current, uint8_t target, uint8_t alpha) {
+  return (uint8_t)div255((uint32_t)current * (255 - alpha) + (uint32_t)target * alpha);
+}
+
+/**
+ * @brief Convert a 0-1 amount to an 8-bit alpha.
+ *
+ * @param amount 0-1
+ * @return alpha 0-255
+ */
+static inline uint8_t alpha8(float amount) {
+  return normalizeRGB(amount * 255.0f + 0.5f);
+}
+
+/**
+ * @brief Linear interpolate between two RGB colors.
+ *
+ * @param current
+ * @param target
+ * @param alpha 0-255, 255 is entirely target
+ * @return blended RGB
+ */
+static inline rgb_t lerpRGB(rgb_t current, rgb_t target, uint8_t alpha) {
+  return rgb_t {
+    blend8(current.r, target.r, alpha),
+    blend8(current.g, target.g, alpha),
+    blend8(current.b, target.b, alpha),
+  };
+}
+
+/**
+ * @brief Linear interpolate between two packed 0x00RRGGBB colors. Red and blue are blended
+ *        together in one multiply, green in another.
+ *
+ * @param current
+ * @param target
+ * @param alpha 0-255, 255 is entirely target
+ * @return blended packed color
+ */
+static inline uint32_t lerpRGB(uint32_t current, uint32_t target, uint8_t alpha) {
+  // Map 0-255 to 0-256 so 255 reaches target.
+  uint32_t a = alpha + (alpha >> 7);
+  uint32_t rb = (((current & 0xFF00FF) * (256 - a) + (target & 0xFF00FF) * a) >> 8) & 0xFF00FF;
+  uint32_t g = (((current & 0x00FF00) * (256 - a) + (target & 0x00FF00) * a) >> 8) & 0x00FF00;
+  return rb | g;
+}
+
 /**
  * @brief Blend one RGB value with another and normalize.
- * 
+ *
  * @param current
  * @param target
  * @param amount 0-1
  * @return blended value
  */
 static inline uint8_t blendValue(uint8_t current, uint8_t target, float amount) {
-  return normalizeRGB((float)current + amount * (target - current));
+  return blend8(current, target, alpha8(amount));
 }
 
 /**
- * @brief Blend one RGB color with another and normalize.
- * 
+ * @brief Blend one RGB color with another and normalize. Kept for callers with a float amount;
+ *        converting it costs more than the integer blend saves, so prefer lerpRGB.
+ *
  * @param current
  * @param target
  * @param amount 0-1
  * @return blended RGB
  */
 static inline rgb_t blendRGB(rgb_t current, rgb_t target, float amount) {
-  return rgb_t {
-    blendValue(current.r, target.r, amount),
-    blendValue(current.g, target.g, amount),
-    blendValue(current.b, target.b, amount),
-  };
+  return lerpRGB(current, target, alpha8(amount));
 }
 
 #endif
@@ -0,0 +1,69 @@
+#include "colorbench.h"
+#include "log.h"
+#include "swar.h"
+
+#ifdef COLOR_BENCHMARK
+/**
+ * @brief Calls timed per primitive; enough to be well above micros() resolution.
+ */
+#define COLOR_BENCHMARK_CALLS 10000
+
+/**
+ * @brief Keeps results from being optimized away.
+ */
+static volatile uint32_t colorSink;
+
+/**
+ * @brief Time a primitive and log it.
+ *
+ * @param before whether it's a helper that was replaced
+ * @param name up to four characters
+ * @param f called with 0 to COLOR_BENCHMARK_CALLS - 1
+ */
+template<typename F>
+static void timeColor(bool before, const char* name, F f) {
+  uint32_t acc = 0;
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < COLOR_BENCHMARK_CALLS; i++) {
+    acc += f(i);
+  }
+  uint32_t elapsed = micros() - start;
+  colorSink = acc;
+  if (before) {
+    LOG(COLOR_TIMING_BEFORE, logText(name), elapsed * 1000 / COLOR_BENCHMARK_CALLS);
+  } else {
+    LOG(COLOR_TIMING, logText(name), elapsed * 1000 / COLOR_BENCHMARK_CALLS);
+  }
+}
+
+void colorBenchmark(void) {
+  // Hues up to a turn out either way, as effects produce them, and colors and alphas over their
+  // whole range.
+  timeColor(true, "hue", [](uint32_t i) {
+    return (uint32_t)colorBefore::normalizeHue((int)(i * 7919U % 1080) - 360);
+  });
+  timeColor(false, "hue", [](uint32_t i) {
+    return (uint32_t)normalizeHue((int)(i * 7919U % 1080) - 360);
+  });
+  timeColor(true, "h16", [](uint32_t i) {
+    return (uint32_t)colorBefore::normalizeHue16((float)(i * 7919U % 2160) * 0.5f - 360);
+  });
+  timeColor(false, "h16", [](uint32_t i) {
+    return (uint32_t)normalizeHue16((float)(i * 7919U % 2160) * 0.5f - 360);
+  });
+  timeColor(true, "rgb", [](uint32_t i) {
+    rgb_t c = colorBefore::blendRGB(rgb_t{ (uint8_t)i, (uint8_t)40, (uint8_t)200 }, rgb_t{ (uint8_t)10, (uint8_t)(i >> 8), (uint8_t)90 }, (i & 0xFF) / 255.0f);
+    return (uint32_t)c.r + c.g + c.b;
+  });
+  timeColor(false, "rgb", [](uint32_t i) {
+    rgb_t c = blendRGB(rgb_t{ (uint8_t)i, (uint8_t)40, (uint8_t)200 }, rgb_t{ (uint8_t)10, (uint8_t)(i >> 8), (uint8_t)90 }, (i & 0xFF) / 255.0f);
+    return (uint32_t)c.r + c.g + c.b;
+  });
+  timeColor(false, "lerp", [](uint32_t i) {
+    return lerpRGB((i & 0xFF) << 16 | 0x28C8, 0x0A005A | (i & 0xFF00), (uint8_t)i);
+  });
+  timeColor(false, "bpx", [](uint32_t i) {
+    return blendPixel((i & 0xFF) << 16 | 0x28C8, 0x0A005A | (i & 0xFF00), (uint8_t)i);
+  });
+}
+#endif
@@ -0,0 +1,50 @@
+#ifndef CRYPTID_COLORBENCH_H
+#define CRYPTID_COLORBENCH_H
+
+#include "def.h"
+
+#ifdef COLOR_BENCHMARK
+/**
+ * @brief The color helpers as they were before the integer primitives in color.h, to time them
+ *        against.
+ */
+namespace colorBefore {
+  static inline uint16_t normalizeHue(int hue) {
+    while (hue > 360) hue -= 360;
+    while (hue < 0) hue += 360;
+    return (uint16_t)hue;
+  }
+
+  static inline uint16_t normalizeHue16(float hue) {
+    while (hue > 360) hue -= 360;
+    while (hue < 0) hue += 360;
+    return (uint16_t)(hue / 360 * 65535);
+  }
+
+  static inline uint8_t normalizeRGB(float v) {
+    if (v > 255) v = 255;
+    if (v < 0) v = 0;
+    return (uint8_t)v;
+  }
+
+  static inline uint8_t blendValue(uint8_t current, uint8_t target, float amount) {
+    return normalizeRGB((float)current + amount * (target - current));
+  }
+
+  static inline rgb_t blendRGB(rgb_t current, rgb_t target, float amount) {
+    return rgb_t {
+      blendValue(current.r, target.r, amount),
+      blendValue(current.g, target.g, amount),
+      blendValue(current.b, target.b, amount),
+    };
+  }
+}
+
+/**
+ * @brief Time the color primitives and the helpers they replaced over the same inputs, logging
+ *        each.
+ */
+void colorBenchmark(void);
+#endif
+
+#endif
@@ -1,281 +1,906 @@
+#include <algorithm>
 #include "control.h"
+#include "log.h"
+#include "whitebalance.h"
 
-Control::Control(Pxl8* pxl8, MQTT_Looped* interwebs, std::vector<Bottle*>* bottles)
-  : pxl8(pxl8), interwebs(interwebs), bottles(bottles) {
-  this->lastGlowChange = millis();
+/**
+ * @brief Convert option names to a JSON string array.
+ *
+ * @tparam T
+ * @tparam N
+ * @param options
+ * @param skip option to leave out, if any
+ * @return String
+ */
+template<typename T, size_t N>
+static String jsonStr(const option_t<T> (&options)[N], const T* skip = nullptr) {
+  String s = "[";
+  for (size_t i = 0; i < N; i++) {
+    if (skip != nullptr && options[i].value == *skip) continue;
+    if (s.length() > 1) s += ",";
+    s += "\"";
+    s += options[i].name;
+    s += "\"";
+  }
+  s += "]";
+  return s;
+}
+
+/**
+ * @brief Discovery JSON for light.
+ *
+ * @return String
+ *
+ * @see https://www.home-assistant.io/integrations/mqtt
+ */
+static String discoveryLight(void) {
+  String json = F(R"JSON({
+    "~":"cryptid/bottles",
+    "name":"Cryptid Bottles",
+    "uniq_id":"cryptid-bottles",
+    "ic":"mdi:bottle-tonic-outline",
+    "stat_t":"~/state",
+    "stat_val_tpl":"{{ value_json.on }}",
+    "cmd_t":"~/on/set",
+    "on_cmd_type":"brightness",
+    "bri_cmd_t":"~/brightness/set",
+    "bri_val_tpl":"{{ value_json.brightness }}",
+    "bri_scl":255,
+    "rgb_cmd_t":"~/rgb/set",
+    "rgb_val_tpl":"{{ value_json.rgb }}",
+    "whit_cmd_t":"~/white/set",
+    "whit_scl":255,
+    "clr_temp_cmd_t":"~/white_balance/set",
+    "clr_temp_val_tpl":"{{ value_json.white_balance }}",
+    "min_mirs":)JSON");
+  json += String(MIN_WB_MIRED);
+  json += F(R"JSON(,
+    "max_mirs":)JSON");
+  json += String(MAX_WB_MIRED);
+  json += F(R"JSON(,
+    "fx_cmd_t":"~/effect/set",
+    "fx_list":)JSON");
+  json += jsonStr(BOTTLE_ANIMATIONS);
+  json += F(R"JSON(,
+    "fx_val_tpl":"{{ value_json.effect }}",
+    "dev":{"ids":["cryptidBottles"],"name":"Cryptid Bottles"}})JSON");
+  json.replace("\n    ",""); // shrink data
+  return json;
+}
+
+/**
+ * @brief Discovery JSON for a zone's light. Brightness is shared, so zones only have on, color
+ *        and effect.
+ *
+ * @param zone
+ * @return String
+ */
+static String discoveryZone(const zone_layout_t& zone) {
+  static const bottle_animation_t network = BOTTLE_ANIMATION_NETWORK;
+  String json = F(R"JSON({
+    "~":"cryptid/bottles/zone/)JSON");
+  json += zone.id;
+  json += F(R"JSON(",
+    "name":")JSON");
+  json += zone.name;
+  json += F(R"JSON(",
+    "uniq_id":"cryptid-bottles-)JSON");
+  json += zone.id;
+  json += F(R"JSON(",
+    "ic":"mdi:bottle-tonic-outline",
+    "stat_t":"~/state",
+    "stat_val_tpl":"{{ value_json.on }}",
+    "cmd_t":"~/on/set",
+    "rgb_cmd_t":"~/rgb/set",
+    "rgb_val_tpl":"{{ value_json.rgb }}",
+    "fx_cmd_t":"~/effect/set",
+    "fx_list":)JSON");
+  json += jsonStr(BOTTLE_ANIMATIONS, &network);
+  json += F(R"JSON(,
+    "fx_val_tpl":"{{ value_json.effect }}",
+    "dev":{"ids":["cryptidBottles"],"name":"Cryptid Bottles"}})JSON");
+  json.replace("\n    ",""); // shrink data
+  return json;
+}
+
+/**
+ * @brief Parse an on/off command.
+ *
+ * @param payload
+ * @param on parsed value, unchanged if not recognized
+ * @return whether recognized
+ */
+static bool parseOnOff(const char* payload, bool& on) {
+  if (strcmp(payload, "ON") == 0 || strcmp(payload, "on") == 0 || strcmp(payload, "1") == 0) {
+    on = true;
+  } else if (strcmp(payload, "OFF") == 0 || strcmp(payload, "off") == 0 || strcmp(payload, "0") == 0) {
+    on = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Parse an "r,g,b" command.
+ *
+ * @param payload
+ * @param c parsed color, white if not valid
+ * @return whether valid
+ */
+static bool parseRGB(const char* payload, rgb_t& c) {
+  const char* c1 = strchr(payload, ',');
+  const char* c2 = strrchr(payload, ',');
+  // not found || c1 == c2 -> only one comma || no chars after second comma
+  if (c1 == nullptr || c1 == c2 || *(c2 + 1) == '\0') {
+    c = rgb_t{ 255, 255, 255 };
+    return false;
+  }
+  c = rgb_t{
+    (uint8_t)strtol(payload, nullptr, 10),
+    (uint8_t)strtol(c1 + 1, nullptr, 10),
+    (uint8_t)strtol(c2 + 1, nullptr, 10),
+  };
+  return true;
+}
+
+/**
+ * @brief Get discovery JSON for Select setting.
+ * 
+ * @tparam T setting
+ * @tparam N
+ * @param id
+ * @param name
+ * @param icon material design icon
+ * @param options
+ * @return String
+ *
+ * @see https://www.home-assistant.io/integrations/mqtt
+ * @see https://pictogrammers.com/library/mdi/
+ */
+template<typename T, size_t N>
+static String discoverySelect(String id, String name, String icon, const option_t<T> (&options)[N]) {
+  return "{\"~\":\"cryptid/bottles\","
+         "\"name\":\"" + name + "\","
+         "\"uniq_id\":\"cryptid-bottles-" + id + "\","
+         "\"ic\":\"mdi:" + icon + "\","
+         "\"stat_t\":\"~/state\","
+         "\"cmd_t\":\"~/" + id + "/set\","
+         "\"val_tpl\":\"{{ value_json." + id + " }}\","
+         "\"ops\":" + jsonStr(options) + ","
+         "\"dev\":{\"ids\":[\"cryptidBottles\"],\"name\":\"Cryptid Bottles\"}}";
+}
+
+/**
+ * @brief Get discovery JSON for Sensor.
+ * 
+ * @param id
+ * @param name
+ * @param device_class type of sensor/data, or empty
+ * @param state_class measurement, total, or total_increasing
+ * @param unit measurement unit, such as mW, or empty
+ * @return String
+ *
+ * @see https://www.home-assistant.io/integrations/mqtt
+ * @see https://www.home-assistant.io/integrations/sensor/#device-class
+ * @see https://developers.home-assistant.io/docs/core/entity/sensor/#available-state-classes
+ */
+static String discoverySensor(String id, String name, String device_class, String state_class, String unit) {
+  return "{\"~\":\"cryptid/bottles/sensor\","
+         "\"name\":\"" + name + "\","
+         "\"uniq_id\":\"cryptid-bottles-" + id + "\","
+         + (device_class.length() ? "\"dev_cla\":\"" + device_class + "\"," : String("")) +
+         "\"stat_cla\":\"" + state_class + "\","
+         + (unit.length() ? "\"unit_of_meas\":\"" + unit + "\"," : String("")) +
+         "\"stat_t\":\"~/state\","
+         "\"val_tpl\":\"{{ value_json." + id + " }}\","
+         "\"dev\":{\"ids\":[\"cryptidBottles\"],\"name\":\"Cryptid Bottles\"}}";
 }
 
+
+Control::Control(Pxl8* pxl8, MQTT_Looped* interwebs, std::vector<Bottle*>* bottles, RandomStreams* random,
+                 TweenPool* tweens)
+  : pxl8(pxl8), interwebs(interwebs), bottles(bottles), random(random), tweens(tweens) {}
+
 // ---------- MQTT Commands ----------
 
 void Control::turnOn(void) {
-  Serial.println(F("Turning light on"));
+  LOG(LIGHT_ON);
   pixelsOn = true;
+  // Turning on with every zone off lights them all.
+  bool anyOn = false;
+  for (auto const& zone : zones) {
+    anyOn |= zone.on;
+  }
+  if (!anyOn) {
+    for (auto & zone : zones) {
+      zone.on = true;
+    }
+    zonesChanged = true;
+  }
   if (brightness == 0) {
     brightness = 127;
-    pxl8->setBrightness(brightness);
+    pxl8->fadeBrightness(tweens, brightness, BRIGHTNESS_FADE_MS);
   }
 }
 
 void Control::turnOff(void) {
-  Serial.println(F("Turning light off"));
+  LOG(LIGHT_OFF);
   pixelsOn = false;
   for (auto & bottle : *bottles) {
     bottle->blank();
   }
 }
 
+void Control::setEffect(bottle_animation_t animation) {
+  bottleAnimation = animation;
+  for (auto & zone : zones) {
+    if (zone.on && zone.animation == animation) continue;
+    zone.on = true;
+    zone.animation = animation;
+    zonesChanged = true;
+  }
+}
+
+void Control::setColor(rgb_t c) {
+  static_color = c;
+  for (auto & zone : zones) {
+    zone.color = c;
+    zone.white = 0;
+  }
+}
+
+void Control::setWhite(white_balance_t mired) {
+  setColor(whiteBalanceRGB(mired));
+  for (auto & zone : zones) {
+    zone.white = mired;
+  }
+}
+
+void Control::setZoneEffect(uint8_t zone, bottle_animation_t animation) {
+  if (zones[zone].animation == BOTTLE_ANIMATION_NETWORK && animation != BOTTLE_ANIMATION_NETWORK) {
+    // Network frames cover every bottle, so the other zones leave it too.
+    for (auto & z : zones) {
+      if (z.animation == BOTTLE_ANIMATION_NETWORK) z.animation = BOTTLE_ANIMATION_DEFAULT;
+    }
+  }
+  if (zones[zone].on && zones[zone].animation == animation) return;
+  zones[zone].animation = animation;
+  zones[zone].on = true;
+  zonesChanged = true;
+}
+
+void Control::setZoneOn(uint8_t zone, bool on) {
+  if (on) {
+    if (!pixelsOn) {
+      // Only this zone comes on.
+      for (auto & z : zones) {
+        zonesChanged |= z.on;
+        z.on = false;
+      }
+    }
+    zonesChanged |= !zones[zone].on;
+    zones[zone].on = true;
+    turnOn();
+    return;
+  }
+  zonesChanged |= zones[zone].on;
+  zones[zone].on = false;
+  for (auto const& z : zones) {
+    if (z.on) return;
+  }
+  turnOff();
+}
+
 void Control::initMQTT(void) {
-  Serial.println(F("Setting up MQTT control..."));
+  LOG(MQTT_SETUP);
 
+#if BOARD_ID == 0
   // Enable birth and last will and testament.
   interwebs->setBirth("cryptid/bottles/status", "online");
   interwebs->setWill("cryptid/bottles/status", "offline");
 
-  // Add discoveries for each device.
-  interwebs->addDiscovery("homeassistant/light/cryptid-bottles/cryptidBottles/config", discoveryJson.c_str());
-  // The `light` type has most settings, but these two do not fit within the spec.
-  interwebs->addDiscovery("homeassistant/select/glow_speed/cryptidBottles/config", discoveryJsonGlowSpeed.c_str());
-  interwebs->addDiscovery("homeassistant/select/faerie_speed/cryptidBottles/config", discoveryJsonFaerieSpeed.c_str());
-  // Power. Zap.
-  interwebs->addDiscovery("homeassistant/sensor/bus_v/cryptidBottles/config", discoveryJsonBusVoltage.c_str());
-  interwebs->addDiscovery("homeassistant/sensor/shunt_v/cryptidBottles/config", discoveryJsonShuntVoltage.c_str());
-  interwebs->addDiscovery("homeassistant/sensor/load_v/cryptidBottles/config", discoveryJsonLoadVoltage.c_str());
-  interwebs->addDiscovery("homeassistant/sensor/power/cryptidBottles/config", discoveryJsonPower.c_str());
-  interwebs->addDiscovery("homeassistant/sensor/current/cryptidBottles/config", discoveryJsonCurrent.c_str());
-  interwebs->addDiscovery("homeassistant/sensor/avg_current/cryptidBottles/config", discoveryJsonAvgCurrent.c_str());
+  // Discovery JSON is built here rather than at static init, so it doesn't hold up the first frame,
+  // and is kept to resend when Home Assistant restarts.
+  static const discovery_t discoveries[] = {
+    { "homeassistant/light/cryptid-bottles/cryptidBottles/config", discoveryLight() },
+    // The `light` type has most settings, but these two do not fit within the spec.
+    { "homeassistant/select/glow_speed/cryptidBottles/config",
+      discoverySelect("glow_speed", "Glow Speed", "play-speed", GLOW_SPEED) },
+    { "homeassistant/select/faerie_speed/cryptidBottles/config",
+      discoverySelect("faerie_speed", "Faerie Speed", "play-speed", FAERIE_SPEED) },
+    // Frame timing.
+    { "homeassistant/sensor/fps/cryptidBottles/config",
+      discoverySensor("fps", "Frame Rate", "frequency", "measurement", "Hz") },
+    { "homeassistant/sensor/dropped_frames/cryptidBottles/config",
+      discoverySensor("dropped_frames", "Dropped Frames", "", "total_increasing", "") },
+    { "homeassistant/sensor/interlace/cryptidBottles/config",
+      discoverySensor("interlace", "Interlace", "", "measurement", "") },
+    { "homeassistant/sensor/sleep/cryptidBottles/config",
+      discoverySensor("sleep", "CPU Asleep", "", "measurement", "%") },
+    { "homeassistant/sensor/worst_frame/cryptidBottles/config",
+      discoverySensor("worst_frame", "Worst Frame", "duration", "measurement", "ms") },
+    // Command to photon latency.
+    { "homeassistant/sensor/cmd_latency_p50/cryptidBottles/config",
+      discoverySensor("cmd_latency_p50", "Command Latency p50", "duration", "measurement", "ms") },
+    { "homeassistant/sensor/cmd_latency_p95/cryptidBottles/config",
+      discoverySensor("cmd_latency_p95", "Command Latency p95", "duration", "measurement", "ms") },
+    { "homeassistant/sensor/cmd_latency_max/cryptidBottles/config",
+      discoverySensor("cmd_latency_max", "Command Latency Max", "duration", "measurement", "ms") },
+    // Startup.
+    { "homeassistant/sensor/startup_pixels_ms/cryptidBottles/config",
+      discoverySensor("startup_pixels_ms", "Startup First Frame", "duration", "measurement", "ms") },
+    { "homeassistant/sensor/startup_sensors_ms/cryptidBottles/config",
+      discoverySensor("startup_sensors_ms", "Startup Sensors", "duration", "measurement", "ms") },
+    { "homeassistant/sensor/startup_network_ms/cryptidBottles/config",
+      discoverySensor("startup_network_ms", "Startup Network", "duration", "measurement", "ms") },
+#ifdef NETWORK_PIXELS
+    // Network pixels.
+    { "homeassistant/sensor/net_packets_lost/cryptidBottles/config",
+      discoverySensor("net_packets_lost", "Network Packets Lost", "", "total_increasing", "") },
+    { "homeassistant/sensor/net_latency/cryptidBottles/config",
+      discoverySensor("net_latency", "Network Latency", "duration", "measurement", "ms") },
+#endif
+    // Power. Zap. Only if the sensor started.
+    { "homeassistant/sensor/bus_v/cryptidBottles/config",
+      discoverySensor("bus_v", "Bus Voltage", "voltage", "measurement", "V"), true },
+    { "homeassistant/sensor/shunt_v/cryptidBottles/config",
+      discoverySensor("shunt_v", "Shunt Voltage", "voltage", "measurement", "mV"), true },
+    { "homeassistant/sensor/load_v/cryptidBottles/config",
+      discoverySensor("load_v", "Load Voltage", "voltage", "measurement", "V"), true },
+    { "homeassistant/sensor/power/cryptidBottles/config",
+      discoverySensor("power", "Power", "power", "measurement", "mW"), true },
+    { "homeassistant/sensor/current/cryptidBottles/config",
+      discoverySensor("current", "Current", "current", "measurement", "mA"), true },
+    { "homeassistant/sensor/avg_current/cryptidBottles/config",
+      discoverySensor("avg_current", "Average Current", "current", "measurement", "mA"), true },
+  };
+  discoveryList = discoveries;
+  discoveryCount = sizeof(discoveries) / sizeof(discoveries[0]);
+  for (uint8_t z = 0; z < LAYOUT_ZONES; z++) {
+    zoneTopics[z][ZONE_TOPIC_DISCOVERY] =
+      String("homeassistant/light/cryptid-bottles/zone_") + ZONE_LAYOUT[z].id + "/config";
+    zoneDiscoveries[z] = { zoneTopics[z][ZONE_TOPIC_DISCOVERY].c_str(), discoveryZone(ZONE_LAYOUT[z]), false };
+  }
+  // Sent on every connect; the same list is resent when Home Assistant restarts.
+  for (int16_t i = 0; i < discoveryTotal(); i++) {
+    const discovery_t& d = discovery(i);
+    if (!d.power || power_telemetry) {
+      interwebs->addDiscovery(d.topic, d.json.c_str());
+    }
+  }
+#endif
 
   // Turn lights on or off.
   interwebs->onMqtt("cryptid/bottles/on/set", [&](char* payload, uint16_t /*len*/){
-    String pStr = String(payload);
-    if (pStr == "ON" || pStr == "on" || pStr == "1") {
+    bool on;
+    if (!parseOnOff(payload, on)) {
+      LOG(UNKNOWN_ON_OFF, logText(payload));
+    } else if (on) {
       turnOn();
-    } else if (pStr == "OFF" || pStr == "on" || pStr == "0") {
-      turnOff();
     } else {
-      Serial.print(F("Unrecognized on/off command: "));
-      Serial.println(pStr);
+      turnOff();
     }
-    mqttCurrentStatus();
+    commandReceived();
   });
 
   // Set the bottles animation.
   interwebs->onMqtt("cryptid/bottles/effect/set", [&](char* payload, uint16_t /*len*/){
     pixelsOn = true;
-    if (BOTTLE_ANIMATIONS.find(payload) == BOTTLE_ANIMATIONS.end()) {
-      Serial.print(F("Effect not found: "));
-      Serial.println(payload);
-      bottleAnimation = BOTTLE_ANIMATION_WARNING;
+    bottle_animation_t animation;
+    if (!findOption(BOTTLE_ANIMATIONS, payload, animation)) {
+      LOG(EFFECT_NOT_FOUND, logText(payload));
+      animation = BOTTLE_ANIMATION_WARNING;
     }
     else {
-      Serial.print(F("Setting effect to "));
-      Serial.println(payload);
-      bottleAnimation = BOTTLE_ANIMATIONS.at(payload);
+      LOG(EFFECT, animation);
     }
+    setEffect(animation);
     turnOn();
-    mqttCurrentStatus();
+    commandReceived();
   });
 
   // Set the glow animation speed.
   interwebs->onMqtt("cryptid/bottles/glow_speed/set", [&](char* payload, uint16_t /*len*/){
-    String pStr = String(payload);
     if (bottleAnimation != BOTTLE_ANIMATION_GLOW) {
-      bottleAnimation = BOTTLE_ANIMATION_FAERIES;
+      setEffect(BOTTLE_ANIMATION_FAERIES);
     }
-    if (GLOW_SPEED.find(pStr) == GLOW_SPEED.end()) {
-      Serial.println(F("Setting glow speed to default"));
+    if (!findOption(GLOW_SPEED, payload, glowSpeed)) {
+      LOG(GLOW_SPEED_DEFAULT);
       glowSpeed = GLOW_SPEED_MEDIUM;
     } else {
-      Serial.print(F("Setting glow speed to "));
-      Serial.println(pStr);
-      glowSpeed = GLOW_SPEED.at(pStr);
+      LOG(GLOW_SPEED, glowSpeed);
     }
-    mqttCurrentStatus();
+    commandReceived();
   });
 
   // Set the faerie animation speed.
   interwebs->onMqtt("cryptid/bottles/faerie_speed/set", [&](char* payload, uint16_t /*len*/){
-    String pStr = String(payload);
-    bottleAnimation = BOTTLE_ANIMATION_FAERIES;
-    if (FAERIE_SPEED.find(pStr) == FAERIE_SPEED.end()) {
-      Serial.println(F("Setting faerie speed to default"));
+    setEffect(BOTTLE_ANIMATION_FAERIES);
+    if (!findOption(FAERIE_SPEED, payload, faerieSpeed)) {
+      LOG(FAERIE_SPEED_DEFAULT);
       faerieSpeed = FAERIE_SPEED_MEDIUM;
     } else {
-      Serial.print(F("Setting faerie speed to "));
-      Serial.println(pStr);
-      faerieSpeed = FAERIE_SPEED.at(pStr);
+      LOG(FAERIE_SPEED, faerieSpeed);
     }
-    mqttCurrentStatus();
+    commandReceived();
   });
 
   // Set the bottles brightness.
   interwebs->onMqtt("cryptid/bottles/brightness/set", [&](char* payload, uint16_t /*len*/){
     brightness = min(max(0, strtol(payload, nullptr, 10)), 255);
-    Serial.print(F("Setting brightness to "));
-    Serial.println(String(brightness));
+    LOG(BRIGHTNESS, brightness);
     if (brightness == 0) {
       turnOff();
     } else {
       turnOn();
     }
-    pxl8->setBrightness(brightness);
-    mqttCurrentStatus();
+    pxl8->fadeBrightness(tweens, brightness, BRIGHTNESS_FADE_MS);
+    commandReceived();
   });
 
   // Set white balance in degrees kelvin.
-  interwebs->onMqtt("cryptid/bottles/rgb/set", [&](char* payload, uint16_t len){
-    String pStr = String(payload);
-    int c1 = pStr.indexOf(",");
-    int c2 = pStr.lastIndexOf(",");
-    // -1 -> not found || c1 == c2 -> only one comma || no chars after second comma
-    if (c1 == -1 || c2 == -1 || c1 == c2 || len < c2 + 1) {
-      Serial.print(F("Invalid color: "));
-      Serial.println(pStr);
-      static_color = rgb_t{ 255, 255, 255 };
+  interwebs->onMqtt("cryptid/bottles/rgb/set", [&](char* payload, uint16_t /*len*/){
+    rgb_t c{ 255, 255, 255 };
+    if (!parseRGB(payload, c)) {
+      LOG(INVALID_COLOR, logText(payload));
     }
     else {
-      uint8_t r = pStr.substring(0, c1).toInt(),
-              g = pStr.substring(c1 + 1, c2).toInt(),
-              b = pStr.substring(c2 + 1).toInt();
-      Serial.print(F("Setting color to "));
-      Serial.println(pStr);
-      static_color = rgb_t{ r, g, b };
+      LOG(COLOR, packRGB(c));
     }
-    bottleAnimation = BOTTLE_ANIMATION_ILLUM;
+    setColor(c);
+    setEffect(BOTTLE_ANIMATION_ILLUM);
     turnOn();
-    mqttCurrentStatus();
+    commandReceived();
   });
 
   // Set to a given brightness at the current white balance.
   interwebs->onMqtt("cryptid/bottles/white/set", [&](char* payload, uint16_t /*len*/){
     brightness = min(max(0, strtol(payload, nullptr, 10)), 255);
-    Serial.print(F("Setting illumination to "));
-    Serial.println(String(white_balance) + "@" + String(brightness));
-    static_color = WHITE_TEMPERATURES.at(white_balance);
+    LOG(ILLUMINATION, white_balance, brightness);
+    setWhite(white_balance);
+    setEffect(BOTTLE_ANIMATION_ILLUM);
     if (brightness == 0) {
       turnOff();
     } else {
       turnOn();
     }
-    pxl8->setBrightness(brightness);
-    bottleAnimation = BOTTLE_ANIMATION_ILLUM;
-    mqttCurrentStatus();
+    pxl8->fadeBrightness(tweens, brightness, BRIGHTNESS_FADE_MS);
+    commandReceived();
   });
 
   // Set white balance in degrees kelvin.
   interwebs->onMqtt("cryptid/bottles/white_balance/set", [&](char* payload, uint16_t /*len*/){
-    white_balance = white_balance_t(min(max(MIN_WB_MIRED, roundmired(strtol(payload, nullptr, 10))), MAX_WB_MIRED));
-    Serial.print(F("Setting white balance to "));
-    Serial.println(String(white_balance));
-    static_color = WHITE_TEMPERATURES.at(white_balance);
-    bottleAnimation = BOTTLE_ANIMATION_ILLUM;
+    white_balance = white_balance_t(min(max(MIN_WB_MIRED, strtol(payload, nullptr, 10)), MAX_WB_MIRED));
+    LOG(WHITE_BALANCE, white_balance);
+    setWhite(white_balance);
+    setEffect(BOTTLE_ANIMATION_ILLUM);
     turnOn();
-    mqttCurrentStatus();
+    commandReceived();
   });
 
-  // Send discovery when Home Assistant notifies it's online.
+  // Seed random streams, to replay a recorded session.
+  interwebs->onMqtt("cryptid/bottles/seed/set", [&](char* payload, uint16_t /*len*/){
+    uint32_t seed = strtoul(payload, nullptr, 10);
+    LOG(SEED, seed);
+    random->seed(seed);
+    commandReceived();
+  });
+
+  for (uint8_t z = 0; z < LAYOUT_ZONES; z++) {
+    initZoneMQTT(z);
+  }
+
+  // Send discovery when Home Assistant notifies it's online, one message per frame.
   interwebs->onMqtt("homeassistant/status", [&](char* payload, uint16_t /*len*/){
     if (strcmp(payload, "online") == 0) {
-      interwebs->sendDiscoveries();
-      mqttCurrentStatus();
+      discoveryNext = 0;
+      statusPending = true;
     }
   });
+
+  // Publish sensors now; "reset" also clears latency and frame time stats once sent.
+  interwebs->onMqtt("cryptid/bottles/sensor/get", [&](char* payload, uint16_t /*len*/){
+    sensorsRequested = true;
+    resetStats = strcmp(payload, "reset") == 0;
+  });
+
+  // Echo an id once the next frame is shown, so a client can time the commands it sent before it
+  // from publish to photon.
+  interwebs->onMqtt("cryptid/bottles/mark/set", [&](char* payload, uint16_t /*len*/){
+    markId = strtoul(payload, nullptr, 10);
+    markPending = true;
+  });
+}
+
+void Control::initZoneMQTT(uint8_t z) {
+  String base = String("cryptid/bottles/zone/") + ZONE_LAYOUT[z].id;
+  zoneTopics[z][ZONE_TOPIC_STATE] = base + "/state";
+  zoneTopics[z][ZONE_TOPIC_ON] = base + "/on/set";
+  zoneTopics[z][ZONE_TOPIC_EFFECT] = base + "/effect/set";
+  zoneTopics[z][ZONE_TOPIC_RGB] = base + "/rgb/set";
+
+  // Turn a zone on or off.
+  interwebs->onMqtt(zoneTopics[z][ZONE_TOPIC_ON].c_str(), [this, z](char* payload, uint16_t /*len*/){
+    bool on;
+    if (!parseOnOff(payload, on)) {
+      LOG(UNKNOWN_ON_OFF, logText(payload));
+    } else {
+      LOG(ZONE_ON, z, on);
+      setZoneOn(z, on);
+    }
+    commandReceived();
+  });
+
+  // Set a zone's animation. Network can only be set for every zone.
+  interwebs->onMqtt(zoneTopics[z][ZONE_TOPIC_EFFECT].c_str(), [this, z](char* payload, uint16_t /*len*/){
+    bottle_animation_t animation;
+    if (!findOption(BOTTLE_ANIMATIONS, payload, animation) || animation == BOTTLE_ANIMATION_NETWORK) {
+      LOG(EFFECT_NOT_FOUND, logText(payload));
+      animation = BOTTLE_ANIMATION_WARNING;
+    } else {
+      LOG(ZONE_EFFECT, z, animation);
+    }
+    setZoneEffect(z, animation);
+    turnOn();
+    commandReceived();
+  });
+
+  // Set a zone's color. Sweep keeps running in it; anything else turns to Illuminate.
+  interwebs->onMqtt(zoneTopics[z][ZONE_TOPIC_RGB].c_str(), [this, z](char* payload, uint16_t /*len*/){
+    rgb_t c{ 255, 255, 255 };
+    if (!parseRGB(payload, c)) {
+      LOG(INVALID_COLOR, logText(payload));
+    }
+    zones[z].color = c;
+    zones[z].white = 0;
+    if (zones[z].animation != BOTTLE_ANIMATION_SWEEP) {
+      setZoneEffect(z, BOTTLE_ANIMATION_ILLUM);
+    }
+    setZoneOn(z, true);
+    commandReceived();
+  });
+}
+
+void Control::mqttZoneStatus(uint8_t z) {
+  static char payload[96];
+  const zone_t& zone = zones[z];
+  snprintf(payload, sizeof(payload),
+    "{\"on\":\"%s\","
+    "\"rgb\":\"%u,%u,%u\","
+    "\"effect\":\"%s\"}",
+    pixelsOn && zone.on ? "ON" : "OFF",
+    zone.color.r, zone.color.g, zone.color.b,
+    optionName(BOTTLE_ANIMATIONS, zone.animation));
+  interwebs->mqttSendMessage(zoneTopics[z][ZONE_TOPIC_STATE].c_str(), payload);
 }
 
 void Control::mqttCurrentStatus(void) {
-  String on = "ON";
-  if (!pixelsOn) on = "OFF";
-  String payload = "{\"on\":\"" + on + "\","
-    "\"brightness\":\"" + String(brightness) + "\","
-    "\"rgb\":\"" + String(static_color.r) + "," + String(static_color.g) + "," + String(static_color.b) + "\","
-    "\"white_balance\":\"" + String(white_balance) + "\","
-    "\"effect\":\"" + this->getBottleAnimationString() + "\","
-    "\"glow_speed\":\"" + this->getGlowSpeedString() + "\","
-    "\"faerie_speed\":\"" + this->getFaerieSpeedString() + "\"}";
-  interwebs->mqttSendMessage("cryptid/bottles/state", payload.c_str());
+  static char payload[256];
+  snprintf(payload, sizeof(payload),
+    "{\"on\":\"%s\","
+    "\"brightness\":\"%u\","
+    "\"rgb\":\"%u,%u,%u\","
+    "\"white_balance\":\"%u\","
+    "\"effect\":\"%s\","
+    "\"glow_speed\":\"%s\","
+    "\"faerie_speed\":\"%s\","
+    "\"seed\":\"%lu\"}",
+    pixelsOn ? "ON" : "OFF",
+    brightness,
+    static_color.r, static_color.g, static_color.b,
+    white_balance,
+    this->getBottleAnimationString(),
+    this->getGlowSpeedString(),
+    this->getFaerieSpeedString(),
+    (unsigned long)random->getSeed());
+  interwebs->mqttSendMessage("cryptid/bottles/state", payload);
+  for (uint8_t z = 0; z < LAYOUT_ZONES; z++) {
+    mqttZoneStatus(z);
+  }
+}
+
+/**
+ * @brief Format a float to two decimal places without printf float support.
+ *
+ * @param buf output
+ * @param len size of output
+ * @param v value
+ * @return buf
+ */
+static const char* formatDecimal(char* buf, size_t len, float v) {
+  int32_t c = lroundf(v * 100);
+  uint32_t a = c < 0 ? -c : c;
+  snprintf(buf, len, "%s%lu.%02lu", c < 0 ? "-" : "", (unsigned long)(a / 100), (unsigned long)(a % 100));
+  return buf;
 }
 
 void Control::mqttCurrentSensors(void) {
-  String payload = "{\"bus_v\":" + String(this->last_bus_voltage) + ","
-    "\"shunt_v\":" + String(this->last_shunt_voltage) + ","
-    "\"load_v\":" + String(this->last_load_voltage) + ","
-    "\"power\":" + String(this->last_power) + ","
-    "\"current\":" + String(this->last_current) + ","
-    "\"avg_current\":" + String(this->last_avg_current) + "}";
-  interwebs->mqttSendMessage("cryptid/bottles/sensor/state", payload.c_str());
+  static char payload[512];
+  char v[6][16];
+  snprintf(payload, sizeof(payload),
+    "{\"bus_v\":%s,"
+    "\"shunt_v\":%s,"
+    "\"load_v\":%s,"
+    "\"power\":%s,"
+    "\"current\":%s,"
+    "\"avg_current\":%s,"
+    "\"fps\":%u,"
+    "\"dropped_frames\":%lu,"
+    "\"interlace\":%u,"
+    "\"sleep\":%u,"
+    "\"worst_frame\":%lu,"
+    "\"cmd_latency_p50\":%lu,"
+    "\"cmd_latency_p95\":%lu,"
+    "\"cmd_latency_max\":%lu,"
+    "\"net_packets_lost\":%lu,"
+    "\"net_latency\":%u,"
+    "\"startup_pixels_ms\":%lu,"
+    "\"startup_sensors_ms\":%lu,"
+    "\"startup_network_ms\":%lu}",
+    formatDecimal(v[0], sizeof(v[0]), this->last_bus_voltage),
+    formatDecimal(v[1], sizeof(v[1]), this->last_shunt_voltage),
+    formatDecimal(v[2], sizeof(v[2]), this->last_load_voltage),
+    formatDecimal(v[3], sizeof(v[3]), this->last_power),
+    formatDecimal(v[4], sizeof(v[4]), this->last_current),
+    formatDecimal(v[5], sizeof(v[5]), this->last_avg_current),
+    this->target_fps,
+    (unsigned long)this->dropped_frames,
+    this->interlace,
+    this->sleep_pct,
+    (unsigned long)(this->worst_frame_us / 1000),
+    (unsigned long)latencyPercentile(50),
+    (unsigned long)latencyPercentile(95),
+    (unsigned long)(latencyMax / 1000),
+    (unsigned long)this->net_packets_lost,
+    this->net_latency,
+    (unsigned long)this->startup_ms[STARTUP_PIXELS],
+    (unsigned long)this->startup_ms[STARTUP_SENSORS],
+    (unsigned long)this->startup_ms[STARTUP_NETWORK]);
+#if BOARD_ID == 0
+  interwebs->mqttSendMessage("cryptid/bottles/sensor/state", payload);
+#else
+  // Other boards' readings aren't announced to Home Assistant, but are kept apart.
+  interwebs->mqttSendMessage("cryptid/bottles/sensor/" STRINGIFY(BOARD_ID) "/state", payload);
+#endif
+}
+
+void Control::resetTimers(uint32_t now) {
+  for (auto & last : this->lastGlowChange) {
+    last = now;
+  }
+  this->lastFaerieFly = now;
 }
 
-String Control::getBottleAnimationString(void) {
-  if (BOTTLE_ANIMATIONS_INV.find(this->bottleAnimation) == BOTTLE_ANIMATIONS_INV.end()) {
+void Control::loop(uint32_t now) {
+#if BOARD_ID == 0
+  if (discoveryNext >= 0 && interwebs->mqttIsConnected()) {
+    const discovery_t& d = discovery(discoveryNext);
+    if (!d.power || power_telemetry) {
+      interwebs->mqttSendMessage(d.topic, d.json.c_str(), true);
+    }
+    if (++discoveryNext >= discoveryTotal()) {
+      discoveryNext = -1;
+    }
+  }
+#endif
+  if (statusPending && now - lastStatus >= STATE_COALESCE_MS) {
+    statusPending = false;
+    lastStatus = now;
+    mqttCurrentStatus();
+  }
+  if (markShown) {
+    markShown = false;
+    char payload[12];
+    snprintf(payload, sizeof(payload), "%lu", (unsigned long)markId);
+    interwebs->mqttSendMessage("cryptid/bottles/mark/" STRINGIFY(BOARD_ID), payload);
+  }
+  if (sensorsRequested) {
+    sensorsRequested = false;
+    mqttCurrentSensors();
+    if (resetStats) {
+      resetStats = false;
+      memset(latencyHist, 0, sizeof(latencyHist));
+      latencyMax = 0;
+      worst_frame_us = 0;
+    }
+  }
+}
+
+const discovery_t& Control::discovery(int16_t i) const {
+  return i < discoveryCount ? discoveryList[i] : zoneDiscoveries[i - discoveryCount];
+}
+
+void Control::commandReceived(void) {
+  statusPending = true;
+  // Time from the first command, so a burst is measured from when it started.
+  if (!commandPending) {
+    commandPending = true;
+    commandMicros = micros();
+  }
+}
+
+void Control::frameShown(uint32_t shown) {
+  if (markPending) {
+    markPending = false;
+    markShown = true;
+  }
+  if (!commandPending) return;
+  commandPending = false;
+  uint32_t us = shown - commandMicros;
+  LOG(COMMAND_LATENCY, us);
+  latencyMax = max(latencyMax, us);
+  uint8_t b = 0;
+  for (uint32_t ms = us / 1000; ms && b < COMMAND_LATENCY_BUCKETS - 1; ms >>= 1) {
+    b++;
+  }
+  latencyHist[b]++;
+}
+
+uint32_t Control::latencyPercentile(uint8_t pct) {
+  uint32_t total = 0;
+  for (uint8_t b = 0; b < COMMAND_LATENCY_BUCKETS; b++) {
+    total += latencyHist[b];
+  }
+  if (!total) return 0;
+  uint32_t rank = (total * pct + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t b = 0; b < COMMAND_LATENCY_BUCKETS - 1; b++) {
+    seen += latencyHist[b];
+    if (seen >= rank) return 1UL << b;
+  }
+  // Beyond the histogram; the max is the best bound there is.
+  return latencyMax / 1000;
+}
+
+/**
+ * @brief Flag on a stored zone color that holds a white balance, in mireds, rather than RGB.
+ */
+static const uint32_t ZONE_COLOR_WHITE = 0x01000000;
+
+void Control::persist(StateStore* store, uint32_t now) {
+  store->set(STORE_KEY_ON, pixelsOn, now);
+  store->set(STORE_KEY_EFFECT, bottleAnimation, now);
+  store->set(STORE_KEY_BRIGHTNESS, brightness, now);
+  store->set(STORE_KEY_COLOR, packRGB(static_color), now);
+  store->set(STORE_KEY_WHITE_BALANCE, white_balance, now);
+  store->set(STORE_KEY_GLOW_SPEED, glowSpeed, now);
+  store->set(STORE_KEY_FAERIE_SPEED, faerieSpeed, now);
+  for (uint8_t z = 0; z < LAYOUT_ZONES; z++) {
+    const zone_t& zone = zones[z];
+    store->set((store_key_t)(STORE_KEY_ZONE_ON + z), zone.on, now);
+    store->set((store_key_t)(STORE_KEY_ZONE_EFFECT + z), zone.animation, now);
+    store->set((store_key_t)(STORE_KEY_ZONE_COLOR + z),
+      zone.white ? ZONE_COLOR_WHITE | zone.white : packRGB(zone.color), now);
+  }
+}
+
+void Control::restore(StateStore* store) {
+  uint32_t v;
+  if (store->get(STORE_KEY_ON, v)) pixelsOn = v;
+  if (store->get(STORE_KEY_EFFECT, v) && optionName(BOTTLE_ANIMATIONS, (bottle_animation_t)v)) {
+    setEffect((bottle_animation_t)v);
+  }
+  if (store->get(STORE_KEY_BRIGHTNESS, v)) brightness = min(v, (uint32_t)255);
+  if (store->get(STORE_KEY_COLOR, v)) setColor(unpackRGB(v));
+  // Outside the range, such as from before white balance was in true mireds, it's left default.
+  if (store->get(STORE_KEY_WHITE_BALANCE, v) && v >= MIN_WB_MIRED && v <= MAX_WB_MIRED) white_balance = v;
+  // A color that was a white balance is calibrated per bottle again.
+  if (packRGB(static_color) == whiteBalanceColor((int32_t)white_balance << 4)) setWhite(white_balance);
+  if (store->get(STORE_KEY_GLOW_SPEED, v) && optionName(GLOW_SPEED, (glow_speed_t)v)) {
+    glowSpeed = (glow_speed_t)v;
+  }
+  if (store->get(STORE_KEY_FAERIE_SPEED, v) && optionName(FAERIE_SPEED, (faerie_speed_t)v)) {
+    faerieSpeed = (faerie_speed_t)v;
+  }
+  // Zones saved apart from the whole install override it; without them, every zone has its settings.
+  for (uint8_t z = 0; z < LAYOUT_ZONES; z++) {
+    zone_t& zone = zones[z];
+    if (store->get((store_key_t)(STORE_KEY_ZONE_ON + z), v)) zone.on = v;
+    if (store->get((store_key_t)(STORE_KEY_ZONE_EFFECT + z), v)
+        && optionName(BOTTLE_ANIMATIONS, (bottle_animation_t)v)) {
+      zone.animation = (bottle_animation_t)v;
+    }
+    if (store->get((store_key_t)(STORE_KEY_ZONE_COLOR + z), v)) {
+      white_balance_t mired = v & ~ZONE_COLOR_WHITE;
+      if (!(v & ZONE_COLOR_WHITE)) {
+        zone.color = unpackRGB(v);
+        zone.white = 0;
+      } else if (mired >= MIN_WB_MIRED && mired <= MAX_WB_MIRED) {
+        zone.color = whiteBalanceRGB(mired);
+        zone.white = mired;
+      }
+    }
+  }
+  zonesChanged = true;
+  LOG(STATE_RESTORED, bottleAnimation, brightness);
+}
+
+const char* Control::getBottleAnimationString(void) {
+  const char* name = optionName(BOTTLE_ANIMATIONS, this->bottleAnimation);
+  if (name == nullptr) {
     this->bottleAnimation = BOTTLE_ANIMATION_DEFAULT;
+    name = optionName(BOTTLE_ANIMATIONS, this->bottleAnimation);
   }
-  return BOTTLE_ANIMATIONS_INV.at(this->bottleAnimation);
+  return name;
 }
 
-String Control::getGlowSpeedString(void) {
-  if (GLOW_SPEED_INV.find(this->glowSpeed) == GLOW_SPEED_INV.end()) {
+const char* Control::getGlowSpeedString(void) {
+  const char* name = optionName(GLOW_SPEED, this->glowSpeed);
+  if (name == nullptr) {
     this->glowSpeed = GLOW_SPEED_MEDIUM;
+    name = optionName(GLOW_SPEED, this->glowSpeed);
   }
-  return GLOW_SPEED_INV.at(this->glowSpeed);
+  return name;
 }
 
-String Control::getFaerieSpeedString(void) {
-  if (FAERIE_SPEED_INV.find(this->faerieSpeed) == FAERIE_SPEED_INV.end()) {
+const char* Control::getFaerieSpeedString(void) {
+  const char* name = optionName(FAERIE_SPEED, this->faerieSpeed);
+  if (name == nullptr) {
     this->faerieSpeed = FAERIE_SPEED_MEDIUM;
+    name = optionName(FAERIE_SPEED, this->faerieSpeed);
   }
-  return FAERIE_SPEED_INV.at(this->faerieSpeed);
+  return name;
 }
 
 // ---------- Animation ----------
 
-rgb_t Control::getRandomWhiteBalance(void) {
-  auto it = WHITE_TEMPERATURES.begin();
-  std::advance(it, rand() % WHITE_TEMPERATURES.size());
-  return it->second;
+white_balance_t Control::getRandomWhiteBalance(void) {
+  return random->get(RANDOM_WHITE_BALANCE).range(MIN_WB_MIRED, MAX_WB_MIRED + 1);
 }
 
-bool Control::shouldChangeGlow(void) {
-  if (millis() - this->lastGlowChange < 2500) return false; // Don't change too often.
-  if (random(0, this->glowSpeed - 1000) == 0) return true;
-  if (millis() - this->lastGlowChange > this->glowSpeed) return true;
+bool Control::shouldChangeGlow(const FrameContext& ctx, const effect_batch_t& batch) {
+  uint32_t elapsed = ctx.time - this->lastGlowChange[batch.animation];
+  if (elapsed < 2500) return false; // Don't change too often.
+  if (random->get(RANDOM_GLOW).range(0, this->glowSpeed - 1000) == 0) return true;
+  if (elapsed > this->glowSpeed) return true;
   return false;
 }
 
-bool Control::shouldShowFaerie(void) {
+bool Control::shouldShowFaerie(const FrameContext& ctx) {
   // If a faerie is already flying, keep displaying animation.
   if (this->faerieFlying) return true;
   // Randomly spawn a faerie.
-  if (random(0, this->faerieSpeed - 1000) == 0) return true;
+  if (random->get(RANDOM_FAERIE).range(0, this->faerieSpeed - 1000) == 0) return true;
   // Timeout for spawning a faerie has been reached.
-  if (millis() - this->lastFaerieFly > this->faerieSpeed) return true;
+  if (ctx.time - this->lastFaerieFly > this->faerieSpeed) return true;
   return false;
 }
 
-void Control::updateRandomBottleHue(void) {
-  uint8_t id = random(0, this->bottles->size());
-  uint16_t hueStart = random(0, 360);
-  uint16_t hueEnd = hueStart + random(30, 40);
-  this->bottles->at(id)->setHue(hueStart, hueEnd, random(1500, 2500));
-  this->lastGlowChange = millis();
+void Control::updateRandomBottleHue(const FrameContext& ctx, const effect_batch_t& batch) {
+  Random& r = random->get(RANDOM_GLOW);
+  uint8_t id = r.range(0, batch.count);
+  uint16_t hueStart = r.range(0, 360);
+  uint16_t hueEnd = hueStart + r.range(30, 40);
+  batch.bottles[id]->setHue(ctx, hueStart, hueEnd, r.range(1500, 2500));
+  this->lastGlowChange[batch.animation] = ctx.time;
 }
 
-void Control::updateRandomBottleWhiteBalance(void) {
-  uint8_t id = random(0, this->bottles->size());
-  rgb_t c = this->getRandomWhiteBalance();
-  this->bottles->at(id)->setColor(c, random(1500, 2500));
-  this->lastGlowChange = millis();
+void Control::updateRandomBottleWhiteBalance(const FrameContext& ctx, const effect_batch_t& batch) {
+  Random& r = random->get(RANDOM_GLOW);
+  uint8_t id = r.range(0, batch.count);
+  white_balance_t mired = this->getRandomWhiteBalance();
+  batch.bottles[id]->setWhiteBalance(ctx, mired, r.range(1500, 2500));
+  this->lastGlowChange[batch.animation] = ctx.time;
 }
 
-void Control::showFaerie(void) {
+void Control::showFaerie(const FrameContext& ctx, const effect_batch_t& batch) {
+  // A faerie whose zone changed effect leaves.
+  if (this->faerieBottle != nullptr &&
+      std::find(batch.bottles, batch.bottles + batch.count, this->faerieBottle) == batch.bottles + batch.count) {
+    this->faerieBottle = nullptr;
+  }
   // If a new faerie, pick a random bottle.
-  if (this->faerieBottle == -1) {
-    this->faerieBottle = random(0, this->bottles->size());
-    this->bottles->at(this->faerieBottle)->spawnFaerie(random(8, 14) * 0.1);
+  if (this->faerieBottle == nullptr) {
+    Random& r = random->get(RANDOM_FAERIE);
+    this->faerieBottle = batch.bottles[r.range(0, batch.count)];
+    this->faerieBottle->spawnFaerie(ctx, r.range(8, 14) * 256 / 10);
   }
-  this->faerieFlying = this->bottles->at(this->faerieBottle)->showFaerie();
+  this->faerieFlying = this->faerieBottle->showFaerie(ctx);
   // After animation, reset bottle and log time.
   if (!this->faerieFlying) {
-    this->faerieBottle = -1;
-    this->lastFaerieFly = millis();
+    this->faerieBottle = nullptr;
+    this->lastFaerieFly = ctx.time;
     this->faerieFlying = false;
   }
 }
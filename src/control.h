@@ -5,169 +5,57 @@
 #include <MQTT_Looped.h>
 #include "def.h"
 #include "bottle.h"
+#include "random.h"
+#include "store.h"
+#include "zone.h"
 
 /**
- * @brief Convert map values to a JSON string array.
+ * @brief Find an option by its MQTT string.
  *
- * @tparam T 
- * @param v 
- * @return const String 
+ * @tparam T
+ * @tparam N
+ * @param options
+ * @param name MQTT payload
+ * @param value set if found
+ * @return bool found
  */
-template<typename T>
-const inline String jsonStr(std::map<String, T> v) {
-  String s = "[";
-  bool f = true;
-  for (auto const& x : v) {
-    if (!f) s += ",";
-    s += "\"" + x.first + "\"";
-    f = false;
+template<typename T, size_t N>
+inline bool findOption(const option_t<T> (&options)[N], const char* name, T& value) {
+  for (auto const& x : options) {
+    if (strcmp(x.name, name) == 0) {
+      value = x.value;
+      return true;
+    }
   }
-  s += "]";
-  return s;
+  return false;
 }
 
 /**
- * @brief Discovery JSON for light.
+ * @brief Get the MQTT string of an option.
  *
- * @see https://www.home-assistant.io/integrations/mqtt
+ * @tparam T
+ * @tparam N
+ * @param options
+ * @param value
+ * @return const char* name, or nullptr if not an option
  */
-const static String discoveryJson = []() -> String {
-  String json = F(R"JSON({
-    "~":"cryptid/bottles",
-    "name":"Cryptid Bottles",
-    "uniq_id":"cryptid-bottles",
-    "ic":"mdi:bottle-tonic-outline",
-    "stat_t":"~/state",
-    "stat_val_tpl":"{{ value_json.on }}",
-    "cmd_t":"~/on/set",
-    "on_cmd_type":"brightness",
-    "bri_cmd_t":"~/brightness/set",
-    "bri_val_tpl":"{{ value_json.brightness }}",
-    "bri_scl":255,
-    "rgb_cmd_t":"~/rgb/set",
-    "rgb_val_tpl":"{{ value_json.rgb }}",
-    "whit_cmd_t":"~/white/set",
-    "whit_scl":255,
-    "clr_temp_cmd_t":"~/white_balance/set",
-    "clr_temp_val_tpl":"{{ value_json.white_balance }}",
-    "min_mirs":)JSON");
-  json += String(MIN_WB_MIRED);
-  json += F(R"JSON(,
-    "max_mirs":)JSON");
-  json += String(MAX_WB_MIRED);
-  json += F(R"JSON(,
-    "fx_cmd_t":"~/effect/set",
-    "fx_list":)JSON");
-  json += jsonStr(BOTTLE_ANIMATIONS);
-  json += F(R"JSON(,
-    "fx_val_tpl":"{{ value_json.effect }}",
-    "dev":{"ids":["cryptidBottles"],"name":"Cryptid Bottles"}})JSON");
-  json.replace("\n    ",""); // shrink data
-  return json;
-}();
-
-/**
- * @brief Get discovery JSON for Select setting.
- * 
- * @tparam T map setting
- * @param id
- * @param name
- * @param icon material design icon
- * @param options map<String value, enum setting>
- * @return const String
- *
- * @see https://www.home-assistant.io/integrations/mqtt
- * @see https://pictogrammers.com/library/mdi/
- */
-template<typename T>
-const static String discoverySelect(String id, String name, String icon, std::map<String, T> options) {
-  return "{\"~\":\"cryptid/bottles\","
-         "\"name\":\"" + name + "\","
-         "\"uniq_id\":\"cryptid-bottles-" + id + "\","
-         "\"ic\":\"mdi:" + icon + "\","
-         "\"stat_t\":\"~/state\","
-         "\"cmd_t\":\"~/" + id + "/set\","
-         "\"val_tpl\":\"{{ value_json." + id + " }}\","
-         "\"ops\":" + jsonStr(options) + ","
-         "\"dev\":{\"ids\":[\"cryptidBottles\"],\"name\":\"Cryptid Bottles\"}}";
-}
-
-/**
- * @brief Discovery JSON for Glow Speed.
- */
-const static String discoveryJsonGlowSpeed = discoverySelect("glow_speed", "Glow Speed", "play-speed", GLOW_SPEED);
-
-/**
- * @brief Discovery JSON for Faerie Speed.
- */
-const static String discoveryJsonFaerieSpeed = discoverySelect("faerie_speed", "Faerie Speed", "play-speed", FAERIE_SPEED);
-
-/**
- * @brief Get discovery JSON for Sensor.
- * 
- * @tparam T map setting
- * @param id
- * @param name
- * @param device_class type of sensor/data
- * @param state_class measurement, total, or total_increasing
- * @param unit measurement unit, such as mW
- * @return const String
- *
- * @see https://www.home-assistant.io/integrations/mqtt
- * @see https://www.home-assistant.io/integrations/sensor/#device-class
- * @see https://developers.home-assistant.io/docs/core/entity/sensor/#available-state-classes
- */
-const static String discoverySensor(String id, String name, String device_class, String state_class, String unit) {
-  return "{\"~\":\"cryptid/bottles/sensor\","
-         "\"name\":\"" + name + "\","
-         "\"uniq_id\":\"cryptid-bottles-" + id + "\","
-         "\"dev_cla\":\"" + device_class + "\","
-         "\"stat_cla\":\"" + state_class + "\","
-         "\"unit_of_meas\":\"" + unit + "\","
-         "\"stat_t\":\"~/state\","
-         "\"val_tpl\":\"{{ value_json." + id + " }}\","
-         "\"dev\":{\"ids\":[\"cryptidBottles\"],\"name\":\"Cryptid Bottles\"}}";
+template<typename T, size_t N>
+inline const char* optionName(const option_t<T> (&options)[N], T value) {
+  for (auto const& x : options) {
+    if (x.value == value) return x.name;
+  }
+  return nullptr;
 }
 
 /**
- * @brief Discovery JSON for Bus Voltage.
- */
-const static String discoveryJsonBusVoltage = discoverySensor("bus_v", "Bus Voltage", "voltage", "measurement", "V");
-
-/**
- * @brief Discovery JSON for Shunt Voltage.
- */
-const static String discoveryJsonShuntVoltage = discoverySensor("shunt_v", "Shunt Voltage", "voltage", "measurement", "mV");
-
-/**
- * @brief Discovery JSON for Load Voltage.
- */
-const static String discoveryJsonLoadVoltage = discoverySensor("load_v", "Load Voltage", "voltage", "measurement", "V");
-
-/**
- * @brief Discovery JSON for Power.
- */
-const static String discoveryJsonPower = discoverySensor("power", "Power", "power", "measurement", "mW");
-
-/**
- * @brief Discovery JSON for Current.
- */
-const static String discoveryJsonCurrent = discoverySensor("current", "Current", "current", "measurement", "mA");
-
-/**
- * @brief Discovery JSON for Average Current.
- */
-const static String discoveryJsonAvgCurrent = discoverySensor("avg_current", "Average Current", "current", "measurement", "mA");
-
-/**
- * @brief Round mired value to the nearest value that has an enum.
- *
- * @param n mireds
- * @return mired, rounded
+ * @brief A Home Assistant discovery topic and its JSON.
  */
-constexpr int roundmired(int n) {
-  return n + abs((n % 5) - 5);
-}
+typedef struct {
+  const char* topic;
+  String json;
+  // Power sensor, only announced if it started.
+  bool power;
+} discovery_t;
 
 /**
  * @brief This class provides control via MQTT for various settings/options.
@@ -178,8 +66,12 @@ class Control {
      * @brief Constructor.
      *
      * @param interwebs Pointer to Interwebs object.
+     * @param bottles Pointer to Bottle objects array.
+     * @param random Pointer to random streams.
+     * @param tweens Pointer to fading values.
      */
-    Control(Pxl8* pxl8, MQTT_Looped* interwebs, std::vector<Bottle*>* bottles);
+    Control(Pxl8* pxl8, MQTT_Looped* interwebs, std::vector<Bottle*>* bottles, RandomStreams* random,
+            TweenPool* tweens);
 
     /**
      * @brief Whether to display pixels.
@@ -192,10 +84,21 @@ class Control {
     uint8_t brightness = 127;
 
     /**
-     * @brief Current animation.
+     * @brief Animation last set for every zone.
      */
     bottle_animation_t bottleAnimation = BOTTLE_ANIMATION_DEFAULT;
 
+    /**
+     * @brief Each zone's effect and settings, in ZONE_LAYOUT order.
+     */
+    zone_t zones[LAYOUT_ZONES];
+
+    /**
+     * @brief Whether a zone's effect, or whether it's on, changed since the render plan was
+     *        built. Cleared by the frame loop.
+     */
+    bool zonesChanged = true;
+
     /**
      * @brief Glow hue change timeout speed.
      */
@@ -209,7 +112,7 @@ class Control {
     /**
      * @brief Global white balance.
      */
-    white_balance_t white_balance = 65;
+    white_balance_t white_balance = DEFAULT_WB_MIRED;
 
     /**
      * @brief Global color.
@@ -246,6 +149,56 @@ class Control {
      */
     float last_avg_current = 0;
 
+    /**
+     * @brief Frame rate chosen for the current animation.
+     */
+    uint16_t target_fps = MAX_FPS;
+
+    /**
+     * @brief Frames that missed their deadline since startup.
+     */
+    uint32_t dropped_frames = 0;
+
+    /**
+     * @brief Frames the current animation's render is spread over; above 1 means overloaded.
+     */
+    uint8_t interlace = 1;
+
+    /**
+     * @brief Share of time the CPU slept between frames since sensors were last published.
+     */
+    uint8_t sleep_pct = 0;
+
+    /**
+     * @brief Longest frame since stats were last reset, in us.
+     */
+    uint32_t worst_frame_us = 0;
+
+    /**
+     * @brief Network pixel packets missed since startup.
+     */
+    uint32_t net_packets_lost = 0;
+
+    /**
+     * @brief Average time from network pixels arriving to being shown, in ms.
+     */
+    uint16_t net_latency = 0;
+
+    /**
+     * @brief Time since reset each startup stage finished, in ms.
+     */
+    uint32_t startup_ms[STARTUP_DONE] = {};
+
+    /**
+     * @brief Whether the power sensor started. Power isn't published if not.
+     */
+    bool power_telemetry = false;
+
+    /**
+     * @brief Whether sensors should be published this frame, on schedule or when asked over MQTT.
+     */
+    bool sensorsRequested = false;
+
     /**
      * @brief Turn on light and check brightness is not zero.
      */
@@ -256,6 +209,45 @@ class Control {
      */
     void turnOff(void);
 
+    /**
+     * @brief Set every zone's effect, and turn them on.
+     *
+     * @param animation
+     */
+    void setEffect(bottle_animation_t animation);
+
+    /**
+     * @brief Set every zone's color.
+     *
+     * @param c RGB
+     */
+    void setColor(rgb_t c);
+
+    /**
+     * @brief Set every zone's color to a white balance.
+     *
+     * @param mired
+     */
+    void setWhite(white_balance_t mired);
+
+    /**
+     * @brief Set a zone's effect, and turn it on. Network drives every bottle, so leaving it in
+     *        one zone leaves it in all.
+     *
+     * @param zone index in ZONE_LAYOUT
+     * @param animation
+     */
+    void setZoneEffect(uint8_t zone, bottle_animation_t animation);
+
+    /**
+     * @brief Turn a zone on or off. Turning one on while the lights are off lights only it;
+     *        turning the last one off turns the lights off.
+     *
+     * @param zone index in ZONE_LAYOUT
+     * @param on
+     */
+    void setZoneOn(uint8_t zone, bool on);
+
     /**
      * @brief Send all current MQTT status for settings.
      */
@@ -271,62 +263,113 @@ class Control {
      */
     void initMQTT(void);
 
+    /**
+     * @brief Start the glow and faerie timers on the frame clock. Call once it's set, and again
+     *        whenever it steps.
+     *
+     * @param now frame time, ms
+     */
+    void resetTimers(uint32_t now);
+
+    /**
+     * @brief Send pending discovery, one message per call, and status, at most every
+     *        STATE_COALESCE_MS. Call each frame after interwebs.
+     *
+     * @param now ms
+     */
+    void loop(uint32_t now);
+
+    /**
+     * @brief Record command to photon latency, and echo any mark received before the frame. Call
+     *        after each frame is shown.
+     *
+     * @param shown micros() after show
+     */
+    void frameShown(uint32_t shown);
+
+    /**
+     * @brief Save current settings. Written once they settle.
+     *
+     * @param store
+     * @param now ms
+     */
+    void persist(StateStore* store, uint32_t now);
+
+    /**
+     * @brief Restore saved settings.
+     *
+     * @param store
+     */
+    void restore(StateStore* store);
+
     /**
      * @brief Get the Bottle Animation string for MQTT.
      * 
-     * @return String 
+     * @return const char*
      */
-    String getBottleAnimationString(void);
+    const char* getBottleAnimationString(void);
 
     /**
      * @brief Get the Glow Speed string for MQTT.
      * 
-     * @return String 
+     * @return const char*
      */
-    String getGlowSpeedString(void);
+    const char* getGlowSpeedString(void);
 
     /**
      * @brief Get the Faerie Speed string for MQTT.
      * 
-     * @return String 
+     * @return const char*
      */
-    String getFaerieSpeedString(void);
+    const char* getFaerieSpeedString(void);
 
     /**
-     * @brief Get a random white balance in rgb.
+     * @brief Get a random white balance.
      *
-     * @return rgb_t 
+     * @return mireds
      */
-    rgb_t getRandomWhiteBalance(void);
+    white_balance_t getRandomWhiteBalance(void);
 
     /**
-     * @brief Whether it's time for a bottle to change glow hues.
+     * @brief Whether it's time for a bottle in a batch to change glow hues.
      * 
+     * @param ctx Current frame.
+     * @param batch bottles running a glow effect
      * @return bool
      */
-    bool shouldChangeGlow(void);
+    bool shouldChangeGlow(const FrameContext& ctx, const effect_batch_t& batch);
 
     /**
      * @brief Whether a faerie should be rendered.
      * 
+     * @param ctx Current frame.
      * @return bool
      */
-    bool shouldShowFaerie(void);
+    bool shouldShowFaerie(const FrameContext& ctx);
 
     /**
      * @brief Update the hue of a random bottle.
+     *
+     * @param ctx Current frame.
+     * @param batch bottles to pick from
      */
-    void updateRandomBottleHue(void);
+    void updateRandomBottleHue(const FrameContext& ctx, const effect_batch_t& batch);
 
     /**
      * @brief Update the white balance of a random bottle.
+     *
+     * @param ctx Current frame.
+     * @param batch bottles to pick from
      */
-    void updateRandomBottleWhiteBalance(void);
+    void updateRandomBottleWhiteBalance(const FrameContext& ctx, const effect_batch_t& batch);
 
     /**
      * @brief Render faerie animation at current status in current (random) bottle.
+     *
+     * @param ctx Current frame.
+     * @param batch bottles a new faerie can pick from
      */
-    void showFaerie(void);
+    void showFaerie(const FrameContext& ctx, const effect_batch_t& batch);
 
   private:
     /**
@@ -345,9 +388,20 @@ class Control {
     std::vector<Bottle*>* bottles;
 
     /**
-     * @brief Last time a bottle changed hues.
+     * @brief Pointer to random streams.
+     */
+    RandomStreams* random;
+
+    /**
+     * @brief Pointer to fading values.
      */
-    uint32_t lastGlowChange;
+    TweenPool* tweens;
+
+    /**
+     * @brief Last time a bottle changed hues, per effect. A plan has one batch per effect, so each
+     *        glow batch keeps its own pace.
+     */
+    uint32_t lastGlowChange[BOTTLE_ANIMATION_MAX] = {};
 
     /**
      * @brief Whether a faerie is currently spawned.
@@ -357,12 +411,131 @@ class Control {
     /**
      * @brief Last time a faerie flew.
      */
-    uint32_t lastFaerieFly = millis();
+    uint32_t lastFaerieFly = 0;
+
+    /**
+     * @brief Bottle a faerie is currently in, or nullptr.
+     */
+    Bottle* faerieBottle = nullptr;
+
+    /**
+     * @brief Discovery kept to resend when Home Assistant restarts.
+     */
+    const discovery_t* discoveryList = nullptr;
+
+    /**
+     * @brief Number of discovery messages.
+     */
+    int16_t discoveryCount = 0;
+
+    /**
+     * @brief Next discovery message to resend, or -1 if none. See discovery().
+     */
+    int16_t discoveryNext = -1;
+
+    /**
+     * @brief A discovery message, from discoveryList then zoneDiscoveries.
+     *
+     * @param i 0 to discoveryTotal() - 1
+     * @return discovery
+     */
+    const discovery_t& discovery(int16_t i) const;
+
+    /**
+     * @brief Number of discovery messages, zones included.
+     *
+     * @return count
+     */
+    int16_t discoveryTotal(void) const {
+      return discoveryCount + (int16_t)LAYOUT_ZONES;
+    }
+
+    /**
+     * @brief Discovery of each zone's light.
+     */
+    discovery_t zoneDiscoveries[LAYOUT_ZONES];
+
+    /**
+     * @brief MQTT topics of each zone, kept for the client to refer to.
+     */
+    String zoneTopics[LAYOUT_ZONES][ZONE_TOPICS];
+
+    /**
+     * @brief Whether settings changed since status was last published.
+     */
+    bool statusPending = false;
+
+    /**
+     * @brief Last time status was published.
+     */
+    uint32_t lastStatus = 0;
+
+    /**
+     * @brief Whether a command is waiting to be shown.
+     */
+    bool commandPending = false;
+
+    /**
+     * @brief micros() the first command not yet shown arrived.
+     */
+    uint32_t commandMicros = 0;
+
+    /**
+     * @brief Id of the last mark received, echoed once a frame after it is shown.
+     */
+    uint32_t markId = 0;
+
+    /**
+     * @brief Whether a mark is waiting to be shown.
+     */
+    bool markPending = false;
 
     /**
-     * @brief Id of bottle a faerie is currently in.
+     * @brief Whether a mark has been shown and its echo is due.
+     */
+    bool markShown = false;
+
+    /**
+     * @brief Command to photon latency counts; bucket n is under 2^n ms, the last everything above.
+     */
+    uint32_t latencyHist[COMMAND_LATENCY_BUCKETS] = {};
+
+    /**
+     * @brief Longest command to photon latency, in us.
+     */
+    uint32_t latencyMax = 0;
+
+    /**
+     * @brief Whether to clear stats once sensors are published.
+     */
+    bool resetStats = false;
+
+    /**
+     * @brief Note a command changed settings: status is due, and its latency is timed.
+     */
+    void commandReceived(void);
+
+    /**
+     * @brief Subscribe to a zone's commands.
+     *
+     * @param zone index in ZONE_LAYOUT
+     */
+    void initZoneMQTT(uint8_t zone);
+
+    /**
+     * @brief Send a zone's status.
+     *
+     * @param zone index in ZONE_LAYOUT
+     */
+    void mqttZoneStatus(uint8_t zone);
+
+    /**
+     * @brief Command to photon latency at a percentile, rounded up to its histogram bucket.
+     *
+     * @param pct 0-100
+     * @return ms
      */
-    int8_t faerieBottle = -1;
+    uint32_t latencyPercentile(uint8_t pct);
 
 };
 
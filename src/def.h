@@ -3,7 +3,6 @@
 
 #include <functional>
 #include <vector>
-#include <map>
 using namespace std;
 #include <Arduino.h>
 #include <Adafruit_NeoPixel.h>
@@ -12,18 +11,201 @@ using namespace std;
 // Max frames per second.
 #define MAX_FPS 120
 
-// Limit in ms that a frame should fall within.
-#define SLOW_FRAME_LIMIT 14
+// Min frames per second, regardless of animation cost.
+#define MIN_FPS 10
+
+// Frames per second with the lights off. Only MQTT and sensors are serviced, sleeping in between.
+#define IDLE_FPS 20
+
+// Microseconds before a frame is due that the frame timer wakes the CPU, to spin for the rest.
+#define FRAME_TICK_SPIN_US 100
+
+// Time to transmit one pixel (24 bits at 800 KHz) and to latch a frame, in microseconds.
+#define PIXEL_TRANSMIT_US 30
+#define PIXEL_LATCH_US 300
+
+// Most frames an animation's render may be spread over, a share of bottles each frame, when
+// rendering everything takes too long for its frame rate.
+#define INTERLACE_MAX 4
+
+// Limit in ms that a frame may run past its scheduled interval.
+#define SLOW_FRAME_LIMIT 6
+
+// Target in ms from reset to the first frame shown. Missing it is logged.
+#define STARTUP_FIRST_FRAME_MS 250
 
 // How often in seconds current status is published.
 #define STATE_UPDATE_INTERVAL 240
 
+// Minimum ms between status messages after commands, so a burst of commands sends one.
+#define STATE_COALESCE_MS 250
+
+// Histogram buckets for command to photon latency, doubling from 1 ms.
+#define COMMAND_LATENCY_BUCKETS 12
+
 // How often in seconds the power sensor is measured.
 #define POWER_MEASURE_INTERVAL 15
 
 // How often memory is measured.
 #define MEMORY_MEASURE_INTERVAL 120
 
+// Uncomment to allocate bottles and the pixel driver from static storage sized at compile time.
+// Once setup() returns, heap use is counted and logged with the memory measurement.
+// #define STATIC_ALLOC
+
+// Uncomment (with STATIC_ALLOC) to trap on heap use after setup() rather than count it.
+// #define STATIC_ALLOC_TRAP
+
+// Uncomment for an 8-bit palette index framebuffer alongside the RGB one. Rain, Rainbow, and
+// Test White then write indices, and brightness is applied to their palette rather than every
+// pixel when the frame is committed. Faster, but costs 1 more byte per pixel.
+// #define PALETTE_PIXELS
+
+// Time in ms to crossfade from one effect to the next. Both render until it's done.
+#define EFFECT_FADE_MS 1000
+
+// Uncomment to switch effects at once rather than crossfade, saving the 4 bytes per pixel of the
+// effect fading out. For long layouts.
+// #define NO_CROSSFADE
+
+// Spans each overlay holds a frame: a faerie and its trail in every bottle, or an alert over it.
+#define OVERLAY_SPANS (MAX_BOTTLES * 3)
+
+// Uncomment to pulse the bottles over the current effect while WiFi (blue) or MQTT (orange) is down.
+// #define NETWORK_ALERTS
+
+// Opacity (0-255) of network alerts over the effect.
+#define ALERT_OPACITY 160
+
+// Time in ms to fade to a new brightness set over MQTT.
+#define BRIGHTNESS_FADE_MS 400
+
+// Most values fading at once: each bottle's hue range and color, brightness, and a few more.
+#define TWEEN_POOL_SIZE (MAX_BOTTLES * 3 + 4)
+
+// Noise effect detail, in lattice cells across LAYOUT_SPAN_MM.
+#define NOISE_SCALE 24
+
+// Noise effect drift, in 1/256 lattice units per 1024 ms.
+#define NOISE_SPEED 96
+
+// Length in mm of a rain streak.
+#define RAIN_DROP_MM 160
+
+// Time in ms for the sweep effect to cross LAYOUT_SPAN_MM.
+#define SWEEP_PERIOD_MS 4000
+
+// Half width in mm of the sweep effect's band.
+#define SWEEP_WIDTH_MM 120
+
+// Time in ms for the sweep effect's trail to fade out.
+#define SWEEP_TRAIL_MS 1500
+
+// Uncomment to time the noise effect's fixed point noise at boot, and log its error from floating
+// point.
+// #define NOISE_BENCHMARK
+
+// Uncomment to time the color primitives at boot against the float and loop helpers they replaced.
+// #define COLOR_BENCHMARK
+
+// Uncomment to log a hash of every committed frame, for checking effect output is unchanged.
+// #define LOG_FRAME_HASH
+
+// Most verbose log messages compiled in: 1 error, 2 warning, 3 info, 4 debug.
+#define LOG_LEVEL 3
+
+// Log records queued until there is time to send them. Must be a power of 2.
+#define LOG_RING_SIZE 64
+
+// Comment out to not save state (effect, brightness, colors, speeds) in QSPI flash for restoring
+// after a reset.
+#define PERSIST_STATE
+
+// Flash sectors used for saved state, and their size in bytes.
+#define STORE_SECTORS 4
+#define STORE_SECTOR_SIZE 4096
+
+// Time in ms state must be unchanged before it's saved, to save flash writes.
+#define STORE_SETTLE_MS 5000
+
+// Uncomment to compile in streaming of the framebuffer over MQTT, for tools/viewer.py.
+// #define FRAME_STREAM
+
+// Frames per second streamed, and the slowest the stream backs off to when publishing is slow.
+#define FRAME_STREAM_FPS 10
+#define FRAME_STREAM_MIN_FPS 1
+
+// Longest in microseconds a frame stream publish may take before the stream backs off.
+#define FRAME_STREAM_BUDGET_US 4000
+
+// Largest encoded stream frame in bytes. Bigger changes are spread over several frames.
+#define FRAME_STREAM_MAX_BYTES 1024
+
+// Stream frames between keyframes.
+#define FRAME_STREAM_KEYFRAME 50
+
+// Uncomment to compile in the Network effect, showing pixels sent by a show controller over DDP or
+// E1.31 (unicast).
+// #define NETWORK_PIXELS
+
+// UDP ports for DDP and E1.31.
+#define NETWORK_DDP_PORT 4048
+#define NETWORK_E131_PORT 5568
+
+// First E1.31 universe, and how many are listened to, at 170 pixels each.
+#define NETWORK_E131_UNIVERSE 1
+#define NETWORK_E131_UNIVERSES 24
+
+// Complete network frames buffered, and how long in ms each is held to smooth out network jitter.
+#define NETWORK_JITTER_FRAMES 3
+#define NETWORK_JITTER_MS 20
+
+// Largest network packet read, and most packets read per socket each frame.
+#define NETWORK_PACKET_BYTES 1460
+#define NETWORK_PACKETS_PER_FRAME 8
+
+// Uncomment to seed random streams with a fixed value instead of reading an unused analog pin.
+// The seed can also be set over MQTT to replay a session.
+// #define RANDOM_SEED 1
+
+// Id of this board, in installations with several. Board 0 keeps time for the others and is the
+// one announced to Home Assistant; give the others 1, 2, ...
+#define BOARD_ID 0
+
+// Header in src/ with BOTTLE_LAYOUT, LAYOUT_SPAN_MM, and ZONE_LAYOUT to use in place of those in
+// src/layout.h, e.g. to keep several installations' layouts apart.
+// #define LAYOUT_CONFIG "layout_gallery.h"
+
+// Index of this board's first bottle across the installation, so effects line up across boards.
+#define BOARD_BOTTLE_OFFSET 0
+
+// How often in ms boards other than 0 sync their clock, and how often while first syncing.
+#define TIME_SYNC_INTERVAL_MS 4000
+#define TIME_SYNC_FAST_MS 250
+
+// Time sync measurements kept; the one with the shortest round trip is used.
+#define TIME_SYNC_SAMPLES 8
+
+// Shortest time in ms between measurements used to estimate clock skew.
+#define TIME_SYNC_SKEW_BASELINE_MS 300000
+
+// Most the frame clock moves toward the synced time per frame, in ms, and how far off in ms it
+// may be before it jumps instead.
+#define TIME_SYNC_SLEW_MS 1
+#define TIME_SYNC_STEP_MS 250
+
+// Maximum number of zones. Sizes static storage.
+#define MAX_ZONES 8
+
+// Buckets pixels are sorted into along the installation, for effects that visit them in order.
+#define SPATIAL_BUCKETS 16
+
+// Maximum number of bottles. Sizes static storage.
+#define MAX_BOTTLES 16
+
+// Maximum pixels on a single strand.
+#define MAX_STRAND_LENGTH 1000
+
 // Pixel type flags, add together as needed:
 //   NEO_KHZ800  800 KHz bitstream (most NeoPixel products w/WS2812 LEDs)
 //   NEO_KHZ400  400 KHz (classic 'v1' (not v2) FLORA pixels, WS2811 drivers)
@@ -32,12 +214,32 @@ using namespace std;
 //   NEO_RGBW    Pixels are wired for RGBW bitstream (NeoPixel RGBW products)
 #define NEOPIXEL_FORMAT NEO_GRB + NEO_KHZ800
 
+// Uncomment if the AirLift FeatherWing isn't fitted, freeing pins 13, 12, and 11 for pixels. The
+// bottles then run without network.
+// #define NO_AIRLIFT
+
+// Pin of each NeoPXL8 lane, -1 if unused. Bottles are added by lane.
 // @see docs/neopxl8-m4.md
-// 13, 12, 11 are unavailable
-#define NEOPIXEL_PINS PIN_SERIAL1_RX, PIN_SERIAL1_TX, 9, 6, 10
+#ifdef NO_AIRLIFT
+#define NEOPIXEL_PINS PIN_SERIAL1_RX, PIN_SERIAL1_TX, 9, 6, 10, 13, 12, 11
+#else
+// 13, 12, 11 are used by the AirLift.
+#define NEOPIXEL_PINS PIN_SERIAL1_RX, PIN_SERIAL1_TX, 9, 6, 10, -1, -1, -1
+#endif
+
+// Lanes NeoPXL8 drives.
+#define NEOPIXEL_LANES 8
 
-// Number of pins wired.
+// Number of lanes in the framebuffer: the first this many of NEOPIXEL_PINS.
+#ifdef NO_AIRLIFT
+#define NEOPIXEL_NUM_PINS 8
+#else
 #define NEOPIXEL_NUM_PINS 5
+#endif
+
+// RAM in bytes the pixel layout may use, for the framebuffer and NeoPXL8's buffers. Checked at
+// compile time against src/layout.h.
+#define PIXEL_RAM_BUDGET 98304
 
 // Note: These pin definitions leave the the ESP32's `GPIO0` pin undefined (-1). If you wish to use
 // this pin - solder the pad on the bottom of the FeatherWing and set `#define ESP32_GPIO0` to the
@@ -49,7 +251,15 @@ using namespace std;
 #define SPIWIFI_ACK   11   // a.k.a BUSY or READY pin
 #define ESP32_GPIO0   -1
 
+// Expand a macro to a string literal.
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x) STRINGIFY_(x)
+
+#if BOARD_ID == 0
 #define MQTT_CLIENT_ID "cryptidBottles"
+#else
+#define MQTT_CLIENT_ID "cryptidBottles" STRINGIFY(BOARD_ID)
+#endif
 #define MQTT_USER "cryptid"
 #define MQTT_PASS "public"
 
@@ -65,6 +275,20 @@ typedef enum {
   STATUS_MQTT_ACTIVE = 20,
 } status_t;
 
+/**
+ * @brief Startup stages, run in order. The first frame is shown before anything slow starts.
+ */
+typedef enum {
+  // First frame shown.
+  STARTUP_PIXELS = 0,
+  // Power sensor started.
+  STARTUP_SENSORS = 1,
+  // WiFi module checked and MQTT set up.
+  STARTUP_NETWORK = 2,
+  // Number of stages; startup finished.
+  STARTUP_DONE = 3,
+} startup_stage_t;
+
 /**
  * @brief Loading callback.
  */
@@ -88,6 +312,16 @@ typedef enum {
   BOTTLE_ANIMATION_GLOW_W = 6,
   // Static color.
   BOTTLE_ANIMATION_ILLUM = 5,
+  // Pixels from a show controller.
+  BOTTLE_ANIMATION_NETWORK = 7,
+  // Drifting noise within each bottle's hue range.
+  BOTTLE_ANIMATION_NOISE = 8,
+  // Drifting noise in each bottle's white balance.
+  BOTTLE_ANIMATION_NOISE_W = 9,
+  // Band of the static color sweeping across every bottle.
+  BOTTLE_ANIMATION_SWEEP = 13,
+  // Blank, for zones that are off. Not selectable.
+  BOTTLE_ANIMATION_OFF = 14,
   // Test animation.
   BOTTLE_ANIMATION_TEST = 10,
   // Loop through white balance colors.
@@ -96,31 +330,40 @@ typedef enum {
   BOTTLE_ANIMATION_WARNING = 11,
 } bottle_animation_t;
 
+// One more than the highest bottle animation id, for arrays indexed by animation.
+#define BOTTLE_ANIMATION_MAX 16
+
 /**
- * @brief Map of strings for MQTT commands to bottle animations.
+ * @brief An MQTT option value and the setting it selects.
  */
-const static std::map<String, bottle_animation_t> BOTTLE_ANIMATIONS = {
+template<typename T>
+struct option_t {
+  const char* name;
+  T value;
+};
+
+/**
+ * @brief MQTT strings for bottle animations.
+ */
+constexpr option_t<bottle_animation_t> BOTTLE_ANIMATIONS[] = {
   { "Default",    BOTTLE_ANIMATION_DEFAULT },
   { "Faeries",    BOTTLE_ANIMATION_FAERIES },
   { "Rain",       BOTTLE_ANIMATION_RAIN    },
   { "Rainbow",    BOTTLE_ANIMATION_RAINBOW },
   { "Glow",       BOTTLE_ANIMATION_GLOW    },
   { "Glow White", BOTTLE_ANIMATION_GLOW_W  },
+  { "Noise",      BOTTLE_ANIMATION_NOISE   },
+  { "Noise White", BOTTLE_ANIMATION_NOISE_W },
+  { "Sweep",      BOTTLE_ANIMATION_SWEEP   },
   { "Illuminate", BOTTLE_ANIMATION_ILLUM   },
   { "Test",       BOTTLE_ANIMATION_TEST    },
   { "Test White", BOTTLE_ANIMATION_TEST_WB },
   { "Warning",    BOTTLE_ANIMATION_WARNING },
+#ifdef NETWORK_PIXELS
+  { "Network",    BOTTLE_ANIMATION_NETWORK },
+#endif
 };
 
-/**
- * @brief Map of bottle animations to MQTT string values.
- */
-const static std::map<bottle_animation_t, String> BOTTLE_ANIMATIONS_INV = []() -> std::map<bottle_animation_t, String> {
-  std::map<bottle_animation_t, String> inv;
-  for (auto const& x : BOTTLE_ANIMATIONS) inv[x.second] = x.first;
-  return inv;
-}();
-
 /**
  * @brief Faerie animation timeout in ms.
  */
@@ -133,20 +376,27 @@ typedef enum {
 /**
  * @brief Faerie animation timeout MQTT values.
  */
-const static std::map<String, faerie_speed_t> FAERIE_SPEED = {
+constexpr option_t<faerie_speed_t> FAERIE_SPEED[] = {
   { "Slow",   FAERIE_SPEED_SLOW   },
   { "Medium", FAERIE_SPEED_MEDIUM },
   { "Fast",   FAERIE_SPEED_FAST   },
 };
 
 /**
- * @brief Faerie animation timeout MQTT values (INV).
+ * @brief Steps of a faerie's flight.
  */
-const static std::map<faerie_speed_t, String> FAERIE_SPEED_INV = {
-  { FAERIE_SPEED_SLOW,   "Slow"   },
-  { FAERIE_SPEED_MEDIUM, "Medium" },
-  { FAERIE_SPEED_FAST,   "Fast"   },
-};
+typedef enum {
+  // Fade in, flying from the bottom to the middle.
+  FAERIE_FLY_IN,
+  // Hover in the middle while the trail fades.
+  FAERIE_PAUSE_MID,
+  // Fly on to the top.
+  FAERIE_FLY_UP,
+  // Hover at the top while the trail fades.
+  FAERIE_PAUSE_TOP,
+  // Fade out, flying back to the bottom.
+  FAERIE_FLY_BACK,
+} faerie_action_t;
 
 /**
  * @brief Glow animation timeout in ms.
@@ -160,61 +410,30 @@ typedef enum {
 /**
  * @brief Glow animation timeout MQTT values.
  */
-const static std::map<String, glow_speed_t> GLOW_SPEED = {
+constexpr option_t<glow_speed_t> GLOW_SPEED[] = {
   { "Slow",   GLOW_SPEED_SLOW   },
   { "Medium", GLOW_SPEED_MEDIUM },
   { "Fast",   GLOW_SPEED_FAST   },
 };
 
-/**
- * @brief Glow animation timeout MQTT values (INV).
- */
-const static std::map<glow_speed_t, String> GLOW_SPEED_INV = {
-  { GLOW_SPEED_SLOW,   "Slow"   },
-  { GLOW_SPEED_MEDIUM, "Medium" },
-  { GLOW_SPEED_FAST,   "Fast"   },
-};
+// Minimum mired value for white balance, the coolest (about 9000K).
+#define MIN_WB_MIRED 111
+
+// Maximum mired value for white balance, the warmest (about 2700K).
+#define MAX_WB_MIRED 370
 
-// Minimum mired value for white balance.
-#define MIN_WB_MIRED 30
+// White balance Illuminate starts at, about 6600K, where the blackbody fit is pure white.
+#define DEFAULT_WB_MIRED 152
 
-// Maximum mired value for white balance.
-#define MAX_WB_MIRED 90
+// Number of white balances Test White steps through.
+#define TEST_WB_STEPS 13
 
 /**
  * @brief Color temperature in mireds.
  *
  * @see https://en.wikipedia.org/wiki/Mired
  */
-typedef uint8_t white_balance_t;
-
-/**
- * @brief Color temperatures for various whites.
- */
-const std::map<white_balance_t, rgb_t> WHITE_TEMPERATURES = {
-  { 30, rgb_t{ 255, 164,  87 } },
-  { 35, rgb_t{ 255, 177, 111 } },
-  { 40, rgb_t{ 255, 190, 135 } },
-  { 45, rgb_t{ 255, 203, 159 } },
-  { 50, rgb_t{ 255, 216, 183 } },
-  { 55, rgb_t{ 255, 227, 207 } },
-  { 60, rgb_t{ 255, 241, 231 } },
-  { 65, rgb_t{ 255, 255, 255 } },
-  { 70, rgb_t{ 246, 255, 255 } },
-  { 75, rgb_t{ 232, 252, 255 } },
-  { 80, rgb_t{ 218, 248, 255 } },
-  { 85, rgb_t{ 204, 244, 255 } },
-  { 90, rgb_t{ 190, 240, 255 } }
-};
-
-/**
- * @brief Vector of pointers to white colors.
- */
-const std::vector<const rgb_t*> WHITE_TEMPERATURES_VECTOR = []() -> std::vector<const rgb_t*> {
-  std::vector<const rgb_t*> t;
-  for (auto const& x : WHITE_TEMPERATURES) t.push_back(&x.second);
-  return t;
-}();
+typedef uint16_t white_balance_t;
 
 /**
  * @brief Waveshapes.
@@ -225,4 +444,41 @@ typedef enum {
   SAWTOOTH = 1,
 } waveshape_t;
 
+/**
+ * @brief MQTT topics of each zone.
+ */
+typedef enum {
+  ZONE_TOPIC_STATE = 0,
+  ZONE_TOPIC_ON = 1,
+  ZONE_TOPIC_EFFECT = 2,
+  ZONE_TOPIC_RGB = 3,
+  ZONE_TOPIC_DISCOVERY = 4,
+  // Number of topics.
+  ZONE_TOPICS = 5,
+} zone_topic_t;
+
+/**
+ * @brief How an overlay layer combines with the layers under it.
+ */
+typedef enum {
+  // Over, by the layer's alpha.
+  BLEND_NORMAL = 0,
+  // Added, saturating; for light.
+  BLEND_ADD = 1,
+  // Multiplied; for tinting and shade.
+  BLEND_MULTIPLY = 2,
+} blend_mode_t;
+
+/**
+ * @brief Overlay layers, composed over the effect in this order.
+ */
+typedef enum {
+  // Faeries and other particles.
+  OVERLAY_PARTICLES = 0,
+  // Warnings over everything.
+  OVERLAY_ALERTS = 1,
+  // Number of overlays.
+  OVERLAY_MAX = 2,
+} overlay_t;
+
 #endif
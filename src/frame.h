@@ -0,0 +1,84 @@
+#ifndef CRYPTID_FRAME_H
+#define CRYPTID_FRAME_H
+
+#include <Arduino.h>
+#include "random.h"
+#include "tween.h"
+
+/**
+ * @brief Everything that varies from frame to frame, captured once at the start of each frame so
+ *        every pixel of a frame sees the same time.
+ */
+class FrameContext {
+  public:
+    /**
+     * @brief Construct a new FrameContext.
+     *
+     * @param random Random stream for the frame.
+     * @param tweens Values fading across frames.
+     */
+    FrameContext(Random* random, TweenPool* tweens) : random(random), tweens(tweens) {}
+
+    /**
+     * @brief Frame time in ms.
+     */
+    uint32_t time = 0;
+
+    /**
+     * @brief Time since the previous frame in ms.
+     */
+    uint32_t delta = 0;
+
+    /**
+     * @brief Frames since startup. The first frame is 1.
+     */
+    uint32_t index = 0;
+
+    /**
+     * @brief Random stream for the frame.
+     */
+    Random* random;
+
+    /**
+     * @brief Values fading across frames. Advanced at the start of each frame.
+     */
+    TweenPool* tweens;
+
+    /**
+     * @brief Frames a render is spread over. Each frame renders every nth bottle, in rotation.
+     */
+    uint8_t interlace = 1;
+
+    /**
+     * @brief Whether a bottle is rendered this frame.
+     *
+     * @param bottle index
+     * @return bool
+     */
+    bool renders(size_t bottle) const {
+      return bottle % interlace == index % interlace;
+    }
+
+    /**
+     * @brief Start at a given time without counting a frame.
+     *
+     * @param now ms
+     */
+    void reset(uint32_t now) {
+      time = now;
+      delta = 0;
+    }
+
+    /**
+     * @brief Move to the next frame.
+     *
+     * @param now ms
+     */
+    void advance(uint32_t now) {
+      delta = now - time;
+      time = now;
+      index++;
+    }
+};
+
+#endif
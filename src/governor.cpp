@@ -0,0 +1,99 @@
+#include "governor.h"
+#include "log.h"
+
+Governor::Governor(void) {
+  for (uint8_t i = 0; i < BOTTLE_ANIMATION_MAX; i++) {
+    target[i] = preferredFps((bottle_animation_t)i);
+    interlaceFactor[i] = 1;
+  }
+}
+
+void Governor::begin(uint16_t longestStrand) {
+  uint32_t transmit = (uint32_t)longestStrand * PIXEL_TRANSMIT_US + PIXEL_LATCH_US;
+  ceiling = min(1000000UL / transmit, (uint32_t)MAX_FPS);
+  LOG(FPS_CEILING, ceiling);
+  for (uint8_t i = 0; i < BOTTLE_ANIMATION_MAX; i++) {
+    updateTarget((bottle_animation_t)i);
+  }
+}
+
+uint16_t Governor::preferredFps(bottle_animation_t animation) {
+  switch (animation) {
+    case BOTTLE_ANIMATION_ILLUM:
+      return MIN_FPS;
+    case BOTTLE_ANIMATION_TEST:
+    case BOTTLE_ANIMATION_TEST_WB:
+      return 30;
+    case BOTTLE_ANIMATION_GLOW:
+    case BOTTLE_ANIMATION_GLOW_W:
+    case BOTTLE_ANIMATION_WARNING:
+      return 60;
+    case BOTTLE_ANIMATION_DEFAULT:
+    case BOTTLE_ANIMATION_FAERIES:
+    case BOTTLE_ANIMATION_RAIN:
+    case BOTTLE_ANIMATION_RAINBOW:
+    case BOTTLE_ANIMATION_NETWORK:
+    default:
+      return MAX_FPS;
+  }
+}
+
+bool Governor::interlaceable(bottle_animation_t animation) {
+  // Network pixels arrive as a whole frame, and a sweep crosses bottles.
+  return animation != BOTTLE_ANIMATION_NETWORK && animation != BOTTLE_ANIMATION_SWEEP;
+}
+
+uint32_t Governor::frameInterval(bottle_animation_t animation) {
+  return 1000000UL / target[animation];
+}
+
+void Governor::frameStart(uint32_t elapsed, uint32_t interval) {
+  // A frame that starts a whole interval late has lost at least one.
+  if (elapsed >= interval * 2) {
+    dropped += elapsed / interval - 1;
+  }
+}
+
+void Governor::record(bottle_animation_t animation, uint32_t renderMicros, uint32_t frameMicros) {
+  // Exponential moving averages, weighted 1/8 to the newest frame.
+  renderCost[animation] += renderMicros - (renderCost[animation] >> 3);
+  overheadCost += (frameMicros - renderMicros) - (overheadCost >> 3);
+  lastAnimation = animation;
+  updateTarget(animation);
+}
+
+void Governor::updateTarget(bottle_animation_t animation) {
+  uint32_t fps = min((uint32_t)preferredFps(animation), (uint32_t)ceiling);
+  uint8_t n = interlaceFactor[animation];
+  // Cost of rendering every bottle, in microseconds * 8.
+  uint32_t full = renderCost[animation] * n;
+  if (interlaceable(animation) && full > 0) {
+    // Spread the render over enough frames that each share fits the free part of a frame at the
+    // preferred rate, so output keeps that rate. Only spread it less once the bigger share fits
+    // with room to spare, so the factor doesn't flip back and forth.
+    uint32_t room = 750000UL / fps * 8;
+    room = room > overheadCost ? room - overheadCost : 0;
+    uint32_t want = room ? min((full + room - 1) / room, (uint32_t)INTERLACE_MAX) : INTERLACE_MAX;
+    if (want < n && full / want > room - room / 8) {
+      want = n;
+    }
+    if (want != n) {
+      renderCost[animation] = full / want;
+      interlaceFactor[animation] = want;
+      if (animation == lastAnimation) {
+        LOG(INTERLACE, want);
+      }
+    }
+  }
+  uint32_t cost = (renderCost[animation] + overheadCost) >> 3;
+  if (cost > 0) {
+    // Leave a quarter of each frame free.
+    fps = min(fps, 750000UL / cost);
+  }
+  // Round down to a multiple of 5 so noise in measurements doesn't change the rate every frame.
+  fps = max(fps - fps % 5, (uint32_t)MIN_FPS);
+  if (fps != target[animation] && animation == lastAnimation) {
+    LOG(FPS_TARGET, fps);
+  }
+  target[animation] = fps;
+}
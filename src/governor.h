@@ -0,0 +1,156 @@
+#ifndef CRYPTID_GOVERNOR_H
+#define CRYPTID_GOVERNOR_H
+
+#include "def.h"
+
+/**
+ * @brief Picks a frame rate per animation from what the strands can physically display and what
+ *        each animation measurably costs to render, and counts frames that miss their deadline.
+ */
+class Governor {
+  public:
+    /**
+     * @brief Constructor.
+     */
+    Governor(void);
+
+    /**
+     * @brief Calculate the physical frame rate ceiling. Call after the pixel driver starts.
+     *
+     * @param longestStrand Length of longest strand of pixels.
+     */
+    void begin(uint16_t longestStrand);
+
+    /**
+     * @brief Time between frames for an animation.
+     *
+     * @param animation
+     * @return microseconds
+     */
+    uint32_t frameInterval(bottle_animation_t animation);
+
+    /**
+     * @brief Mark the start of a frame, counting any frames missed since the last one.
+     *
+     * @param elapsed microseconds since the previous frame started
+     * @param interval microseconds the frame was scheduled for
+     */
+    void frameStart(uint32_t elapsed, uint32_t interval);
+
+    /**
+     * @brief Record the cost of a frame.
+     *
+     * @param animation
+     * @param renderMicros time spent rendering the animation
+     * @param frameMicros time spent on the whole frame, including rendering
+     */
+    void record(bottle_animation_t animation, uint32_t renderMicros, uint32_t frameMicros);
+
+    /**
+     * @brief Physical frame rate ceiling for the longest strand.
+     *
+     * @return fps
+     */
+    uint16_t ceilingFps(void) {
+      return ceiling;
+    }
+
+    /**
+     * @brief Frame rate chosen for the most recent animation.
+     *
+     * @return fps
+     */
+    uint16_t targetFps(void) {
+      return target[lastAnimation];
+    }
+
+    /**
+     * @brief Frames that missed their deadline since startup.
+     *
+     * @return count
+     */
+    uint32_t droppedFrames(void) {
+      return dropped;
+    }
+
+    /**
+     * @brief Frames an animation's render is spread over.
+     *
+     * @param animation
+     * @return 1 to INTERLACE_MAX
+     */
+    uint8_t interlace(bottle_animation_t animation) {
+      return interlaceFactor[animation];
+    }
+
+    /**
+     * @brief Frames the most recent animation's render is spread over.
+     *
+     * @return 1 to INTERLACE_MAX
+     */
+    uint8_t currentInterlace(void) {
+      return interlaceFactor[lastAnimation];
+    }
+
+  private:
+    /**
+     * @brief Frame rate ceiling from strand transmission time.
+     */
+    uint16_t ceiling = MAX_FPS;
+
+    /**
+     * @brief Average render time per animation, in microseconds * 8. Interlaced renders are
+     *        measured as rendered, a share of the bottles.
+     */
+    uint32_t renderCost[BOTTLE_ANIMATION_MAX] = {};
+
+    /**
+     * @brief Average time spent on everything but rendering, in microseconds * 8.
+     */
+    uint32_t overheadCost = 0;
+
+    /**
+     * @brief Chosen frame rate per animation.
+     */
+    uint16_t target[BOTTLE_ANIMATION_MAX] = {};
+
+    /**
+     * @brief Frames each animation's render is spread over.
+     */
+    uint8_t interlaceFactor[BOTTLE_ANIMATION_MAX] = {};
+
+    /**
+     * @brief Animation most recently recorded.
+     */
+    bottle_animation_t lastAnimation = BOTTLE_ANIMATION_DEFAULT;
+
+    /**
+     * @brief Frames that missed their deadline.
+     */
+    uint32_t dropped = 0;
+
+    /**
+     * @brief Frame rate an animation needs to look smooth.
+     *
+     * @param animation
+     * @return fps
+     */
+    static uint16_t preferredFps(bottle_animation_t animation);
+
+    /**
+     * @brief Whether an animation renders bottle by bottle, so can be interlaced.
+     *
+     * @param animation
+     * @return bool
+     */
+    static bool interlaceable(bottle_animation_t animation);
+
+    /**
+     * @brief Recalculate the target frame rate for an animation.
+     *
+     * @param animation
+     */
+    void updateTarget(bottle_animation_t animation);
+};
+
+#endif
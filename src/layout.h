@@ -0,0 +1,229 @@
+#ifndef CRYPTID_LAYOUT_H
+#define CRYPTID_LAYOUT_H
+
+#include "def.h"
+
+/**
+ * @brief Where a bottle's pixels are.
+ */
+typedef struct {
+  // Lane (index into NEOPIXEL_PINS, not the pin on the board).
+  uint8_t pin;
+  // First pixel on the lane's strand that belongs to the bottle.
+  uint16_t start;
+  // Number of pixels.
+  uint16_t length;
+  // Where the strip's first pixel is, in mm across, into, and up from the installation's corner.
+  uint16_t x;
+  uint16_t y;
+  uint16_t z;
+  // Height in mm from the first pixel to the last; the strip runs straight up.
+  uint16_t height;
+  // Mireds added to every white balance the bottle shows, so bottles whose glass tints the light
+  // match.
+  int8_t wbOffset;
+} bottle_layout_t;
+
+/**
+ * @brief A named set of bottles with its own effect.
+ */
+typedef struct {
+  // MQTT topic and Home Assistant id.
+  const char* id;
+  // Home Assistant name.
+  const char* name;
+  // Bottles in the zone, as bits of their index in BOTTLE_LAYOUT.
+  uint32_t bottles;
+} zone_layout_t;
+
+#ifdef LAYOUT_CONFIG
+#include LAYOUT_CONFIG
+#else
+/**
+ * @brief Bottles !! Config lane, start, length, and position according to hardware !!
+ *        Positions are in the whole installation, so effects line up across boards.
+ */
+constexpr bottle_layout_t BOTTLE_LAYOUT[] = {
+  // pin  1st  len    x    y    z  height  wb
+  {   0,   0,  25,  80, 100,  20,    160,   0 },
+  {   0,  25,  25, 260, 140,  20,    160,   0 },
+  {   1,   0,  20, 440,  90,  20,    120,   0 },
+  {   1,  20,  30, 620, 120,  20,    200,   0 },
+};
+
+/**
+ * @brief Size in mm of the installation along its longest side. Positions are scaled to it, and
+ *        it should be the same on every board.
+ */
+constexpr uint32_t LAYOUT_SPAN_MM = 1000;
+
+/**
+ * @brief Zones !! Config which bottles make up each; every bottle is in exactly one !!
+ *        Zones on other boards with the same id follow the same commands, but only board 0's
+ *        are announced to Home Assistant.
+ */
+constexpr zone_layout_t ZONE_LAYOUT[] = {
+  // id       name             bottles
+  { "left",  "Left Bottles",  0b0011 },
+  { "right", "Right Bottles", 0b1100 },
+};
+#endif
+
+/**
+ * @brief Pin of each lane.
+ */
+constexpr int8_t NEOPIXEL_PIN_MAP[NEOPIXEL_LANES] = { NEOPIXEL_PINS };
+
+/**
+ * @brief Number of bottles in the layout.
+ */
+constexpr size_t LAYOUT_BOTTLES = sizeof(BOTTLE_LAYOUT) / sizeof(BOTTLE_LAYOUT[0]);
+
+/**
+ * @brief Number of zones in the layout.
+ */
+constexpr size_t LAYOUT_ZONES = sizeof(ZONE_LAYOUT) / sizeof(ZONE_LAYOUT[0]);
+
+/**
+ * @brief Larger of two values, evaluating each once (unlike Arduino's max()).
+ *
+ * @param a
+ * @param b
+ * @return larger
+ */
+constexpr uint32_t layoutMax(uint32_t a, uint32_t b) {
+  return a > b ? a : b;
+}
+
+/**
+ * @brief Length of a lane's strand: the end of its furthest bottle.
+ *
+ * @param pin lane
+ * @param i bottle to start from
+ * @return pixels
+ */
+constexpr uint32_t layoutStrand(uint8_t pin, size_t i = 0) {
+  return i == LAYOUT_BOTTLES ? 0
+    : layoutMax(BOTTLE_LAYOUT[i].pin == pin ? BOTTLE_LAYOUT[i].start + BOTTLE_LAYOUT[i].length : 0,
+                layoutStrand(pin, i + 1));
+}
+
+/**
+ * @brief Length of the longest strand.
+ *
+ * @param pin lane to start from
+ * @return pixels
+ */
+constexpr uint32_t layoutLongestStrand(uint8_t pin = 0) {
+  return pin == NEOPIXEL_NUM_PINS ? 0 : layoutMax(layoutStrand(pin), layoutLongestStrand(pin + 1));
+}
+
+/**
+ * @brief Total pixels in bottles.
+ *
+ * @param i bottle to start from
+ * @return pixels
+ */
+constexpr uint32_t layoutPixels(size_t i = 0) {
+  return i == LAYOUT_BOTTLES ? 0 : BOTTLE_LAYOUT[i].length + layoutPixels(i + 1);
+}
+
+/**
+ * @brief Whether every bottle is on a wired lane of the framebuffer.
+ *
+ * @param i bottle to start from
+ * @return bool
+ */
+constexpr bool layoutPinsValid(size_t i = 0) {
+  return i == LAYOUT_BOTTLES
+    || (BOTTLE_LAYOUT[i].pin < NEOPIXEL_NUM_PINS && NEOPIXEL_PIN_MAP[BOTTLE_LAYOUT[i].pin] >= 0
+        && layoutPinsValid(i + 1));
+}
+
+/**
+ * @brief Whether every bottle is within LAYOUT_SPAN_MM.
+ *
+ * @param i bottle to start from
+ * @return bool
+ */
+constexpr bool layoutPositionsValid(size_t i = 0) {
+  return i == LAYOUT_BOTTLES
+    || (BOTTLE_LAYOUT[i].x <= LAYOUT_SPAN_MM && BOTTLE_LAYOUT[i].y <= LAYOUT_SPAN_MM
+        && BOTTLE_LAYOUT[i].z + BOTTLE_LAYOUT[i].height <= LAYOUT_SPAN_MM
+        && layoutPositionsValid(i + 1));
+}
+
+/**
+ * @brief Bottles in any zone, as bits.
+ *
+ * @param i zone to start from
+ * @return bits
+ */
+constexpr uint32_t layoutZoneBottles(size_t i = 0) {
+  return i == LAYOUT_ZONES ? 0 : ZONE_LAYOUT[i].bottles | layoutZoneBottles(i + 1);
+}
+
+/**
+ * @brief Whether no bottle is in two zones.
+ *
+ * @param i zone to start from
+ * @param seen bottles in earlier zones
+ * @return bool
+ */
+constexpr bool layoutZonesDisjoint(size_t i = 0, uint32_t seen = 0) {
+  return i == LAYOUT_ZONES
+    || (!(ZONE_LAYOUT[i].bottles & seen) && layoutZonesDisjoint(i + 1, seen | ZONE_LAYOUT[i].bottles));
+}
+
+/**
+ * @brief Length of the longest strand. Sizes static storage.
+ */
+constexpr uint32_t LAYOUT_LONGEST_STRAND = layoutLongestStrand();
+
+/**
+ * @brief Total pixels in bottles.
+ */
+constexpr uint32_t LAYOUT_PIXELS = layoutPixels();
+
+/**
+ * @brief Bytes per pixel of framebuffer: packed RGB for the effect, and unless NO_CROSSFADE, the
+ *        one fading out, and with PALETTE_PIXELS, an index. Overlays hold spans, not pixels, so
+ *        they're a fixed size whatever the layout.
+ */
+#ifdef NO_CROSSFADE
+#define LAYOUT_FADE_BYTES 0
+#else
+#define LAYOUT_FADE_BYTES 4
+#endif
+#ifdef PALETTE_PIXELS
+#define LAYOUT_INDEX_BYTES 1
+#else
+#define LAYOUT_INDEX_BYTES 0
+#endif
+#define LAYOUT_FRAME_BYTES (4 + LAYOUT_FADE_BYTES + LAYOUT_INDEX_BYTES)
+
+/**
+ * @brief RAM used for pixels: the framebuffer, plus NeoPXL8's pixel buffer and its DMA buffer, in
+ *        which each bit of each lane's pixels takes 3 bytes.
+ */
+constexpr uint32_t LAYOUT_PIXEL_RAM = LAYOUT_LONGEST_STRAND
+  * (NEOPIXEL_NUM_PINS * LAYOUT_FRAME_BYTES + NEOPIXEL_LANES * 3 + NEOPIXEL_LANES * 3 * 3);
+
+/**
+ * @brief Time to send the longest strand and latch, in microseconds.
+ */
+constexpr uint32_t LAYOUT_FRAME_US = LAYOUT_LONGEST_STRAND * PIXEL_TRANSMIT_US + PIXEL_LATCH_US;
+
+static_assert(NEOPIXEL_NUM_PINS <= NEOPIXEL_LANES, "NEOPIXEL_NUM_PINS is more than NeoPXL8 lanes");
+static_assert(LAYOUT_BOTTLES <= MAX_BOTTLES, "More bottles in BOTTLE_LAYOUT than MAX_BOTTLES");
+static_assert(layoutPinsValid(), "A bottle in BOTTLE_LAYOUT is on a lane without a pin");
+static_assert(layoutPositionsValid(), "A bottle in BOTTLE_LAYOUT is outside LAYOUT_SPAN_MM");
+static_assert(LAYOUT_BOTTLES < 32, "Zones hold bottles as bits, so BOTTLE_LAYOUT can have at most 31");
+static_assert(LAYOUT_ZONES > 0 && LAYOUT_ZONES <= MAX_ZONES, "ZONE_LAYOUT needs 1 to MAX_ZONES zones");
+static_assert(layoutZoneBottles() == (1UL << LAYOUT_BOTTLES) - 1, "A bottle in BOTTLE_LAYOUT has no zone, or a zone has a bottle that isn't there");
+static_assert(layoutZonesDisjoint(), "A bottle is in more than one zone in ZONE_LAYOUT");
+static_assert(LAYOUT_LONGEST_STRAND <= MAX_STRAND_LENGTH, "A strand is longer than MAX_STRAND_LENGTH");
+static_assert(LAYOUT_PIXEL_RAM <= PIXEL_RAM_BUDGET, "Pixels need more RAM than PIXEL_RAM_BUDGET");
+static_assert(LAYOUT_FRAME_US <= 1000000UL / MIN_FPS, "Longest strand takes too long to send for MIN_FPS");
+
+#endif
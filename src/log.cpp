@@ -0,0 +1,102 @@
+#include <atomic>
+#include "log.h"
+
+/**
+ * @brief A queued log message.
+ */
+typedef struct {
+  uint32_t time;
+  uint32_t args[2];
+  uint8_t id;
+} log_record_t;
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of 2");
+static_assert(LOG_MAX <= 256, "Log ids must fit in a byte");
+
+/**
+ * @brief Ring of queued records. One slot is always left empty to tell full from empty.
+ */
+static log_record_t ring[LOG_RING_SIZE];
+
+/**
+ * @brief Next slot to write. Only changed by logWrite().
+ */
+static std::atomic<uint16_t> head(0);
+
+/**
+ * @brief Next slot to send. Only changed by logDrain().
+ */
+static std::atomic<uint16_t> tail(0);
+
+/**
+ * @brief Records dropped since the last report.
+ */
+static std::atomic<uint32_t> dropped(0);
+
+void logWrite(log_id_t id, uint32_t a, uint32_t b) {
+  uint16_t h = head.load(std::memory_order_relaxed);
+  uint16_t next = (h + 1) & (LOG_RING_SIZE - 1);
+  if (next == tail.load(std::memory_order_acquire)) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  ring[h].time = millis();
+  ring[h].args[0] = a;
+  ring[h].args[1] = b;
+  ring[h].id = id;
+  head.store(next, std::memory_order_release);
+}
+
+uint32_t logText(const char* s) {
+  uint32_t packed = 0;
+  for (uint8_t i = 0; i < 4 && s[i] != '\0'; i++) {
+    packed |= (uint32_t)(uint8_t)s[i] << (i * 8);
+  }
+  return packed;
+}
+
+/**
+ * @brief Write a record in wire format, little-endian.
+ *
+ * @param id
+ * @param time
+ * @param a
+ * @param b
+ */
+static void sendRecord(uint8_t id, uint32_t time, uint32_t a, uint32_t b) {
+  uint8_t buf[LOG_RECORD_BYTES] = {
+    LOG_SYNC, id,
+    (uint8_t)time, (uint8_t)(time >> 8), (uint8_t)(time >> 16), (uint8_t)(time >> 24),
+    (uint8_t)a, (uint8_t)(a >> 8), (uint8_t)(a >> 16), (uint8_t)(a >> 24),
+    (uint8_t)b, (uint8_t)(b >> 8), (uint8_t)(b >> 16), (uint8_t)(b >> 24),
+  };
+  Serial.write(buf, LOG_RECORD_BYTES);
+}
+
+bool logDrain(void) {
+  uint16_t t = tail.load(std::memory_order_relaxed);
+  bool pending = t != head.load(std::memory_order_acquire);
+  uint32_t d = dropped.load(std::memory_order_relaxed);
+  if (!pending && d == 0) return false;
+  // Only write what fits in the USB buffer, so a slow or busy host never stalls a frame.
+  if (Serial.availableForWrite() < LOG_RECORD_BYTES) return false;
+  if (d > 0) {
+    dropped.fetch_sub(d, std::memory_order_relaxed);
+    sendRecord(LOG_DROPPED, millis(), d, 0);
+    return true;
+  }
+  const log_record_t& r = ring[t];
+  sendRecord(r.id, r.time, r.args[0], r.args[1]);
+  tail.store((t + 1) & (LOG_RING_SIZE - 1), std::memory_order_release);
+  return true;
+}
+
+void logFlush(void) {
+  uint16_t t = tail.load(std::memory_order_relaxed);
+  while (t != head.load(std::memory_order_acquire)) {
+    sendRecord(ring[t].id, ring[t].time, ring[t].args[0], ring[t].args[1]);
+    t = (t + 1) & (LOG_RING_SIZE - 1);
+  }
+  tail.store(t, std::memory_order_release);
+  Serial.flush();
+}
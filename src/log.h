@@ -0,0 +1,146 @@
+#ifndef CRYPTID_LOG_H
+#define CRYPTID_LOG_H
+
+#include <Arduino.h>
+#include "def.h"
+
+// Log levels. Messages above LOG_LEVEL in def.h are compiled out.
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Log message table: X(name, level, format). A message's id is its position here, so only append
+// to keep old captures decodable. Arguments are 32-bit; %u, %d and %x print them as numbers and %s
+// prints up to four characters packed with logText(). tools/logdecode.py reads this table, so keep
+// each entry on one line.
+#define LOG_FORMATS(X) \
+  X(DROPPED, WARN, "%u log records dropped") \
+  X(STARTING, INFO, "Starting...") \
+  X(FATAL, ERROR, "FATAL ERROR %x") \
+  X(READING_VOLTAGE, INFO, "Reading voltage monitor...") \
+  X(INA219_MISSING, WARN, "Failed to find INA219 chip, power not measured") \
+  X(SETTING_UP_LEDS, INFO, "Setting up LEDs...") \
+  X(TOO_MANY_BOTTLES, ERROR, "Too many bottles, increase MAX_BOTTLES") \
+  X(BOTTLE_ADDED, INFO, "Bottle of %u pixels on pin %u added.") \
+  X(PXL8_START_FAILED, ERROR, "Error starting NeoPXL8") \
+  X(WIFI_MODULE_FAILED, ERROR, "Communication with WiFi module failed") \
+  X(WATCHDOG, INFO, "Watchdog enabled with %u ms countdown.") \
+  X(FRAME_HASH, INFO, "%u %x") \
+  X(FREE_MEMORY, INFO, "Free Memory: %u bytes") \
+  X(HEAP_USE, WARN, "Heap use after setup: %u") \
+  X(SLOW_FRAME, WARN, "Slow frame (ms): %u") \
+  X(LIGHT_ON, INFO, "Turning light on") \
+  X(LIGHT_OFF, INFO, "Turning light off") \
+  X(MQTT_SETUP, INFO, "Setting up MQTT control...") \
+  X(UNKNOWN_ON_OFF, WARN, "Unrecognized on/off command: %s") \
+  X(EFFECT_NOT_FOUND, WARN, "Effect not found: %s") \
+  X(EFFECT, INFO, "Setting effect to %u") \
+  X(GLOW_SPEED_DEFAULT, INFO, "Setting glow speed to default") \
+  X(GLOW_SPEED, INFO, "Setting glow speed to %u") \
+  X(FAERIE_SPEED_DEFAULT, INFO, "Setting faerie speed to default") \
+  X(FAERIE_SPEED, INFO, "Setting faerie speed to %u") \
+  X(BRIGHTNESS, INFO, "Setting brightness to %u") \
+  X(INVALID_COLOR, WARN, "Invalid color: %s") \
+  X(COLOR, INFO, "Setting color to %x") \
+  X(ILLUMINATION, INFO, "Setting illumination to %u@%u") \
+  X(WHITE_BALANCE, INFO, "Setting white balance to %u") \
+  X(SEED, INFO, "Setting random seed to %u") \
+  X(FPS_CEILING, INFO, "Frame rate ceiling: %u") \
+  X(FPS_TARGET, INFO, "Frame rate: %u") \
+  X(PXL8_ADD_AFTER_INIT, ERROR, "Pxl8 Error: Cannot add strands after init.") \
+  X(PXL8_PIN_RANGE, ERROR, "Pxl8 Error: Pin %u out of range.") \
+  X(PXL8_STRAND_ADDED, INFO, "Added strand of %u@%u") \
+  X(PXL8_PIXELS, DEBUG, "leds: %u/%u") \
+  X(PXL8_STRAND, INFO, "Strand: %u:%u") \
+  X(PXL8_LONGEST, INFO, "Longest strand = %u") \
+  X(PXL8_TOO_LONG, ERROR, "Pxl8 Error: Strand longer than MAX_STRAND_LENGTH.") \
+  X(PXL8_ALREADY_INIT, ERROR, "Pxl8 Error: Already initialized.") \
+  X(PXL8_STARTING, INFO, "Starting pixels...") \
+  X(PXL8_START_FAIL, ERROR, "Starting pixels...fail") \
+  X(PXL8_STARTED, INFO, "Starting pixels...success") \
+  X(STREAM, INFO, "Frame stream on: %u") \
+  X(STREAM_BACKOFF, DEBUG, "Frame stream interval %u ms, publish took %u us") \
+  X(NETWORK_LISTENING, INFO, "Listening for %u network pixels") \
+  X(STATE_RESTORED, INFO, "Restored effect %u at brightness %u") \
+  X(STATE_STORE_FAILED, WARN, "Saved state unavailable") \
+  X(STARTUP_STAGE, INFO, "Startup stage %u done at %u ms") \
+  X(FIRST_FRAME_LATE, WARN, "First frame at %u ms, target %u ms") \
+  X(TIME_SYNC_SAMPLE, DEBUG, "Time offset %d ms, round trip %u ms") \
+  X(TIME_SYNC_STEP, INFO, "Frame clock stepped %d ms") \
+  X(PXL8_OUTSIDE_LAYOUT, ERROR, "Pxl8 Error: Strand longer than BOTTLE_LAYOUT allows.") \
+  X(INTERLACE, INFO, "Rendering over %u frames") \
+  X(COMMAND_LATENCY, DEBUG, "Command shown after %u us") \
+  X(TWEEN_POOL_FULL, WARN, "Tween pool full, value set without fading") \
+  X(NOISE_TIMING, INFO, "Noise: %u ns per sample, max error %u/100 from float") \
+  X(ZONE_ON, INFO, "Zone %u on: %u") \
+  X(ZONE_EFFECT, INFO, "Setting zone %u effect to %u") \
+  X(PXL8_OVERLAY_FULL, WARN, "Pxl8: Overlay %u full, span dropped.") \
+  X(COLOR_TIMING, INFO, "Color %s: %u ns per call") \
+  X(COLOR_TIMING_BEFORE, INFO, "Color %s: %u ns per call, as before the integer primitives")
+
+/**
+ * @brief Log message ids.
+ */
+typedef enum {
+#define LOG_ID(name, level, format) LOG_##name,
+  LOG_FORMATS(LOG_ID)
+#undef LOG_ID
+  LOG_MAX,
+} log_id_t;
+
+/**
+ * @brief Level of each log message, for compiling out messages above LOG_LEVEL.
+ */
+enum {
+#define LOG_LEVEL_OF(name, level, format) LOG_LEVEL_OF_##name = LOG_LEVEL_##level,
+  LOG_FORMATS(LOG_LEVEL_OF)
+#undef LOG_LEVEL_OF
+};
+
+// Record a log message, e.g. LOG(BRIGHTNESS, 127). Takes up to two 32-bit arguments.
+#define LOG(name, ...) do { \
+    if (LOG_LEVEL_OF_##name <= LOG_LEVEL) logWrite(LOG_##name, ##__VA_ARGS__); \
+  } while (0)
+
+/**
+ * @brief Size of a record on the wire: sync byte, id, time, and two arguments.
+ */
+#define LOG_RECORD_BYTES 14
+
+/**
+ * @brief First byte of every record on the wire.
+ */
+#define LOG_SYNC 0xA5
+
+/**
+ * @brief Queue a log record. Never blocks; if the ring is full the record is counted and dropped.
+ *
+ * @param id
+ * @param a first argument
+ * @param b second argument
+ */
+void logWrite(log_id_t id, uint32_t a = 0, uint32_t b = 0);
+
+/**
+ * @brief Pack up to the first four characters of a string into a log argument.
+ *
+ * @param s
+ * @return packed characters
+ */
+uint32_t logText(const char* s);
+
+/**
+ * @brief Send one queued record if the serial port can take it without blocking. Call in frame
+ *        slack.
+ *
+ * @return whether a record was sent
+ */
+bool logDrain(void);
+
+/**
+ * @brief Send every queued record, blocking. For fatal errors only.
+ */
+void logFlush(void);
+
+#endif
@@ -0,0 +1,38 @@
+#include "memory.h"
+
+/**
+ * @brief Whether setup has finished and the heap is off limits.
+ */
+static volatile bool heap_locked = false;
+
+/**
+ * @brief Heap operations since the heap was locked.
+ */
+static volatile uint32_t heap_violations = 0;
+
+void heapLock(void) {
+  heap_locked = true;
+}
+
+uint32_t heapViolations(void) {
+  return heap_violations;
+}
+
+#ifdef STATIC_ALLOC
+
+// newlib calls these around every malloc, free, and realloc, which makes them a
+// single choke point for all heap use, including `new`, `String`, and STL containers.
+// Defining both replaces newlib's (empty, single-threaded) versions.
+
+extern "C" void __malloc_lock(struct _reent* /*r*/) {
+  if (heap_locked) {
+#ifdef STATIC_ALLOC_TRAP
+    __builtin_trap();
+#endif
+    heap_violations = heap_violations + 1;
+  }
+}
+
+extern "C" void __malloc_unlock(struct _reent* /*r*/) {}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef CRYPTID_MEMORY_H
+#define CRYPTID_MEMORY_H
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "def.h"
+
+/**
+ * @brief Fixed storage for up to N objects, constructed in place. Objects are never destroyed.
+ *
+ * @tparam T object type
+ * @tparam N capacity
+ */
+template<typename T, size_t N = 1>
+class StaticPool {
+  public:
+    /**
+     * @brief Construct the next object in the pool.
+     *
+     * @param args constructor arguments
+     * @return pointer to object, or nullptr if the pool is full
+     */
+    template<typename... Args>
+    T* create(Args&&... args) {
+      if (used >= N) return nullptr;
+      return new (&storage[used++]) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Number of objects created.
+     */
+    size_t size(void) const {
+      return used;
+    }
+
+  private:
+    /**
+     * @brief Raw, aligned storage for each object.
+     */
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[N];
+
+    /**
+     * @brief Number of slots used.
+     */
+    size_t used = 0;
+};
+
+/**
+ * @brief Mark the end of setup. With STATIC_ALLOC, any heap use after this is a violation.
+ */
+void heapLock(void);
+
+/**
+ * @brief Number of heap operations (malloc, free, realloc) since heapLock() was called.
+ *        Always zero unless built with STATIC_ALLOC.
+ *
+ * @return count
+ */
+uint32_t heapViolations(void);
+
+#endif
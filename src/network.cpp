@@ -0,0 +1,167 @@
+#include "network.h"
+
+#ifdef NETWORK_PIXELS
+
+#include "log.h"
+
+/**
+ * @brief Received frames. Slots rotate between receiving and waiting to be shown.
+ */
+static uint8_t slots[NETWORK_JITTER_FRAMES + 1][NETWORK_FRAME_BYTES];
+
+/**
+ * @brief Packet being parsed.
+ */
+static uint8_t packet[NETWORK_PACKET_BYTES];
+
+/**
+ * @brief Bytes of pixel data in one E1.31 universe.
+ */
+static const uint16_t E131_UNIVERSE_BYTES = 510;
+
+static inline uint16_t be16(const uint8_t* p) {
+  return (uint16_t)p[0] << 8 | p[1];
+}
+
+static inline uint32_t be32(const uint8_t* p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+NetworkPixels::NetworkPixels(Pxl8* pxl8, std::vector<Bottle*>* bottles)
+  : pxl8(pxl8), bottles(bottles) {}
+
+bool NetworkPixels::begin(void) {
+  if (WiFi.status() != WL_CONNECTED) return false;
+  uint32_t pixels = 0;
+  for (auto & bottle : *bottles) {
+    pixels += bottle->getLength();
+  }
+  frameBytes = min(pixels * 3, (uint32_t)NETWORK_FRAME_BYTES);
+  lastUniverse = min((frameBytes - 1) / E131_UNIVERSE_BYTES, (uint32_t)NETWORK_E131_UNIVERSES - 1);
+  ddp.begin(NETWORK_DDP_PORT);
+  e131.begin(NETWORK_E131_PORT);
+  readSlot = writeSlot = queued = 0;
+  ddpSequence = 0;
+  memset(e131Sequence, 0, sizeof(e131Sequence));
+  memset(slots[writeSlot], 0, frameBytes);
+  listening = true;
+  LOG(NETWORK_LISTENING, frameBytes / 3);
+  return true;
+}
+
+void NetworkPixels::end(void) {
+  if (!listening) return;
+  ddp.stop();
+  e131.stop();
+  listening = false;
+}
+
+void NetworkPixels::render(const FrameContext& ctx) {
+  if (!listening && !begin()) return;
+
+  int len;
+  for (uint8_t i = 0; i < NETWORK_PACKETS_PER_FRAME && (len = ddp.parsePacket()) > 0; i++) {
+    parseDdp(packet, ddp.read(packet, min(len, (int)sizeof(packet))), ctx.time);
+  }
+  for (uint8_t i = 0; i < NETWORK_PACKETS_PER_FRAME && (len = e131.parsePacket()) > 0; i++) {
+    parseE131(packet, e131.read(packet, min(len, (int)sizeof(packet))), ctx.time);
+  }
+
+  // Show the newest frame that has been held long enough, skipping any older ones.
+  int16_t due = -1;
+  while (queued > 0 && ctx.time - arrived[readSlot] >= NETWORK_JITTER_MS) {
+    if (due >= 0) framesDropped++;
+    due = readSlot;
+    readSlot = (readSlot + 1) % (NETWORK_JITTER_FRAMES + 1);
+    queued--;
+  }
+  if (due < 0) return;
+  present(due);
+  uint32_t l = ctx.time - arrived[due];
+  latencyAverage = latencyAverage ? latencyAverage + l - (latencyAverage >> 3) : l << 3;
+  latency = latencyAverage >> 3;
+}
+
+void NetworkPixels::parseDdp(const uint8_t* buf, int len, uint32_t now) {
+  if (len < 10) return;
+  uint8_t flags = buf[0];
+  // Version 1 only; ignore queries and replies.
+  if ((flags & 0xC0) != 0x40 || (flags & 0x06)) return;
+  // Status and config ids are not pixel data.
+  if (buf[3] >= 246 && buf[3] != 255) return;
+
+  uint8_t sequence = buf[1] & 0x0F;
+  if (sequence != 0) {
+    if (ddpSequence != 0) {
+      packetsLost += (sequence - ddpSequence + 14) % 15;
+    }
+    ddpSequence = sequence;
+  }
+
+  uint8_t header = (flags & 0x10) ? 14 : 10;
+  if (len < header) return;
+  uint32_t dataLen = min((uint32_t)be16(buf + 8), (uint32_t)(len - header));
+  store(be32(buf + 4), buf + header, dataLen);
+  if (flags & 0x01) {
+    push(now);
+  }
+}
+
+void NetworkPixels::parseE131(const uint8_t* buf, int len, uint32_t now) {
+  if (len < 126 || memcmp(buf + 4, "ASC-E1.17\0\0\0", 12) != 0) return;
+  // Preview data isn't for display; start code 0 is pixel data.
+  if ((buf[112] & 0x80) || buf[125] != 0) return;
+  uint16_t universe = be16(buf + 113);
+  if (universe < NETWORK_E131_UNIVERSE || universe >= NETWORK_E131_UNIVERSE + NETWORK_E131_UNIVERSES) return;
+  uint16_t u = universe - NETWORK_E131_UNIVERSE;
+
+  uint8_t sequence = buf[111];
+  if (e131Sequence[u] != 0) {
+    int8_t gap = sequence - (uint8_t)e131Sequence[u];
+    // Per the spec, a packet a little behind is out of order and discarded.
+    if (gap < 0 && gap > -20) return;
+    if (gap > 0) packetsLost += gap;
+  }
+  e131Sequence[u] = sequence + 1;
+
+  uint32_t count = min((uint32_t)be16(buf + 123) - 1, (uint32_t)(len - 126));
+  store(u * E131_UNIVERSE_BYTES, buf + 126, min(count, (uint32_t)E131_UNIVERSE_BYTES));
+  // The universe with the last pixel completes the frame.
+  if (u == lastUniverse) {
+    push(now);
+  }
+}
+
+void NetworkPixels::store(uint32_t offset, const uint8_t* data, uint32_t len) {
+  if (offset >= frameBytes) return;
+  memcpy(&slots[writeSlot][offset], data, min(len, frameBytes - offset));
+}
+
+void NetworkPixels::push(uint32_t now) {
+  if (queued == NETWORK_JITTER_FRAMES) {
+    // Full; drop the oldest.
+    readSlot = (readSlot + 1) % (NETWORK_JITTER_FRAMES + 1);
+    queued--;
+    framesDropped++;
+  }
+  arrived[writeSlot] = now;
+  queued++;
+  uint8_t next = (readSlot + queued) % (NETWORK_JITTER_FRAMES + 1);
+  // Packets may only update part of a frame, so start the next from this one.
+  memcpy(slots[next], slots[writeSlot], frameBytes);
+  writeSlot = next;
+}
+
+void NetworkPixels::present(uint8_t slot) {
+  const uint8_t* p = slots[slot];
+  const uint8_t* end = p + frameBytes;
+  for (auto & bottle : *bottles) {
+    uint8_t pin = bottle->getPin();
+    uint16_t first = bottle->getStartPixel();
+    for (uint16_t n = 0; n < bottle->getLength() && p < end; n++, p += 3) {
+      pxl8->setPixelColor(pin, first + n, (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef CRYPTID_NETWORK_H
+#define CRYPTID_NETWORK_H
+
+#include <vector>
+#include <WiFiNINA.h>
+#include "def.h"
+#include "layout.h"
+#include "pxl8.h"
+#include "bottle.h"
+#include "frame.h"
+
+// Pixels arrive as one RGB array in bottle order: every pixel of the first bottle added, then the
+// second, and so on. DDP packets address the array by byte offset; E1.31 packets carry 170 pixels
+// per universe, starting at NETWORK_E131_UNIVERSE.
+
+/**
+ * @brief Bytes in one frame of network pixels.
+ */
+#define NETWORK_FRAME_BYTES (LAYOUT_PIXELS * 3)
+
+/**
+ * @brief Receives pixels from a show controller over DDP or E1.31 and presents them at frame
+ *        deadlines through a small jitter buffer.
+ */
+class NetworkPixels {
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param pxl8 Pointer to Pxl8 object.
+     * @param bottles Pointer to Bottle objects array.
+     */
+    NetworkPixels(Pxl8* pxl8, std::vector<Bottle*>* bottles);
+
+    /**
+     * @brief Receive packets and show the frame that's due. Starts listening if needed.
+     *
+     * @param ctx Current frame.
+     */
+    void render(const FrameContext& ctx);
+
+    /**
+     * @brief Stop listening. Call when another animation is selected.
+     */
+    void end(void);
+
+    /**
+     * @brief Packets missed, from gaps in sequence numbers.
+     */
+    uint32_t packetsLost = 0;
+
+    /**
+     * @brief Complete frames dropped because the jitter buffer was full or they arrived too late.
+     */
+    uint32_t framesDropped = 0;
+
+    /**
+     * @brief Average time from a frame arriving to being shown, in ms.
+     */
+    uint16_t latency = 0;
+
+  private:
+    /**
+     * @brief Pointer to Pxl8 object.
+     */
+    Pxl8* pxl8;
+
+    /**
+     * @brief Pointer to Bottle objects array.
+     */
+    std::vector<Bottle*>* bottles;
+
+    /**
+     * @brief DDP socket.
+     */
+    WiFiUDP ddp;
+
+    /**
+     * @brief E1.31 socket.
+     */
+    WiFiUDP e131;
+
+    /**
+     * @brief Whether the sockets are open.
+     */
+    bool listening = false;
+
+    /**
+     * @brief Open the sockets.
+     *
+     * @return success
+     */
+    bool begin(void);
+
+    /**
+     * @brief Slot frames are being received into.
+     */
+    uint8_t writeSlot = 0;
+
+    /**
+     * @brief Oldest complete frame waiting to be shown.
+     */
+    uint8_t readSlot = 0;
+
+    /**
+     * @brief Complete frames waiting to be shown.
+     */
+    uint8_t queued = 0;
+
+    /**
+     * @brief Time each complete frame arrived, in ms.
+     */
+    uint32_t arrived[NETWORK_JITTER_FRAMES + 1] = {};
+
+    /**
+     * @brief Bytes of pixel data in a frame, from the bottles.
+     */
+    uint32_t frameBytes = 0;
+
+    /**
+     * @brief E1.31 universe, from NETWORK_E131_UNIVERSE, holding the last pixel.
+     */
+    uint16_t lastUniverse = 0;
+
+    /**
+     * @brief Last DDP sequence number, 1-15, or 0 if none yet.
+     */
+    uint8_t ddpSequence = 0;
+
+    /**
+     * @brief Last E1.31 sequence number per universe, plus one, or 0 if none yet.
+     */
+    uint16_t e131Sequence[NETWORK_E131_UNIVERSES] = {};
+
+    /**
+     * @brief Average latency in ms * 8.
+     */
+    uint32_t latencyAverage = 0;
+
+    /**
+     * @brief Parse a DDP packet into the frame being received.
+     *
+     * @param buf packet
+     * @param len packet length
+     * @param now ms
+     */
+    void parseDdp(const uint8_t* buf, int len, uint32_t now);
+
+    /**
+     * @brief Parse an E1.31 packet into the frame being received.
+     *
+     * @param buf packet
+     * @param len packet length
+     * @param now ms
+     */
+    void parseE131(const uint8_t* buf, int len, uint32_t now);
+
+    /**
+     * @brief Copy pixel data into the frame being received.
+     *
+     * @param offset byte offset into the frame
+     * @param data RGB bytes
+     * @param len number of bytes
+     */
+    void store(uint32_t offset, const uint8_t* data, uint32_t len);
+
+    /**
+     * @brief Queue the frame being received and start the next from a copy of it.
+     *
+     * @param now ms
+     */
+    void push(uint32_t now);
+
+    /**
+     * @brief Copy a received frame into the framebuffer.
+     *
+     * @param slot
+     */
+    void present(uint8_t slot);
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "noise.h"
+#include "layout.h"
+#include "log.h"
+
+/**
+ * @brief Permutation hashing the lattice, as in Perlin's improved noise.
+ */
+static const uint8_t PERM[256] = {
+   57, 124, 160, 112, 165, 226,  19, 136, 251,  42, 126, 176, 144, 173, 234, 213,
+  103, 147,  10, 106, 187, 241, 183, 178, 113,  13,  65,  56,  35, 132, 158, 177,
+   33,  87, 109, 122, 154, 174, 150, 211,  55,  70, 247, 180, 202,   9, 149, 131,
+   81, 206,   6, 210,  25,  96,  89,  36, 236,  31, 156,  12, 248,  50,  80,  91,
+  175,  40, 223,  34, 108,  93, 189,  47, 164,  71, 145, 119, 228,  67, 114, 239,
+   59, 255, 107,  76, 212,  83, 184,   0, 179, 102, 182, 127, 117,  88,  54, 229,
+  242,  98,  97, 235, 217, 121,  84, 151,   2, 155,  95,  44,  72,  51,  79, 140,
+  191,  21, 197, 209, 163, 129, 135,  26, 220,  11, 199, 253,  27, 244, 238, 167,
+  172,  52,  24,  49, 232, 196, 237, 200, 204,  30,  62,  77,  14,  94, 190,  53,
+  203,  15, 219, 161,  48, 125, 224,   7, 250, 218, 231,  38, 193,  23,  20,  29,
+  230, 240,  85, 249, 245, 105, 141, 157, 115,  64,   4,  46, 198,   8, 215, 194,
+  138, 134, 123, 227, 148, 169, 146, 110,   3, 130,  60, 142, 186, 104,  22,  28,
+  195, 116, 101, 168, 181,  63,  68, 254, 133,  41, 208,   1,  18,  69,  73,  61,
+  100,  82,  74, 225, 128, 216, 233,  66, 111,  37, 159, 143, 214, 205,  45,  75,
+   32,  39, 153, 185,  99,  17, 252, 222, 243, 221, 139,  78, 120,  92, 188,  16,
+  162, 137,  90, 152,  86, 166, 118, 170, 201,  43,   5, 207, 171, 246, 192,  58
+};
+
+/**
+ * @brief Gradients to the 12 cube edges, padded to 16 so the hash can pick by its low bits.
+ */
+static const int8_t GRADIENTS[16][3] = {
+  {  1,  1,  0 }, { -1,  1,  0 }, {  1, -1,  0 }, { -1, -1,  0 },
+  {  1,  0,  1 }, { -1,  0,  1 }, {  1,  0, -1 }, { -1,  0, -1 },
+  {  0,  1,  1 }, {  0, -1,  1 }, {  0,  1, -1 }, {  0, -1, -1 },
+  {  1,  1,  0 }, {  0, -1,  1 }, { -1,  1,  0 }, {  0, -1, -1 },
+};
+
+/**
+ * @brief Output per lattice unit of noise. Noise rarely strays past +-0.6, so this spreads the
+ *        usual values over 0-255 and clamps the fraction of a percent past them.
+ */
+static const int32_t NOISE_GAIN = 192;
+
+/**
+ * @brief Smoothstep, 3t^2 - 2t^3.
+ *
+ * @param t 0-255, as 0-1
+ * @return 0-65535, as 0-1
+ */
+static inline uint32_t fade(uint32_t t) {
+  return (t * t * (768 - 2 * t)) >> 8;
+}
+
+/**
+ * @brief Interpolate.
+ *
+ * @param a
+ * @param b
+ * @param s 0-65535
+ * @return a to b
+ */
+static inline int32_t lerp(int32_t a, int32_t b, uint32_t s) {
+  return a + (((b - a) * (int32_t)s) >> 16);
+}
+
+/**
+ * @brief Dot product of a lattice corner's gradient with the offset from that corner.
+ *
+ * @param hash corner hash
+ * @param x offset, 1/256 units
+ * @param y offset, 1/256 units
+ * @param z offset, 1/256 units
+ * @return dot product, 1/256 units
+ */
+static inline int32_t grad(uint8_t hash, int32_t x, int32_t y, int32_t z) {
+  const int8_t* g = GRADIENTS[hash & 15];
+  return g[0] * x + g[1] * y + g[2] * z;
+}
+
+uint8_t noise8(uint16_t x, uint16_t y, uint16_t z) {
+  // Lattice cell, and position in it.
+  uint8_t X = x >> 8;
+  uint8_t Y = y >> 8;
+  uint8_t Z = z >> 8;
+  int32_t xf = x & 0xFF;
+  int32_t yf = y & 0xFF;
+  int32_t zf = z & 0xFF;
+  uint32_t u = fade(xf);
+  uint32_t v = fade(yf);
+  uint32_t w = fade(zf);
+
+  // Hash the eight corners. uint8_t arithmetic wraps the lattice.
+  uint8_t A = PERM[X] + Y;
+  uint8_t AA = PERM[A] + Z;
+  uint8_t AB = PERM[(uint8_t)(A + 1)] + Z;
+  uint8_t B = PERM[(uint8_t)(X + 1)] + Y;
+  uint8_t BA = PERM[B] + Z;
+  uint8_t BB = PERM[(uint8_t)(B + 1)] + Z;
+
+  int32_t n = lerp(
+    lerp(
+      lerp(grad(PERM[AA], xf, yf, zf), grad(PERM[BA], xf - 256, yf, zf), u),
+      lerp(grad(PERM[AB], xf, yf - 256, zf), grad(PERM[BB], xf - 256, yf - 256, zf), u),
+      v),
+    lerp(
+      lerp(grad(PERM[(uint8_t)(AA + 1)], xf, yf, zf - 256),
+           grad(PERM[(uint8_t)(BA + 1)], xf - 256, yf, zf - 256), u),
+      lerp(grad(PERM[(uint8_t)(AB + 1)], xf, yf - 256, zf - 256),
+           grad(PERM[(uint8_t)(BB + 1)], xf - 256, yf - 256, zf - 256), u),
+      v),
+    w);
+
+  n = 128 + ((n * NOISE_GAIN + 128) >> 8);
+  return n < 0 ? 0 : (n > 255 ? 255 : n);
+}
+
+#ifdef NOISE_BENCHMARK
+/**
+ * @brief grad() in floating point.
+ */
+static float gradReference(uint8_t hash, float x, float y, float z) {
+  const int8_t* g = GRADIENTS[hash & 15];
+  return g[0] * x + g[1] * y + g[2] * z;
+}
+
+float noiseReference(float x, float y, float z) {
+  float xi = floorf(x), yi = floorf(y), zi = floorf(z);
+  float xf = x - xi, yf = y - yi, zf = z - zi;
+  uint8_t X = (int32_t)xi & 0xFF;
+  uint8_t Y = (int32_t)yi & 0xFF;
+  uint8_t Z = (int32_t)zi & 0xFF;
+  float u = xf * xf * (3 - 2 * xf);
+  float v = yf * yf * (3 - 2 * yf);
+  float w = zf * zf * (3 - 2 * zf);
+  auto mix = [](float a, float b, float s) { return a + (b - a) * s; };
+
+  uint8_t A = PERM[X] + Y;
+  uint8_t AA = PERM[A] + Z;
+  uint8_t AB = PERM[(uint8_t)(A + 1)] + Z;
+  uint8_t B = PERM[(uint8_t)(X + 1)] + Y;
+  uint8_t BA = PERM[B] + Z;
+  uint8_t BB = PERM[(uint8_t)(B + 1)] + Z;
+
+  float n = mix(
+    mix(
+      mix(gradReference(PERM[AA], xf, yf, zf), gradReference(PERM[BA], xf - 1, yf, zf), u),
+      mix(gradReference(PERM[AB], xf, yf - 1, zf), gradReference(PERM[BB], xf - 1, yf - 1, zf), u),
+      v),
+    mix(
+      mix(gradReference(PERM[(uint8_t)(AA + 1)], xf, yf, zf - 1),
+          gradReference(PERM[(uint8_t)(BA + 1)], xf - 1, yf, zf - 1), u),
+      mix(gradReference(PERM[(uint8_t)(AB + 1)], xf, yf - 1, zf - 1),
+          gradReference(PERM[(uint8_t)(BB + 1)], xf - 1, yf - 1, zf - 1), u),
+      v),
+    w);
+
+  n = 128 + n * NOISE_GAIN;
+  return n < 0 ? 0 : (n > 255 ? 255 : n);
+}
+
+void noiseBenchmark(void) {
+  // A pixel's worth of samples per layout pixel, at steps that don't line up with the lattice.
+  const uint32_t samples = LAYOUT_PIXELS;
+  uint32_t sum = 0;
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < samples; i++) {
+    sum += noise8(i * 37, i * 91, i * 13);
+  }
+  uint32_t elapsed = micros() - start;
+  // Keep the loop from being optimized away.
+  if (sum == 0xFFFFFFFF) LOG(NOISE_TIMING, 0, 0);
+
+  float worst = 0;
+  for (uint32_t i = 0; i < samples; i++) {
+    uint16_t x = i * 37, y = i * 91, z = i * 13;
+    float e = fabsf(noise8(x, y, z) - noiseReference(x / 256.0f, y / 256.0f, z / 256.0f));
+    if (e > worst) worst = e;
+  }
+  LOG(NOISE_TIMING, elapsed * 1000 / samples, (uint32_t)(worst * 100));
+}
+#endif
@@ -0,0 +1,47 @@
+#ifndef CRYPTID_NOISE_H
+#define CRYPTID_NOISE_H
+
+#include "def.h"
+
+/**
+ * @brief Coherent 3D gradient noise in fixed point. Coordinates are 8.8 fixed point, one unit per
+ *        lattice cell, and wrap every 256 units. Hashing, gradients and the fade curve are table
+ *        lookups and integer multiplies, so it suits the M4 without touching the FPU.
+ *
+ * @param x 8.8 fixed point
+ * @param y 8.8 fixed point
+ * @param z 8.8 fixed point
+ * @return 0-255, centered on 128
+ */
+uint8_t noise8(uint16_t x, uint16_t y, uint16_t z);
+
+/**
+ * @brief Coherent 2D gradient noise. See noise8(x, y, z).
+ *
+ * @param x 8.8 fixed point
+ * @param y 8.8 fixed point
+ * @return 0-255, centered on 128
+ */
+static inline uint8_t noise8(uint16_t x, uint16_t y) {
+  return noise8(x, y, 0);
+}
+
+#ifdef NOISE_BENCHMARK
+/**
+ * @brief The same noise in floating point, unrounded, to check the fixed point version against.
+ *
+ * @param x lattice units
+ * @param y lattice units
+ * @param z lattice units
+ * @return 0-255
+ */
+float noiseReference(float x, float y, float z);
+
+/**
+ * @brief Time noise8() over a sweep of coordinates and compare it with noiseReference(), logging
+ *        both.
+ */
+void noiseBenchmark(void);
+#endif
+
+#endif
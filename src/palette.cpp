@@ -0,0 +1,41 @@
+#include "palette.h"
+#include "whitebalance.h"
+
+/**
+ * @brief Pack a color with gamma applied, as Pxl8::color() does.
+ *
+ * @param c RGB
+ * @return packed color
+ */
+static uint32_t gammaColor(rgb_t c) {
+  return Adafruit_NeoPixel::Color(
+    Adafruit_NeoPixel::gamma8(c.r),
+    Adafruit_NeoPixel::gamma8(c.g),
+    Adafruit_NeoPixel::gamma8(c.b));
+}
+
+void Palette::hues(uint16_t start, uint8_t sat, uint8_t val) {
+  for (uint16_t i = 0; i < 256; i++) {
+    entries[i] = Adafruit_NeoPixel::gamma32(Adafruit_NeoPixel::ColorHSV(start + (i << 8), sat, val));
+  }
+}
+
+void Palette::ramp(rgb_t c) {
+  uint32_t packed = gammaColor(c);
+  for (uint16_t i = 0; i < 256; i++) {
+    entries[i] = scalePixel(packed, alphaWeight(Adafruit_NeoPixel::gamma8(i)));
+  }
+}
+
+void Palette::whites(void) {
+  for (uint16_t i = 0; i < 256; i++) {
+    entries[i] = gammaColor(unpackRGB(whiteBalanceColor(
+      ((int32_t)MIN_WB_MIRED << 4) + i * ((int32_t)(MAX_WB_MIRED - MIN_WB_MIRED) << 4) / 255)));
+  }
+}
+
+void Palette::blend(const Palette& from, const Palette& to, uint8_t alpha) {
+  for (uint16_t i = 0; i < 256; i++) {
+    entries[i] = blendPixel(from.entries[i], to.entries[i], alpha);
+  }
+}
@@ -0,0 +1,60 @@
+#ifndef CRYPTID_PALETTE_H
+#define CRYPTID_PALETTE_H
+
+#include "def.h"
+#include "swar.h"
+
+/**
+ * @brief 256 packed colors, gamma already applied, that effects pick from by index. Built once,
+ *        so per-pixel work is a table lookup rather than a color conversion.
+ */
+class Palette {
+  public:
+    /**
+     * @brief Color at an index.
+     *
+     * @param i index
+     * @return packed color
+     */
+    uint32_t operator[](uint8_t i) const {
+      return entries[i];
+    }
+
+    /**
+     * @brief Sweep around the color wheel.
+     *
+     * @param start first hue, 0-65535
+     * @param sat 0-255
+     * @param val 0-255
+     */
+    void hues(uint16_t start = 0, uint8_t sat = 255, uint8_t val = 255);
+
+    /**
+     * @brief Ramp from black to a color, gamma correcting the brightness.
+     *
+     * @param c RGB
+     */
+    void ramp(rgb_t c);
+
+    /**
+     * @brief White balances, from the coolest (MIN_WB_MIRED) to the warmest (MAX_WB_MIRED).
+     */
+    void whites(void);
+
+    /**
+     * @brief Blend each entry between two palettes.
+     *
+     * @param from
+     * @param to
+     * @param alpha 0-255, 255 is entirely to
+     */
+    void blend(const Palette& from, const Palette& to, uint8_t alpha);
+
+  private:
+    /**
+     * @brief Colors, packed 0x00RRGGBB.
+     */
+    uint32_t entries[256] = {};
+};
+
+#endif
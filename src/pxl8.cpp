@@ -1,14 +1,88 @@
 #include "pxl8.h"
+#include "log.h"
 
-Pxl8::Pxl8(void) {}
+#ifdef STATIC_ALLOC
+/**
+ * @brief Storage for the NeoPXL8 object.
+ */
+static StaticPool<Adafruit_NeoPXL8> neopxl8Pool;
+
+/**
+ * @brief Storage for the effect layer.
+ */
+static uint32_t baseStorage[NEOPIXEL_NUM_PINS * LAYOUT_LONGEST_STRAND];
+
+#ifndef NO_CROSSFADE
+/**
+ * @brief Storage for the effect fading out.
+ */
+static uint32_t fadeOutStorage[NEOPIXEL_NUM_PINS * LAYOUT_LONGEST_STRAND];
+#endif
+
+#ifdef PALETTE_PIXELS
+/**
+ * @brief Storage for the palette index framebuffer.
+ */
+static uint8_t indexStorage[NEOPIXEL_NUM_PINS * LAYOUT_LONGEST_STRAND];
+#endif
+#endif
+
+#ifdef PALETTE_PIXELS
+/**
+ * @brief The palette at the current brightness, rebuilt each commit.
+ */
+static uint32_t paletteScaled[256];
+#endif
+
+/**
+ * @brief Byte offsets of each channel in the driver's pixel buffer.
+ */
+static const uint8_t R_OFFSET = ((NEOPIXEL_FORMAT) >> 4) & 0b11;
+static const uint8_t G_OFFSET = ((NEOPIXEL_FORMAT) >> 2) & 0b11;
+static const uint8_t B_OFFSET = (NEOPIXEL_FORMAT) & 0b11;
+
+/**
+ * @brief Compose an overlay pixel over a color.
+ *
+ * @param dst packed color under the overlay
+ * @param src packed 0xAARRGGBB
+ * @param opacity 0-255
+ * @param mode
+ * @return packed color
+ */
+static inline uint32_t composePixel(uint32_t dst, uint32_t src, uint8_t opacity, blend_mode_t mode) {
+  uint8_t alpha = ((src >> 24) * ((uint32_t)opacity + 1)) >> 8;
+  if (alpha == 0) return dst;
+  uint32_t c = src & 0xFFFFFF;
+  switch (mode) {
+    case BLEND_ADD:
+      return addPixel(dst, scalePixel(c, alphaWeight(alpha)));
+    case BLEND_MULTIPLY:
+      return blendPixel(dst, multiplyPixel(dst, c), alpha);
+    case BLEND_NORMAL:
+    default:
+      return blendPixel(dst, c, alpha);
+  }
+}
+
+Pxl8::Pxl8(void) {
+  for (auto & o : overlays) {
+    o.opacity = 255;
+    o.mode = BLEND_NORMAL;
+  }
+}
 
 void Pxl8::addStrand(uint8_t pin, uint16_t length) {
   if (neopxl8 != nullptr) {
-    Serial.println(F("Pxl8 Error: Cannot add strands after init."));
+    LOG(PXL8_ADD_AFTER_INIT);
+    return;
+  }
+  if (pin >= NEOPIXEL_NUM_PINS || pins[pin] < 0) {
+    LOG(PXL8_PIN_RANGE, pin);
     return;
   }
-  if (pin > NEOPIXEL_NUM_PINS) {
-    Serial.println(F("Pxl8 Error: Pin out of range."));
+  if ((uint32_t)strands[pin] + length > MAX_STRAND_LENGTH) {
+    LOG(PXL8_TOO_LONG);
     return;
   }
   if (strands[pin] == 0) {
@@ -19,25 +93,59 @@ void Pxl8::addStrand(uint8_t pin, uint16_t length) {
     longest_strand = strands[pin];
   }
   num_pixels += length;
-  num_calc_pixels = longest_strand * num_strands;
-  Serial.print(F("Added strand of "));
-  Serial.println(String(length) + "@" + String(pin) + ",leds:" + String(num_pixels) + "/" + String(num_calc_pixels));
+  num_calc_pixels = (uint32_t)longest_strand * num_strands;
+  LOG(PXL8_STRAND_ADDED, length, pin);
+  LOG(PXL8_PIXELS, num_pixels, num_calc_pixels);
 }
 
 bool Pxl8::init(void) {
-  for (uint8_t i = 0; i < num_strands; i++) {
-    Serial.print(F("Strand: "));
-    Serial.println(String(i) + ":" + String(strands[i]));
+  for (uint8_t i = 0; i < NEOPIXEL_NUM_PINS; i++) {
+    if (strands[i]) {
+      LOG(PXL8_STRAND, i, strands[i]);
+    }
   };
-  Serial.print(F("Longest strand = "));
-  Serial.println(String(longest_strand));
+  LOG(PXL8_LONGEST, longest_strand);
+#ifdef STATIC_ALLOC
+  if (longest_strand > LAYOUT_LONGEST_STRAND) {
+    LOG(PXL8_OUTSIDE_LAYOUT);
+    return false;
+  }
+  neopxl8 = neopxl8Pool.create(longest_strand, pins, (neoPixelType)NEOPIXEL_FORMAT);
+  if (neopxl8 == nullptr) {
+    LOG(PXL8_ALREADY_INIT);
+    return false;
+  }
+  base = baseStorage;
+#ifndef NO_CROSSFADE
+  fadeOut = fadeOutStorage;
+#endif
+#ifdef PALETTE_PIXELS
+  index = indexStorage;
+#endif
+#else
   neopxl8 = new Adafruit_NeoPXL8(longest_strand, pins, (neoPixelType)NEOPIXEL_FORMAT);
-  Serial.print(F("Starting pixels..."));
+  base = new uint32_t[NEOPIXEL_NUM_PINS * longest_strand];
+#ifndef NO_CROSSFADE
+  fadeOut = new uint32_t[NEOPIXEL_NUM_PINS * longest_strand];
+#endif
+#ifdef PALETTE_PIXELS
+  index = new uint8_t[NEOPIXEL_NUM_PINS * longest_strand];
+#endif
+#endif
+  frame = base;
+  fillSpan(base, (uint32_t)NEOPIXEL_NUM_PINS * longest_strand, 0);
+#ifndef NO_CROSSFADE
+  fillSpan(fadeOut, (uint32_t)NEOPIXEL_NUM_PINS * longest_strand, 0);
+#endif
+#ifdef PALETTE_PIXELS
+  memset(index, 0, (uint32_t)NEOPIXEL_NUM_PINS * longest_strand);
+#endif
+  LOG(PXL8_STARTING);
   if (!neopxl8->begin()) {
-    Serial.println(F("fail"));
+    LOG(PXL8_START_FAIL);
     return false;
   }
-  Serial.println(F("success"));
+  LOG(PXL8_STARTED);
   return true;
 }
 
@@ -56,23 +164,172 @@ void Pxl8::cycle(void) {
 }
 
 void Pxl8::show(void) {
+  // NeoPXL8 lanes are laid out the same as the framebuffer, so commit in one pass.
+  uint8_t* out = neopxl8->getPixels();
+  uint32_t n = (uint32_t)NEOPIXEL_NUM_PINS * longest_strand;
+#ifdef PALETTE_PIXELS
+  if (palette != nullptr && indexed && crossfade == 255) {
+    // Brightness is applied to the 256 entries rather than every pixel.
+    for (uint16_t i = 0; i < 256; i++) {
+      paletteScaled[i] = scalePixel((*palette)[i], brightness);
+    }
+    for (uint8_t pin = 0; pin < NEOPIXEL_NUM_PINS; pin++) {
+      const uint8_t* in = &index[(uint32_t)pin * longest_strand];
+      for (uint16_t p = 0; p < strands[pin]; p++) {
+        uint32_t c = paletteScaled[in[p]];
+        out[R_OFFSET] = (uint8_t)(c >> 16);
+        out[G_OFFSET] = (uint8_t)(c >> 8);
+        out[B_OFFSET] = (uint8_t)c;
+        out += 3;
+      }
+      // Past the end of a strand stays black, as it is in base.
+      uint32_t rest = (uint32_t)(longest_strand - strands[pin]) * 3;
+      memset(out, 0, rest);
+      out += rest;
+    }
+    composeOverlays(neopxl8->getPixels());
+    neopxl8->show();
+    return;
+  }
+  if (palette != nullptr && indexed) {
+    // Crossfading from a palette effect: compose in RGB.
+    expandIndices(base);
+  }
+#endif
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t c = base[i];
+#ifndef NO_CROSSFADE
+    if (crossfade != 255) {
+      c = blendPixel(fadeOut[i], c, crossfade);
+    }
+#endif
+    c = scalePixel(c, brightness);
+    out[R_OFFSET] = (uint8_t)(c >> 16);
+    out[G_OFFSET] = (uint8_t)(c >> 8);
+    out[B_OFFSET] = (uint8_t)c;
+    out += 3;
+  }
+  composeOverlays(neopxl8->getPixels());
   neopxl8->show();
 }
 
+void Pxl8::composeOverlays(uint8_t* out) {
+  // Spans compose over pixels already at brightness, so their colors are scaled to match, and
+  // light added is capped where it would be at full brightness.
+  uint8_t cap = (255 * brightness) >> 8;
+  for (auto const& o : overlays) {
+    if (o.opacity == 0) continue;
+    for (uint8_t s = 0; s < o.count; s++) {
+      const pxl8_span_t& span = o.spans[s];
+      uint32_t src = (span.color & 0xFF000000) | scalePixel(span.color & 0xFFFFFF, brightness);
+      uint8_t* p = out + ((uint32_t)span.pin * longest_strand + span.first) * 3;
+      for (uint16_t i = 0; i < span.count; i++, p += 3) {
+        uint32_t dst = ((uint32_t)p[R_OFFSET] << 16) | ((uint32_t)p[G_OFFSET] << 8) | p[B_OFFSET];
+        uint32_t c = composePixel(dst, src, o.opacity, o.mode);
+        uint8_t r = c >> 16, g = c >> 8, b = c;
+        if (o.mode == BLEND_ADD) {
+          r = min(r, cap);
+          g = min(g, cap);
+          b = min(b, cap);
+        }
+        p[R_OFFSET] = r;
+        p[G_OFFSET] = g;
+        p[B_OFFSET] = b;
+      }
+    }
+  }
+}
+
+void Pxl8::setPalette(const Palette* p) {
+  palette = p;
+}
+
+void Pxl8::setIndexed(bool on) {
+#ifdef PALETTE_PIXELS
+  if (indexed && !on && palette != nullptr) {
+    // Bottles not redrawn this frame keep their colors.
+    expandIndices(base);
+  }
+  indexed = on;
+#endif
+}
+
+void Pxl8::beginCrossfade(void) {
+#ifndef NO_CROSSFADE
+  uint32_t n = (uint32_t)NEOPIXEL_NUM_PINS * longest_strand;
+#ifdef PALETTE_PIXELS
+  if (palette != nullptr && indexed) {
+    expandIndices(fadeOut);
+    return;
+  }
+#endif
+  memcpy(fadeOut, base, n * sizeof(uint32_t));
+#endif
+}
+
+void Pxl8::setOverlay(overlay_t layer, uint8_t opacity, blend_mode_t mode) {
+  overlays[layer].opacity = opacity;
+  overlays[layer].mode = mode;
+}
+
+void Pxl8::fillOverlay(overlay_t layer, uint8_t pin, uint16_t first, uint16_t count, uint32_t color, uint8_t alpha) {
+  if (alpha == 0 || count == 0) return;
+  pxl8_overlay_t& o = overlays[layer];
+  if (o.count == OVERLAY_SPANS) {
+    LOG(PXL8_OVERLAY_FULL, layer);
+    return;
+  }
+  o.spans[o.count++] = { ((uint32_t)alpha << 24) | color, first, count, pin };
+}
+
+const uint32_t* Pxl8::frameBuffer(void) {
+#ifdef PALETTE_PIXELS
+  if (palette != nullptr && indexed) {
+    expandIndices(base);
+  }
+#endif
+  return base;
+}
+
+#ifdef PALETTE_PIXELS
+void Pxl8::expandIndices(uint32_t* dest) {
+  for (uint8_t pin = 0; pin < NEOPIXEL_NUM_PINS; pin++) {
+    uint32_t first = (uint32_t)pin * longest_strand;
+    // Past the end of a strand is left black.
+    for (uint16_t p = 0; p < strands[pin]; p++) {
+      dest[first + p] = (*palette)[index[first + p]];
+    }
+  }
+}
+#endif
+
 void Pxl8::setBrightness(uint8_t b) {
-  neopxl8->setBrightness(b);
+  // Same scale as Adafruit_NeoPixel, where 255 is unchanged.
+  brightness = (int16_t)b + 1;
+}
+
+void Pxl8::fadeBrightness(TweenPool* tweens, uint8_t b, uint32_t ms) {
+  tweens->to(&brightness, (int16_t)b + 1, ms);
 }
 
 void Pxl8::setPixelColor(uint8_t pin, uint16_t pixel, uint32_t color) {
-  neopxl8->setPixelColor(pin * strands[pin] + pixel, color);
+  frame[(uint32_t)pin * longest_strand + pixel] = color;
 }
 
 void Pxl8::setPixelColor(uint8_t pin, uint16_t pixel, uint8_t r, uint8_t g, uint8_t b) {
-  neopxl8->setPixelColor(pin * strands[pin] + pixel, color(r, g, b));
+  frame[(uint32_t)pin * longest_strand + pixel] = color(r, g, b);
+}
+
+uint32_t Pxl8::frameHash(void) {
+  const uint8_t* p = neopxl8->getPixels();
+  uint32_t n = (uint32_t)neopxl8->numPixels() * 3;
+  uint32_t hash = 2166136261UL;
+  for (uint32_t i = 0; i < n; i++) {
+    hash = (hash ^ p[i]) * 16777619UL;
+  }
+  return hash;
 }
 
 rgb_t Pxl8::getPixelColor(uint8_t pin, uint16_t pixel) {
-  uint32_t c = neopxl8->getPixelColor(pin * strands[pin] + pixel);
-  uint8_t r = (uint8_t)(c >> 16), g = (uint8_t)(c >> 8), b = (uint8_t)c;
-  return rgb_t{ r, g, b };
+  return unpackRGB(frame[(uint32_t)pin * longest_strand + pixel]);
 }
@@ -3,9 +3,42 @@
 
 #include <Adafruit_NeoPXL8.h>
 #include "def.h"
+#include "layout.h"
+#include "memory.h"
+#include "palette.h"
+#include "swar.h"
+#include "tween.h"
 
 /**
- * @brief Driver for NeoPixels.
+ * @brief A run of pixels on an overlay, all one color.
+ */
+typedef struct {
+  // Packed 0xAARRGGBB.
+  uint32_t color;
+  // First pixel on the strand, and how many.
+  uint16_t first;
+  uint16_t count;
+  uint8_t pin;
+} pxl8_span_t;
+
+/**
+ * @brief An overlay layer over the effect. Overlays cover a few pixels, or whole bottles in one
+ *        color, so they hold spans rather than a layer the size of the framebuffer.
+ */
+typedef struct {
+  // Drawn since it was last cleared, composed in order.
+  pxl8_span_t spans[OVERLAY_SPANS];
+  uint8_t count;
+  // Scales each span's alpha, 0-255.
+  uint8_t opacity;
+  blend_mode_t mode;
+} pxl8_overlay_t;
+
+static_assert(OVERLAY_SPANS < 256, "OVERLAY_SPANS must fit an overlay's 8-bit count");
+
+/**
+ * @brief Driver for NeoPixels. Effects draw to a base layer, and while switching, to the effect
+ *        fading out; overlays compose over both when the frame is committed.
  */
 class Pxl8 {
   public:
@@ -27,17 +60,27 @@ class Pxl8 {
     void cycle(void);
 
     /**
-     * @brief Render.
+     * @brief Render. Composes the layers and commits them to the driver at the current brightness,
+     *        in one pass.
      */
     void show(void);
 
     /**
-     * @brief Set brightness. Only call as a config setting, not as part of animation.
+     * @brief Set brightness. Applied when the framebuffer is committed, so pixels are not rescaled.
      * 
      * @param b 0-255
      */
     void setBrightness(uint8_t b);
 
+    /**
+     * @brief Fade to a brightness.
+     *
+     * @param tweens
+     * @param b 0-255
+     * @param ms fade time in millis
+     */
+    void fadeBrightness(TweenPool* tweens, uint8_t b, uint32_t ms);
+
     /**
      * @brief Get a pxl8 color for a given RGB (0-255) value.
      * 
@@ -95,6 +138,192 @@ class Pxl8 {
      */
     rgb_t getPixelColor(uint8_t pin, uint16_t pixel);
 
+    /**
+     * @brief Get a pixel's packed color.
+     * 
+     * @param pin Pin (strand).
+     * @param pixel Number of pixel on strand (zero-indexed).
+     * @return Packed color.
+     */
+    uint32_t getPixel(uint8_t pin, uint16_t pixel) {
+      return frame[(uint32_t)pin * longest_strand + pixel];
+    }
+
+    /**
+     * @brief Fill a span of pixels.
+     * 
+     * @param pin Pin (strand).
+     * @param first First pixel on strand.
+     * @param count Number of pixels.
+     * @param color Packed color.
+     */
+    void fill(uint8_t pin, uint16_t first, uint16_t count, uint32_t color) {
+      fillSpan(&frame[(uint32_t)pin * longest_strand + first], count, color);
+    }
+
+    /**
+     * @brief Fade a span of pixels toward black.
+     * 
+     * @param pin Pin (strand).
+     * @param first First pixel on strand.
+     * @param count Number of pixels.
+     * @param amount 0-255, 255 leaves pixels unchanged
+     */
+    void fade(uint8_t pin, uint16_t first, uint16_t count, uint8_t amount) {
+      fadeSpan(&frame[(uint32_t)pin * longest_strand + first], count, alphaWeight(amount));
+    }
+
+    /**
+     * @brief Blend a span of pixels toward a color.
+     * 
+     * @param pin Pin (strand).
+     * @param first First pixel on strand.
+     * @param count Number of pixels.
+     * @param color Packed color.
+     * @param alpha 0-255, 255 is entirely color
+     */
+    void blend(uint8_t pin, uint16_t first, uint16_t count, uint32_t color, uint8_t alpha) {
+      blendSpan(&frame[(uint32_t)pin * longest_strand + first], count, color, alpha);
+    }
+
+    /**
+     * @brief Set the palette that pixel indices refer to, or nullptr for an effect that sets colors
+     *        directly. Set for each layer as it's drawn; the effect's is the one set last.
+     *
+     * @param p
+     */
+    void setPalette(const Palette* p);
+
+    /**
+     * @brief Whether palette effects keep indices on the effect layer. Only one palette is shown a
+     *        frame, so when effects share a frame they set colors instead.
+     *
+     * @param on
+     */
+    void setIndexed(bool on);
+
+    /**
+     * @brief Set a pixel to a palette index. With PALETTE_PIXELS, the effect layer keeps the
+     *        index; otherwise the color is looked up now.
+     *
+     * @param pin Pin (strand).
+     * @param pixel Number of pixel on strand (zero-indexed).
+     * @param i Index into the palette set for this frame.
+     */
+    void setPixelIndex(uint8_t pin, uint16_t pixel, uint8_t i) {
+#ifdef PALETTE_PIXELS
+      if (frame == base && indexed) {
+        index[(uint32_t)pin * longest_strand + pixel] = i;
+        return;
+      }
+#endif
+      frame[(uint32_t)pin * longest_strand + pixel] = (*palette)[i];
+    }
+
+    /**
+     * @brief Fill a span of pixels with a palette index.
+     *
+     * @param pin Pin (strand).
+     * @param first First pixel on strand.
+     * @param count Number of pixels.
+     * @param i Index into the palette set for this frame.
+     */
+    void fillIndex(uint8_t pin, uint16_t first, uint16_t count, uint8_t i) {
+#ifdef PALETTE_PIXELS
+      if (frame == base && indexed) {
+        memset(&index[(uint32_t)pin * longest_strand + first], i, count);
+        return;
+      }
+#endif
+      fillSpan(&frame[(uint32_t)pin * longest_strand + first], count, (*palette)[i]);
+    }
+
+    /**
+     * @brief Draw to the effect fading out rather than the current one. See setCrossfade().
+     *
+     * @param outgoing
+     */
+    void drawOutgoing(bool outgoing) {
+#ifdef NO_CROSSFADE
+      frame = base;
+#else
+      frame = outgoing ? fadeOut : base;
+#endif
+    }
+
+    /**
+     * @brief Start a crossfade from what's shown now. The effect fading out keeps drawing on top
+     *        of its last frame. Does nothing with NO_CROSSFADE.
+     */
+    void beginCrossfade(void);
+
+    /**
+     * @brief How far the crossfade to the current effect is.
+     *
+     * @param alpha 0-255, 255 is entirely the current effect, and no crossfade
+     */
+    void setCrossfade(uint8_t alpha) {
+#ifndef NO_CROSSFADE
+      crossfade = alpha;
+#endif
+    }
+
+    /**
+     * @brief Set how an overlay composes over the layers under it.
+     *
+     * @param layer
+     * @param opacity 0-255, scaling each pixel's alpha
+     * @param mode
+     */
+    void setOverlay(overlay_t layer, uint8_t opacity, blend_mode_t mode);
+
+    /**
+     * @brief Draw a pixel on an overlay.
+     *
+     * @param layer
+     * @param pin Pin (strand).
+     * @param pixel Number of pixel on strand (zero-indexed).
+     * @param color Packed color.
+     * @param alpha 0-255, 255 is opaque
+     */
+    void overlay(overlay_t layer, uint8_t pin, uint16_t pixel, uint32_t color, uint8_t alpha) {
+      fillOverlay(layer, pin, pixel, 1, color, alpha);
+    }
+
+    /**
+     * @brief Fill a span of an overlay. Spans drawn later compose over earlier ones. Once
+     *        OVERLAY_SPANS are drawn, more are dropped until it's cleared.
+     *
+     * @param layer
+     * @param pin Pin (strand).
+     * @param first First pixel on strand.
+     * @param count Number of pixels.
+     * @param color Packed color.
+     * @param alpha 0-255, 255 is opaque
+     */
+    void fillOverlay(overlay_t layer, uint8_t pin, uint16_t first, uint16_t count, uint32_t color, uint8_t alpha);
+
+    /**
+     * @brief Clear an overlay.
+     *
+     * @param layer
+     */
+    void clearOverlay(overlay_t layer) {
+      overlays[layer].count = 0;
+    }
+
+    /**
+     * @brief Add a color to a span of pixels, saturating.
+     * 
+     * @param pin Pin (strand).
+     * @param first First pixel on strand.
+     * @param count Number of pixels.
+     * @param color Packed color.
+     */
+    void add(uint8_t pin, uint16_t first, uint16_t count, uint32_t color) {
+      addSpan(&frame[(uint32_t)pin * longest_strand + first], count, color);
+    }
+
     /**
      * @brief Add strand of LEDs. MUST be called before init().
      * 
@@ -103,6 +332,48 @@ class Pxl8 {
      */
     void addStrand(uint8_t pin, uint16_t length);
 
+    /**
+     * @brief Hash the framebuffer (FNV-1a) to compare frames without storing them.
+     *
+     * @return hash
+     */
+    uint32_t frameHash(void);
+
+    /**
+     * @brief The frame last committed, as sent.
+     *
+     * @return 3 bytes per pixel in NEOPIXEL_FORMAT order, laid out as the framebuffer
+     */
+    const uint8_t* committedFrame(void) {
+      return neopxl8->getPixels();
+    }
+
+    /**
+     * @brief Length of longest strand of pixels.
+     *
+     * @return pixels
+     */
+    uint16_t longestStrand(void) {
+      return longest_strand;
+    }
+
+    /**
+     * @brief Brightness, as last set.
+     *
+     * @return 0-255
+     */
+    uint8_t getBrightness(void) {
+      return brightness - 1;
+    }
+
+    /**
+     * @brief The effect layer, for reading. See base. With PALETTE_PIXELS, indices are expanded
+     *        into it first.
+     *
+     * @return NEOPIXEL_NUM_PINS * longestStrand() packed pixels
+     */
+    const uint32_t* frameBuffer(void);
+
   private:
     /**
      * @brief The NeoPXL8 object used to control the pixels.
@@ -110,14 +381,79 @@ class Pxl8 {
     Adafruit_NeoPXL8 *neopxl8 = nullptr;
 
     /**
-     * @brief Pinouts for pixel LEDs on board.
+     * @brief Layer being drawn: base, or while crossfading, fadeOut.
+     */
+    uint32_t *frame = nullptr;
+
+    /**
+     * @brief Effect layer, packed 0x00RRGGBB, indexed by pin * longest_strand + pixel.
+     *        Gamma is applied as pixels are set; brightness when committed.
+     */
+    uint32_t *base = nullptr;
+
+#ifndef NO_CROSSFADE
+    /**
+     * @brief Effect fading out, laid out as base.
+     */
+    uint32_t *fadeOut = nullptr;
+#endif
+
+    /**
+     * @brief Crossfade from fadeOut to base, 0-255. 255 is no crossfade.
+     */
+    uint8_t crossfade = 255;
+
+    /**
+     * @brief Overlays, composed over the effect in order.
+     */
+    pxl8_overlay_t overlays[OVERLAY_MAX] = {};
+
+    /**
+     * @brief Palette that indices refer to this frame, or nullptr.
+     */
+    const Palette* palette = nullptr;
+
+#ifdef PALETTE_PIXELS
+    /**
+     * @brief Palette index framebuffer, laid out as base. Shown instead of base while a palette
+     *        is set.
+     */
+    uint8_t *index = nullptr;
+
+    /**
+     * @brief Whether palette effects draw to index. See setIndexed().
+     */
+    bool indexed = true;
+
+    /**
+     * @brief Expand palette indices.
+     *
+     * @param dest laid out as base
+     */
+    void expandIndices(uint32_t* dest);
+#endif
+
+    /**
+     * @brief Compose overlays over the committed frame, in the driver's pixel buffer.
+     *
+     * @param out NeoPXL8's pixels
+     */
+    void composeOverlays(uint8_t* out);
+
+    /**
+     * @brief Brightness as a 0-256 scale.
+     */
+    int16_t brightness = 256;
+
+    /**
+     * @brief Pin of each NeoPXL8 lane, -1 if unused.
      */
-    int8_t pins[NEOPIXEL_NUM_PINS] = { NEOPIXEL_PINS };
+    int8_t pins[NEOPIXEL_LANES] = { NEOPIXEL_PINS };
 
     /**
-     * @brief Pixel strands. Limited to 5 pins.
+     * @brief Length of each lane's strand.
      */
-    uint16_t strands[NEOPIXEL_NUM_PINS] = { 0, 0, 0, 0, 0 };
+    uint16_t strands[NEOPIXEL_NUM_PINS] = {};
 
     /**
      * @brief Length of longest strand of pixels.
@@ -127,19 +463,19 @@ class Pxl8 {
     /**
      * @brief Total actual pixels.
      */
-    uint16_t num_pixels = 0;
+    uint32_t num_pixels = 0;
 
     /**
      * @brief "Total" number of pixels. This number is used to reference pixel ids and is
      *        the longest strand * the number of strands. The total processing power NeoPXL8
      *        will consume will be the longest strand * 8.
      */
-    uint16_t num_calc_pixels = 0;
+    uint32_t num_calc_pixels = 0;
 
     /**
      * @brief Number of strands added.
      */
-    uint16_t num_strands = 0;
+    uint8_t num_strands = 0;
 };
 
 #endif
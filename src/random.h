@@ -0,0 +1,137 @@
+#ifndef CRYPTID_RANDOM_H
+#define CRYPTID_RANDOM_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Seedable pseudo-random number stream (xorshift32).
+ */
+class Random {
+  public:
+    /**
+     * @brief Construct a new Random stream.
+     *
+     * @param seed any value; zero is replaced with a fixed non-zero seed
+     */
+    Random(uint32_t seed = 1) {
+      this->seed(seed);
+    }
+
+    /**
+     * @brief Restart the stream from a seed.
+     *
+     * @param seed any value; zero is replaced with a fixed non-zero seed
+     */
+    void seed(uint32_t seed) {
+      state = seed ? seed : 0x9E3779B9;
+    }
+
+    /**
+     * @brief Next raw value.
+     *
+     * @return 32 random bits
+     */
+    uint32_t next(void) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      return state;
+    }
+
+    /**
+     * @brief Random number in a range, without division.
+     *
+     * @param low inclusive
+     * @param high exclusive
+     * @return low <= n < high
+     */
+    int32_t range(int32_t low, int32_t high) {
+      return low + (int32_t)(((uint64_t)next() * (uint32_t)(high - low)) >> 32);
+    }
+
+  private:
+    /**
+     * @brief Current state. Never zero.
+     */
+    uint32_t state;
+};
+
+/**
+ * @brief Independent random streams, one per subsystem, so one subsystem drawing more or fewer
+ *        numbers doesn't change what another sees.
+ */
+typedef enum {
+  // Per-frame effect randomness.
+  RANDOM_FRAME = 0,
+  // Glow hue and white balance changes.
+  RANDOM_GLOW = 1,
+  // Faerie spawns.
+  RANDOM_FAERIE = 2,
+  // White balance selection.
+  RANDOM_WHITE_BALANCE = 3,
+  // Number of streams.
+  RANDOM_STREAMS = 4,
+} random_stream_t;
+
+/**
+ * @brief A set of random streams derived from one seed. Re-seeding with the same value replays
+ *        the same sequences.
+ */
+class RandomStreams {
+  public:
+    /**
+     * @brief Seed every stream.
+     *
+     * @param seed
+     */
+    void seed(uint32_t seed) {
+      master = seed;
+      for (uint8_t i = 0; i < RANDOM_STREAMS; i++) {
+        streams[i].seed(mix(seed + i * 0x9E3779B9));
+      }
+    }
+
+    /**
+     * @brief Seed the streams were last seeded with.
+     *
+     * @return seed
+     */
+    uint32_t getSeed(void) {
+      return master;
+    }
+
+    /**
+     * @brief Get a stream.
+     *
+     * @param stream
+     * @return Random
+     */
+    Random& get(random_stream_t stream) {
+      return streams[stream];
+    }
+
+  private:
+    /**
+     * @brief Seed the streams were derived from.
+     */
+    uint32_t master = 0;
+
+    /**
+     * @brief Streams.
+     */
+    Random streams[RANDOM_STREAMS];
+
+    /**
+     * @brief Scramble a seed so nearby seeds give unrelated streams (splitmix32 finalizer).
+     *
+     * @param x
+     * @return scrambled
+     */
+    static uint32_t mix(uint32_t x) {
+      x = (x ^ (x >> 16)) * 0x85EBCA6B;
+      x = (x ^ (x >> 13)) * 0xC2B2AE35;
+      return x ^ (x >> 16);
+    }
+};
+
+#endif
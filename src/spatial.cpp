@@ -0,0 +1,52 @@
+#include "spatial.h"
+
+/**
+ * @brief Scale a distance to coordinates.
+ *
+ * @param mm
+ * @return 1/65536ths of LAYOUT_SPAN_MM
+ */
+static uint16_t toCoord(uint32_t mm) {
+  uint32_t c = mm * 65536 / LAYOUT_SPAN_MM;
+  return c > 65535 ? 65535 : c;
+}
+
+void SpatialMap::begin(void) {
+  uint16_t n = 0;
+  for (size_t i = 0; i < LAYOUT_BOTTLES; i++) {
+    const bottle_layout_t& b = BOTTLE_LAYOUT[i];
+    first[i] = n;
+    for (uint16_t p = 0; p < b.length; p++) {
+      // Evenly up the strip.
+      uint32_t z = b.z + (b.length > 1 ? (uint32_t)b.height * p / (b.length - 1) : 0);
+      coords[n++] = { toCoord(b.x), toCoord(b.y), toCoord(z), b.pin, (uint8_t)i, (uint16_t)(b.start + p) };
+    }
+  }
+
+  // Counting sort into buckets.
+  uint16_t next[SPATIAL_BUCKETS] = {};
+  for (auto const& c : coords) {
+    next[bucket(c.x)]++;
+  }
+  bucketFirst[0] = 0;
+  for (uint8_t b = 0; b < SPATIAL_BUCKETS; b++) {
+    bucketFirst[b + 1] = bucketFirst[b] + next[b];
+    next[b] = bucketFirst[b];
+  }
+  for (uint16_t i = 0; i < LAYOUT_PIXELS; i++) {
+    order[next[bucket(coords[i].x)]++] = i;
+  }
+
+  // Then by x within each. Buckets are small, so insertion sort will do.
+  for (uint8_t b = 0; b < SPATIAL_BUCKETS; b++) {
+    for (uint16_t k = bucketFirst[b] + 1; k < bucketFirst[b + 1]; k++) {
+      uint16_t i = order[k];
+      uint16_t j = k;
+      while (j > bucketFirst[b] && coords[order[j - 1]].x > coords[i].x) {
+        order[j] = order[j - 1];
+        j--;
+      }
+      order[j] = i;
+    }
+  }
+}
@@ -0,0 +1,109 @@
+#ifndef CRYPTID_SPATIAL_H
+#define CRYPTID_SPATIAL_H
+
+#include "def.h"
+#include "layout.h"
+
+/**
+ * @brief Where a pixel is.
+ */
+typedef struct {
+  // Position in 1/65536ths of LAYOUT_SPAN_MM: across, into, and up.
+  uint16_t x;
+  uint16_t y;
+  uint16_t z;
+  // Lane, bottle (index in BOTTLE_LAYOUT), and pixel on its strand.
+  uint8_t pin;
+  uint8_t bottle;
+  uint16_t pixel;
+} pixel_coord_t;
+
+/**
+ * @brief Position of every pixel in BOTTLE_LAYOUT, worked out once at startup so effects can
+ *        sample a field across the whole installation by looking coordinates up. Pixels are also
+ *        sorted into buckets along x, so an effect can visit them from one end to the other, or
+ *        only the part it's lighting.
+ */
+class SpatialMap {
+  public:
+    /**
+     * @brief Work out coordinates from BOTTLE_LAYOUT.
+     */
+    void begin(void);
+
+    /**
+     * @brief Coordinates of a bottle's pixels.
+     *
+     * @param i bottle, in BOTTLE_LAYOUT order
+     * @return one per pixel, from the first
+     */
+    const pixel_coord_t* bottle(size_t i) const {
+      return &coords[first[i]];
+    }
+
+    /**
+     * @brief A pixel in order along x.
+     *
+     * @param k 0 to LAYOUT_PIXELS - 1
+     * @return coordinates
+     */
+    const pixel_coord_t& ordered(uint16_t k) const {
+      return coords[order[k]];
+    }
+
+    /**
+     * @brief First ordered() pixel in a bucket.
+     *
+     * @param b bucket
+     * @return k
+     */
+    uint16_t bucketStart(uint8_t b) const {
+      return bucketFirst[b];
+    }
+
+    /**
+     * @brief One past the last ordered() pixel in a bucket.
+     *
+     * @param b bucket
+     * @return k
+     */
+    uint16_t bucketEnd(uint8_t b) const {
+      return bucketFirst[b + 1];
+    }
+
+    /**
+     * @brief Bucket a position falls in.
+     *
+     * @param x 1/65536ths of LAYOUT_SPAN_MM
+     * @return 0 to SPATIAL_BUCKETS - 1
+     */
+    static uint8_t bucket(uint16_t x) {
+      return ((uint32_t)x * SPATIAL_BUCKETS) >> 16;
+    }
+
+  private:
+    /**
+     * @brief Coordinates of each pixel, in BOTTLE_LAYOUT order.
+     */
+    pixel_coord_t coords[LAYOUT_PIXELS] = {};
+
+    /**
+     * @brief Index in coords of each bottle's first pixel.
+     */
+    uint16_t first[LAYOUT_BOTTLES] = {};
+
+    /**
+     * @brief Indices in coords, in order along x.
+     */
+    uint16_t order[LAYOUT_PIXELS] = {};
+
+    /**
+     * @brief Index in order of each bucket's first pixel, and the end.
+     */
+    uint16_t bucketFirst[SPATIAL_BUCKETS + 1] = {};
+};
+
+static_assert(LAYOUT_PIXEL_RAM + sizeof(SpatialMap) <= PIXEL_RAM_BUDGET,
+  "Pixels and their coordinates need more RAM than PIXEL_RAM_BUDGET");
+
+#endif
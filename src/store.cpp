@@ -0,0 +1,214 @@
+#include "store.h"
+
+/**
+ * @brief Key of the record at the start of each sector, holding its generation.
+ */
+static const uint8_t STORE_HEADER = 0xFE;
+
+/**
+ * @brief Key of erased storage.
+ */
+static const uint8_t STORE_EMPTY = 0xFF;
+
+#ifdef PERSIST_STATE
+#include <Adafruit_SPIFlash.h>
+
+/**
+ * @brief QSPI flash transport.
+ */
+static Adafruit_FlashTransport_QSPI flashTransport;
+
+/**
+ * @brief QSPI flash.
+ */
+static Adafruit_SPIFlash flash(&flashTransport);
+
+bool FlashStoreBackend::begin(void) {
+  if (!flash.begin()) return false;
+  base = flash.size() - STORE_SECTORS * STORE_SECTOR_SIZE;
+  return true;
+}
+
+uint32_t FlashStoreBackend::size(void) {
+  return STORE_SECTORS * STORE_SECTOR_SIZE;
+}
+
+bool FlashStoreBackend::read(uint32_t addr, void* buf, uint32_t len) {
+  return flash.readBuffer(base + addr, (uint8_t*)buf, len) == len;
+}
+
+bool FlashStoreBackend::write(uint32_t addr, const void* buf, uint32_t len) {
+  return flash.writeBuffer(base + addr, (const uint8_t*)buf, len) == len;
+}
+
+bool FlashStoreBackend::erase(uint32_t addr) {
+  // Returns once the erase has started; the flash waits for it before anything else.
+  return flash.eraseSector((base + addr) / STORE_SECTOR_SIZE);
+}
+
+bool FlashStoreBackend::busy(void) {
+  // Write in progress bit.
+  return flash.readStatus() & 0x01;
+}
+#endif
+
+bool RamStoreBackend::begin(void) {
+  return bytes != nullptr;
+}
+
+uint32_t RamStoreBackend::size(void) {
+  return bytesSize;
+}
+
+bool RamStoreBackend::read(uint32_t addr, void* buf, uint32_t len) {
+  if (addr + len > bytesSize) return false;
+  memcpy(buf, bytes + addr, len);
+  return true;
+}
+
+bool RamStoreBackend::write(uint32_t addr, const void* buf, uint32_t len) {
+  if (addr + len > bytesSize) return false;
+  // As flash, writing can only clear bits.
+  const uint8_t* b = (const uint8_t*)buf;
+  for (uint32_t i = 0; i < len; i++) {
+    bytes[addr + i] &= b[i];
+  }
+  return true;
+}
+
+bool RamStoreBackend::erase(uint32_t addr) {
+  if (addr % STORE_SECTOR_SIZE || addr >= bytesSize) return false;
+  memset(bytes + addr, 0xFF, STORE_SECTOR_SIZE);
+  return true;
+}
+
+StateStore::StateStore(StoreBackend* backend) : backend(backend) {}
+
+uint8_t StateStore::check(uint8_t key, uint32_t value) {
+  uint32_t x = value ^ (value >> 16);
+  return 0x5A ^ key ^ (uint8_t)x ^ (uint8_t)(x >> 8);
+}
+
+bool StateStore::readRecord(uint8_t sector, uint32_t offset, store_record_t& record) {
+  if (!backend->read(sector * STORE_SECTOR_SIZE + offset, &record, sizeof(record))) return false;
+  return record.key != STORE_EMPTY && record.check == check(record.key, record.value);
+}
+
+bool StateStore::begin(void) {
+  if (!backend->begin()) return false;
+  sectors = min(backend->size() / STORE_SECTOR_SIZE, (uint32_t)255);
+  if (sectors < 2) return false;
+  ready = true;
+
+  // Replay sectors oldest first, so the latest value of each key wins.
+  store_record_t r;
+  bool found = false;
+  for (;;) {
+    int16_t next = -1;
+    uint32_t nextGeneration = 0;
+    for (uint8_t s = 0; s < sectors; s++) {
+      if (readRecord(s, 0, r) && r.key == STORE_HEADER && r.value > generation
+          && (next < 0 || r.value < nextGeneration)) {
+        next = s;
+        nextGeneration = r.value;
+      }
+    }
+    if (next < 0) break;
+    found = true;
+    active = next;
+    generation = nextGeneration;
+    offset = sizeof(store_record_t);
+    for (; offset + sizeof(store_record_t) <= STORE_SECTOR_SIZE; offset += sizeof(store_record_t)) {
+      if (readRecord(active, offset, r)) {
+        if (r.key < STORE_KEYS) {
+          values[r.key] = saved[r.key] = r.value;
+          known |= 1UL << r.key;
+          stored |= 1UL << r.key;
+        }
+      } else {
+        // Erased storage ends the sector; anything else is a torn write to skip.
+        const uint8_t* b = (const uint8_t*)&r;
+        bool empty = true;
+        for (uint8_t i = 0; i < sizeof(r); i++) empty &= b[i] == 0xFF;
+        if (empty) break;
+      }
+    }
+  }
+
+  if (!found) {
+    active = sectors - 1;
+    return nextSector();
+  }
+  spareErased = erased((active + 1) % sectors);
+  return true;
+}
+
+bool StateStore::erased(uint8_t sector) {
+  uint32_t chunk[16];
+  for (uint32_t at = 0; at < STORE_SECTOR_SIZE; at += sizeof(chunk)) {
+    if (!backend->read(sector * STORE_SECTOR_SIZE + at, chunk, sizeof(chunk))) return false;
+    for (auto word : chunk) {
+      if (word != 0xFFFFFFFF) return false;
+    }
+  }
+  return true;
+}
+
+bool StateStore::get(store_key_t key, uint32_t& value) {
+  if (!(known & (1UL << key))) return false;
+  value = values[key];
+  return true;
+}
+
+void StateStore::set(store_key_t key, uint32_t value, uint32_t now) {
+  if (!ready || ((known & (1UL << key)) && values[key] == value)) return;
+  values[key] = value;
+  known |= 1UL << key;
+  dirty |= 1UL << key;
+  lastChange = now;
+}
+
+void StateStore::loop(uint32_t now) {
+  if (!ready || backend->busy()) return;
+  if (!dirty) {
+    // The oldest sector only holds values the active one's snapshot has too, unless there are just
+    // two and that snapshot may be torn.
+    if (!spareErased && sectors > 2) {
+      spareErased = backend->erase((active + 1) % sectors * STORE_SECTOR_SIZE);
+    }
+    return;
+  }
+  if (now - lastChange < STORE_SETTLE_MS) return;
+  for (uint8_t k = 0; k < STORE_KEYS; k++) {
+    if (dirty & (1UL << k)) {
+      if (!append(k, values[k])) return;
+      saved[k] = values[k];
+      stored |= 1UL << k;
+    }
+  }
+  dirty = 0;
+}
+
+bool StateStore::append(uint8_t key, uint32_t value) {
+  if (offset + sizeof(store_record_t) > STORE_SECTOR_SIZE && !nextSector()) return false;
+  store_record_t r = { key, check(key, value), { 0xFF, 0xFF }, value };
+  // Move on even if the write fails, so a partly written slot isn't written again.
+  uint32_t at = active * STORE_SECTOR_SIZE + offset;
+  offset += sizeof(r);
+  return backend->write(at, &r, sizeof(r));
+}
+
+bool StateStore::nextSector(void) {
+  // Sectors are used in order, so the next is the oldest.
+  uint8_t s = (active + 1) % sectors;
+  if (!spareErased && !backend->erase(s * STORE_SECTOR_SIZE)) return false;
+  spareErased = false;
+  active = s;
+  generation++;
+  offset = 0;
+  if (!append(STORE_HEADER, generation)) return false;
+  for (uint8_t k = 0; k < STORE_KEYS; k++) {
+    if ((stored & (1UL << k)) && !append(k, saved[k])) return false;
+  }
+  return true;
+}
@@ -0,0 +1,309 @@
+#ifndef CRYPTID_STORE_H
+#define CRYPTID_STORE_H
+
+#include <Arduino.h>
+#include "def.h"
+
+/**
+ * @brief Keys of persisted state. Values are stored by id, so only append.
+ */
+typedef enum {
+  STORE_KEY_ON = 0,
+  STORE_KEY_EFFECT = 1,
+  STORE_KEY_BRIGHTNESS = 2,
+  STORE_KEY_COLOR = 3,
+  STORE_KEY_WHITE_BALANCE = 4,
+  STORE_KEY_GLOW_SPEED = 5,
+  STORE_KEY_FAERIE_SPEED = 6,
+  // Per zone, in ZONE_LAYOUT order, MAX_ZONES keys each.
+  STORE_KEY_ZONE_ON = 7,
+  STORE_KEY_ZONE_EFFECT = 15,
+  STORE_KEY_ZONE_COLOR = 23,
+  // Number of keys.
+  STORE_KEYS = 31,
+} store_key_t;
+
+static_assert(MAX_ZONES <= STORE_KEY_ZONE_EFFECT - STORE_KEY_ZONE_ON, "Zone store keys are 8 per setting");
+
+/**
+ * @brief Storage the state store is kept on. Behaves like NOR flash: erasing a sector sets every
+ *        byte to 0xFF, and writes can only clear bits.
+ */
+class StoreBackend {
+  public:
+    virtual ~StoreBackend(void) {}
+
+    /**
+     * @brief Start the storage.
+     *
+     * @return success
+     */
+    virtual bool begin(void) = 0;
+
+    /**
+     * @brief Bytes available, a multiple of STORE_SECTOR_SIZE.
+     *
+     * @return bytes
+     */
+    virtual uint32_t size(void) = 0;
+
+    /**
+     * @brief Read bytes.
+     *
+     * @param addr
+     * @param buf
+     * @param len
+     * @return success
+     */
+    virtual bool read(uint32_t addr, void* buf, uint32_t len) = 0;
+
+    /**
+     * @brief Write bytes to erased storage.
+     *
+     * @param addr
+     * @param buf
+     * @param len
+     * @return success
+     */
+    virtual bool write(uint32_t addr, const void* buf, uint32_t len) = 0;
+
+    /**
+     * @brief Erase a sector. May return before the erase finishes; see busy().
+     *
+     * @param addr start of the sector
+     * @return success
+     */
+    virtual bool erase(uint32_t addr) = 0;
+
+    /**
+     * @brief Whether an erase or write is still running, so anything else would wait for it.
+     *
+     * @return bool
+     */
+    virtual bool busy(void) { return false; }
+};
+
+#ifdef PERSIST_STATE
+/**
+ * @brief The last STORE_SECTORS sectors of the board's QSPI flash.
+ */
+class FlashStoreBackend : public StoreBackend {
+  public:
+    bool begin(void) override;
+    uint32_t size(void) override;
+    bool read(uint32_t addr, void* buf, uint32_t len) override;
+    bool write(uint32_t addr, const void* buf, uint32_t len) override;
+    bool erase(uint32_t addr) override;
+    bool busy(void) override;
+
+  private:
+    /**
+     * @brief Flash address of the first sector used.
+     */
+    uint32_t base = 0;
+};
+#endif
+
+/**
+ * @brief Storage in RAM that behaves as flash, for running the store on a host. Nothing survives
+ *        a reset.
+ */
+class RamStoreBackend : public StoreBackend {
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param bytes Storage, kept for as long as the backend is used. Not erased first.
+     * @param size Bytes, rounded down to a multiple of STORE_SECTOR_SIZE.
+     */
+    RamStoreBackend(uint8_t* bytes, uint32_t size)
+      : bytes(bytes), bytesSize(size / STORE_SECTOR_SIZE * STORE_SECTOR_SIZE) {}
+
+    bool begin(void) override;
+    uint32_t size(void) override;
+    bool read(uint32_t addr, void* buf, uint32_t len) override;
+    bool write(uint32_t addr, const void* buf, uint32_t len) override;
+    bool erase(uint32_t addr) override;
+
+  private:
+    /**
+     * @brief Storage.
+     */
+    uint8_t* bytes;
+
+    /**
+     * @brief Bytes of storage used.
+     */
+    uint32_t bytesSize;
+};
+
+/**
+ * @brief A record in the store: a key and its value, or a sector header.
+ */
+typedef struct {
+  uint8_t key;
+  uint8_t check;
+  uint8_t reserved[2];
+  uint32_t value;
+} store_record_t;
+
+/**
+ * @brief Small key-value store for state that should survive a reset. Records are appended to one
+ *        sector at a time, round robin, so wear is spread evenly; each sector starts with a
+ *        snapshot of every value so the oldest can always be erased. Changes are only written once
+ *        they have settled for STORE_SETTLE_MS.
+ */
+class StateStore {
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param backend Storage.
+     */
+    StateStore(StoreBackend* backend);
+
+    /**
+     * @brief Start the storage and load the latest values.
+     *
+     * @return success
+     */
+    bool begin(void);
+
+    /**
+     * @brief Get a stored value.
+     *
+     * @param key
+     * @param value set if stored
+     * @return whether a value is stored
+     */
+    bool get(store_key_t key, uint32_t& value);
+
+    /**
+     * @brief Set a value. Written later, once values settle.
+     *
+     * @param key
+     * @param value
+     * @param now ms
+     */
+    void set(store_key_t key, uint32_t value, uint32_t now);
+
+    /**
+     * @brief Write values that have settled, or else erase the next sector ahead of time so moving
+     *        to it doesn't wait for an erase. Never waits on the storage. Call each loop.
+     *
+     * @param now ms
+     */
+    void loop(uint32_t now);
+
+  private:
+    /**
+     * @brief Storage.
+     */
+    StoreBackend* backend;
+
+    /**
+     * @brief Whether the storage started.
+     */
+    bool ready = false;
+
+    /**
+     * @brief Current values.
+     */
+    uint32_t values[STORE_KEYS] = {};
+
+    /**
+     * @brief Values as last written.
+     */
+    uint32_t saved[STORE_KEYS] = {};
+
+    /**
+     * @brief Bit per key that has a value.
+     */
+    uint32_t known = 0;
+
+    /**
+     * @brief Bit per key that has been written.
+     */
+    uint32_t stored = 0;
+
+    /**
+     * @brief Bit per key changed since last written.
+     */
+    uint32_t dirty = 0;
+
+    /**
+     * @brief Time of the last change, in ms.
+     */
+    uint32_t lastChange = 0;
+
+    /**
+     * @brief Number of sectors.
+     */
+    uint8_t sectors = 0;
+
+    /**
+     * @brief Sector being written.
+     */
+    uint8_t active = 0;
+
+    /**
+     * @brief Generation of the sector being written; each new sector is one more.
+     */
+    uint32_t generation = 0;
+
+    /**
+     * @brief Offset in the active sector of the next record.
+     */
+    uint32_t offset = 0;
+
+    /**
+     * @brief Whether the sector after the active one is erased, ready to move to.
+     */
+    bool spareErased = false;
+
+    /**
+     * @brief Check byte for a record.
+     *
+     * @param key
+     * @param value
+     * @return check
+     */
+    static uint8_t check(uint8_t key, uint32_t value);
+
+    /**
+     * @brief Read a record.
+     *
+     * @param sector
+     * @param offset
+     * @param record
+     * @return whether the record is valid
+     */
+    bool readRecord(uint8_t sector, uint32_t offset, store_record_t& record);
+
+    /**
+     * @brief Append a record to the active sector, moving to the next if it's full.
+     *
+     * @param key
+     * @param value
+     * @return success
+     */
+    bool append(uint8_t key, uint32_t value);
+
+    /**
+     * @brief Whether a sector is entirely erased.
+     *
+     * @param sector
+     * @return bool
+     */
+    bool erased(uint8_t sector);
+
+    /**
+     * @brief Start writing to the oldest sector, erasing it unless it was erased ahead of time, and
+     *        begin with a snapshot.
+     *
+     * @return success
+     */
+    bool nextSector(void);
+};
+
+#endif
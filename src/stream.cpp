@@ -0,0 +1,188 @@
+#include "stream.h"
+
+#ifdef FRAME_STREAM
+
+#include "log.h"
+
+#ifdef STATIC_ALLOC
+/**
+ * @brief Storage for the last frame sent.
+ */
+static uint32_t sentStorage[NEOPIXEL_NUM_PINS * LAYOUT_LONGEST_STRAND];
+#endif
+
+/**
+ * @brief Encoded frame.
+ */
+static uint8_t encoded[FRAME_STREAM_MAX_BYTES];
+
+/**
+ * @brief Base64 encoded frame, as published.
+ */
+static char message[(FRAME_STREAM_MAX_BYTES + 2) / 3 * 4 + 1];
+
+/**
+ * @brief Base64 encode.
+ *
+ * @param in bytes
+ * @param n number of bytes
+ * @param out buffer of at least (n + 2) / 3 * 4 + 1 chars
+ */
+static void base64(const uint8_t* in, size_t n, char* out) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t i = 0;
+  for (; i + 2 < n; i += 3) {
+    uint32_t v = (uint32_t)in[i] << 16 | (uint32_t)in[i + 1] << 8 | in[i + 2];
+    *out++ = alphabet[v >> 18];
+    *out++ = alphabet[(v >> 12) & 0x3F];
+    *out++ = alphabet[(v >> 6) & 0x3F];
+    *out++ = alphabet[v & 0x3F];
+  }
+  if (i < n) {
+    uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < n ? (uint32_t)in[i + 1] << 8 : 0);
+    *out++ = alphabet[v >> 18];
+    *out++ = alphabet[(v >> 12) & 0x3F];
+    *out++ = i + 1 < n ? alphabet[(v >> 6) & 0x3F] : '=';
+    *out++ = '=';
+  }
+  *out = '\0';
+}
+
+/**
+ * @brief Write a packed color as R, G, B.
+ *
+ * @param out
+ * @param c packed color
+ * @return out after the color
+ */
+static uint8_t* putColor(uint8_t* out, uint32_t c) {
+  *out++ = (uint8_t)(c >> 16);
+  *out++ = (uint8_t)(c >> 8);
+  *out++ = (uint8_t)c;
+  return out;
+}
+
+FrameStream::FrameStream(Pxl8* pxl8, MQTT_Looped* interwebs, std::vector<Bottle*>* bottles)
+  : pxl8(pxl8), interwebs(interwebs), bottles(bottles) {}
+
+void FrameStream::begin(void) {
+#ifdef STATIC_ALLOC
+  sent = sentStorage;
+#else
+  sent = new uint32_t[NEOPIXEL_NUM_PINS * pxl8->longestStrand()];
+#endif
+
+  // Turn streaming on or off.
+  interwebs->onMqtt("cryptid/bottles/stream/set", [&](char* payload, uint16_t /*len*/){
+    enabled = strcmp(payload, "ON") == 0 || strcmp(payload, "on") == 0 || strcmp(payload, "1") == 0;
+    LOG(STREAM, enabled);
+    if (enabled) {
+      interval = 1000 / FRAME_STREAM_FPS;
+      untilKeyframe = 0;
+      publishLayout();
+    }
+  });
+}
+
+void FrameStream::loop(uint32_t now) {
+  if (!enabled || !interwebs->mqttIsConnected() || now - lastSend < interval) return;
+  lastSend = now;
+
+  bool keyframe = untilKeyframe == 0;
+  size_t n = encode(encoded, FRAME_STREAM_MAX_BYTES, keyframe);
+  if (n == FRAME_STREAM_HEADER_BYTES && !keyframe) return;
+  sequence++;
+  untilKeyframe = keyframe ? FRAME_STREAM_KEYFRAME : untilKeyframe - 1;
+  base64(encoded, n, message);
+
+  uint32_t t = micros();
+  interwebs->mqttSendMessage("cryptid/bottles/stream", message);
+  t = micros() - t;
+
+  // Back off when the link is slow, recover gradually when it isn't.
+  if (t > FRAME_STREAM_BUDGET_US) {
+    interval = min(interval * 2, 1000UL / FRAME_STREAM_MIN_FPS);
+    fastSends = 0;
+    LOG(STREAM_BACKOFF, interval, t);
+  } else if (interval > 1000 / FRAME_STREAM_FPS && ++fastSends >= 8) {
+    interval = max(interval / 2, 1000UL / FRAME_STREAM_FPS);
+    fastSends = 0;
+  }
+}
+
+size_t FrameStream::encode(uint8_t* out, size_t cap, bool keyframe) {
+  const uint32_t* cur = pxl8->frameBuffer();
+  uint16_t strand = pxl8->longestStrand();
+  uint32_t n = NEOPIXEL_NUM_PINS * strand;
+  if (keyframe) {
+    fillSpan(sent, n, 0);
+  }
+
+  uint8_t* o = out;
+  *o++ = 'C';
+  *o++ = keyframe ? 'K' : 'D';
+  uint16_t next = sequence + 1;
+  *o++ = (uint8_t)next;
+  *o++ = (uint8_t)(next >> 8);
+  *o++ = NEOPIXEL_NUM_PINS;
+  *o++ = (uint8_t)strand;
+  *o++ = (uint8_t)(strand >> 8);
+  *o++ = pxl8->getBrightness();
+  uint8_t* end = out + cap;
+  // End of the last run that changed pixels; trailing unchanged runs aren't sent.
+  uint8_t* used = o;
+
+  uint32_t i = 0;
+  while (i < n) {
+    uint32_t run = 0;
+    // Unchanged.
+    while (i + run < n && run < 128 && cur[i + run] == sent[i + run]) run++;
+    if (run > 0) {
+      if (o + 1 > end) break;
+      *o++ = run - 1;
+      i += run;
+      continue;
+    }
+    // One color.
+    uint32_t c = cur[i];
+    run = 1;
+    while (i + run < n && run < 64 && cur[i + run] == c) run++;
+    if (run > 1) {
+      if (o + 4 > end) break;
+      *o++ = 0x80 | (run - 1);
+      o = putColor(o, c);
+      fillSpan(&sent[i], run, c);
+      i += run;
+      used = o;
+      continue;
+    }
+    // Changed pixels, up to the next unchanged pixel or repeated color.
+    while (i + run < n && run < 64 && cur[i + run] != sent[i + run]
+        && (i + run + 1 >= n || cur[i + run] != cur[i + run + 1])) run++;
+    if (o + 4 > end) break;
+    run = min(run, (uint32_t)(end - o - 1) / 3);
+    *o++ = 0xC0 | (run - 1);
+    for (uint32_t j = 0; j < run; j++) {
+      o = putColor(o, cur[i + j]);
+      sent[i + j] = cur[i + j];
+    }
+    i += run;
+    used = o;
+  }
+  return used - out;
+}
+
+void FrameStream::publishLayout(void) {
+  static char payload[48 + MAX_BOTTLES * 20];
+  int n = snprintf(payload, sizeof(payload), "{\"pins\":%u,\"strand\":%u,\"bottles\":[",
+    NEOPIXEL_NUM_PINS, pxl8->longestStrand());
+  for (size_t i = 0; i < bottles->size(); i++) {
+    Bottle* b = bottles->at(i);
+    n += snprintf(payload + n, sizeof(payload) - n, "%s[%u,%u,%u]", i ? "," : "",
+      b->getPin(), b->getStartPixel(), b->getLength());
+  }
+  snprintf(payload + n, sizeof(payload) - n, "]}");
+  interwebs->mqttSendMessage("cryptid/bottles/stream/layout", payload, true);
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef CRYPTID_STREAM_H
+#define CRYPTID_STREAM_H
+
+#include <vector>
+#include <MQTT_Looped.h>
+#include "def.h"
+#include "pxl8.h"
+#include "bottle.h"
+
+// Encoded frames start with an 8 byte header:
+//   'C', type ('K' keyframe or 'D' delta), sequence (u16), pins (u8), strand length (u16),
+//   brightness (u8); multi-byte values little-endian.
+// Then runs of pixels in framebuffer order, each starting with a token byte:
+//   0x00-0x7F  next (token + 1) pixels are unchanged
+//   0x80-0xBF  next (token & 0x3F) + 1 pixels are one color, followed by R, G, B
+//   0xC0-0xFF  next (token & 0x3F) + 1 pixels follow, R, G, B each
+// Pixels past the last run are unchanged. Keyframes are encoded against black. Messages are
+// base64 encoded, since MQTT_Looped publishes strings.
+
+/**
+ * @brief Size of the encoded frame header.
+ */
+#define FRAME_STREAM_HEADER_BYTES 8
+
+/**
+ * @brief Streams the committed framebuffer over MQTT, for tools/viewer.py. Frames are delta and
+ *        run-length encoded against the last frame sent, at a decimated rate that backs off when
+ *        publishing is slow.
+ */
+class FrameStream {
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param pxl8 Pointer to Pxl8 object.
+     * @param interwebs Pointer to Interwebs object.
+     * @param bottles Pointer to Bottle objects array.
+     */
+    FrameStream(Pxl8* pxl8, MQTT_Looped* interwebs, std::vector<Bottle*>* bottles);
+
+    /**
+     * @brief Allocate buffers and set up the MQTT command. Call after the pixel driver starts.
+     */
+    void begin(void);
+
+    /**
+     * @brief Send the framebuffer if it's time. Call after each frame is shown.
+     *
+     * @param now frame time in ms
+     */
+    void loop(uint32_t now);
+
+    /**
+     * @brief Whether frames are being streamed.
+     */
+    bool enabled = false;
+
+  private:
+    /**
+     * @brief Pointer to Pxl8 object.
+     */
+    Pxl8* pxl8;
+
+    /**
+     * @brief Pointer to Interwebs object.
+     */
+    MQTT_Looped* interwebs;
+
+    /**
+     * @brief Pointer to Bottle objects array.
+     */
+    std::vector<Bottle*>* bottles;
+
+    /**
+     * @brief Framebuffer as last sent, which deltas are encoded against.
+     */
+    uint32_t* sent = nullptr;
+
+    /**
+     * @brief Time between frames sent, in ms.
+     */
+    uint32_t interval = 1000 / FRAME_STREAM_FPS;
+
+    /**
+     * @brief Time the last frame was sent, in ms.
+     */
+    uint32_t lastSend = 0;
+
+    /**
+     * @brief Sequence number of the last frame sent.
+     */
+    uint16_t sequence = 0;
+
+    /**
+     * @brief Frames until the next keyframe.
+     */
+    uint16_t untilKeyframe = 0;
+
+    /**
+     * @brief Consecutive fast publishes, for recovering from backoff.
+     */
+    uint8_t fastSends = 0;
+
+    /**
+     * @brief Encode the framebuffer, updating what was sent. Stops early if the buffer fills; the
+     *        rest is sent with later frames.
+     *
+     * @param out buffer
+     * @param cap buffer size
+     * @param keyframe encode against black rather than the last frame sent
+     * @return bytes used, including the header
+     */
+    size_t encode(uint8_t* out, size_t cap, bool keyframe);
+
+    /**
+     * @brief Publish the bottle layout so the viewer can draw bottles.
+     */
+    void publishLayout(void);
+};
+
+#endif
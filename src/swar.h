@@ -0,0 +1,161 @@
+#ifndef CRYPTID_SWAR_H
+#define CRYPTID_SWAR_H
+
+#include <Arduino.h>
+
+// Packed pixel kernels. Pixels are 0x00RRGGBB words, so every operation works on all three
+// channels at once, SIMD-within-a-register style. Where the Cortex-M4 DSP extension is available
+// byte-parallel instructions are used; the portable fallbacks produce bit-identical results.
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP == 1
+#define SWAR_DSP 1
+#endif
+
+/**
+ * @brief Scale each channel of a packed pixel.
+ *
+ * @param c packed color
+ * @param scale 0-256, 256 leaves the color unchanged
+ * @return packed color
+ */
+static inline uint32_t scalePixel(uint32_t c, uint32_t scale) {
+  // Red and blue share one multiply, with 8 bits of headroom each.
+  uint32_t rb = (((c & 0xFF00FF) * scale) >> 8) & 0xFF00FF;
+  uint32_t g = (((c & 0x00FF00) * scale) >> 8) & 0x00FF00;
+  return rb | g;
+}
+
+/**
+ * @brief Add two packed pixels, saturating each channel at 255.
+ *
+ * @param a packed color
+ * @param b packed color
+ * @return packed color
+ */
+static inline uint32_t addPixel(uint32_t a, uint32_t b) {
+#ifdef SWAR_DSP
+  return __UQADD8(a, b);
+#else
+  // Add the low 7 bits of each byte, then rebuild bit 7 and its carry out.
+  uint32_t s = (a & 0x7F7F7F7F) + (b & 0x7F7F7F7F);
+  uint32_t carry = ((a & b) | ((a | b) & s)) & 0x80808080;
+  uint32_t sum = s ^ ((a ^ b) & 0x80808080);
+  return sum | ((carry >> 7) * 0xFF);
+#endif
+}
+
+/**
+ * @brief Average two packed pixels, rounding down.
+ *
+ * @param a packed color
+ * @param b packed color
+ * @return packed color
+ */
+static inline uint32_t halfPixel(uint32_t a, uint32_t b) {
+#ifdef SWAR_DSP
+  return __UHADD8(a, b);
+#else
+  return (a & b) + (((a ^ b) >> 1) & 0x7F7F7F7F);
+#endif
+}
+
+/**
+ * @brief Convert an 8-bit alpha to a 0-256 weight, so 255 is entirely the target.
+ *
+ * @param alpha 0-255
+ * @return weight 0-256
+ */
+static inline uint32_t alphaWeight(uint8_t alpha) {
+  return alpha + (alpha >> 7);
+}
+
+/**
+ * @brief Blend one packed pixel toward another.
+ *
+ * @param a packed color
+ * @param b packed target color
+ * @param alpha 0-255, 255 is entirely the target
+ * @return packed color
+ */
+static inline uint32_t blendPixel(uint32_t a, uint32_t b, uint8_t alpha) {
+  uint32_t w = alphaWeight(alpha);
+  uint32_t rb = (((a & 0xFF00FF) * (256 - w) + (b & 0xFF00FF) * w) >> 8) & 0xFF00FF;
+  uint32_t g = (((a & 0x00FF00) * (256 - w) + (b & 0x00FF00) * w) >> 8) & 0x00FF00;
+  return rb | g;
+}
+
+/**
+ * @brief Multiply two packed pixels channel by channel, 255 leaving the other unchanged.
+ *
+ * @param a packed color
+ * @param b packed color
+ * @return packed color
+ */
+static inline uint32_t multiplyPixel(uint32_t a, uint32_t b) {
+  uint32_t r = (((a >> 16) & 0xFF) * (((b >> 16) & 0xFF) + 1)) >> 8;
+  uint32_t g = (((a >> 8) & 0xFF) * (((b >> 8) & 0xFF) + 1)) >> 8;
+  uint32_t bl = ((a & 0xFF) * ((b & 0xFF) + 1)) >> 8;
+  return (r << 16) | (g << 8) | bl;
+}
+
+/**
+ * @brief Fill a span of packed pixels.
+ *
+ * @param p first pixel
+ * @param n number of pixels
+ * @param c packed color
+ */
+static inline void fillSpan(uint32_t* p, uint32_t n, uint32_t c) {
+  while (n--) *p++ = c;
+}
+
+/**
+ * @brief Fade a span of packed pixels toward black.
+ *
+ * @param p first pixel
+ * @param n number of pixels
+ * @param scale 0-256, 256 leaves pixels unchanged
+ */
+static inline void fadeSpan(uint32_t* p, uint32_t n, uint32_t scale) {
+  while (n--) {
+    *p = scalePixel(*p, scale);
+    p++;
+  }
+}
+
+/**
+ * @brief Blend a span of packed pixels toward a color.
+ *
+ * @param p first pixel
+ * @param n number of pixels
+ * @param c packed target color
+ * @param alpha 0-255, 255 is entirely the target
+ */
+static inline void blendSpan(uint32_t* p, uint32_t n, uint32_t c, uint8_t alpha) {
+  uint32_t a = alphaWeight(alpha);
+  uint32_t ia = 256 - a;
+  // The target's share is the same for every pixel.
+  uint32_t crb = (c & 0xFF00FF) * a;
+  uint32_t cg = (c & 0x00FF00) * a;
+  while (n--) {
+    uint32_t rb = (((*p & 0xFF00FF) * ia + crb) >> 8) & 0xFF00FF;
+    uint32_t g = (((*p & 0x00FF00) * ia + cg) >> 8) & 0x00FF00;
+    *p++ = rb | g;
+  }
+}
+
+/**
+ * @brief Add a color to a span of packed pixels, saturating each channel.
+ *
+ * @param p first pixel
+ * @param n number of pixels
+ * @param c packed color
+ */
+static inline void addSpan(uint32_t* p, uint32_t n, uint32_t c) {
+  while (n--) {
+    *p = addPixel(*p, c);
+    p++;
+  }
+}
+
+#endif
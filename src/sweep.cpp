@@ -0,0 +1,31 @@
+#include "sweep.h"
+
+void Sweep::render(const FrameContext& ctx, uint32_t bottles, const zone_t* zones) {
+  // Across and back.
+  uint32_t t = ctx.time % (SWEEP_PERIOD_MS * 2);
+  if (t >= SWEEP_PERIOD_MS) t = SWEEP_PERIOD_MS * 2 - t;
+  int32_t pos = t * 65535 / SWEEP_PERIOD_MS;
+  const int32_t width = SWEEP_WIDTH_MM * 65536 / LAYOUT_SPAN_MM;
+
+  // The trail fades at the same speed whatever the frame rate.
+  uint8_t keep = 255 - min(ctx.delta * 255 / SWEEP_TRAIL_MS, (uint32_t)255);
+  uint32_t colors[LAYOUT_BOTTLES];
+  for (size_t i = 0; i < LAYOUT_BOTTLES; i++) {
+    if (!(bottles & (1UL << i))) continue;
+    const bottle_layout_t& b = BOTTLE_LAYOUT[i];
+    pxl8->fade(b.pin, b.start, b.length, keep);
+    rgb_t c = zones[zoneOf(i)].color;
+    colors[i] = pxl8->color(c.r, c.g, c.b);
+  }
+
+  uint8_t last = SpatialMap::bucket(min(pos + width, (int32_t)65535));
+  for (uint8_t b = SpatialMap::bucket(max(pos - width, (int32_t)0)); b <= last; b++) {
+    for (uint16_t k = spatial->bucketStart(b); k < spatial->bucketEnd(b); k++) {
+      const pixel_coord_t& p = spatial->ordered(k);
+      int32_t d = abs((int32_t)p.x - pos);
+      if (d < width && (bottles & (1UL << p.bottle))) {
+        pxl8->blend(p.pin, p.pixel, 1, colors[p.bottle], 255 - d * 255 / width);
+      }
+    }
+  }
+}
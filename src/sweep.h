@@ -0,0 +1,46 @@
+#ifndef CRYPTID_SWEEP_H
+#define CRYPTID_SWEEP_H
+
+#include "def.h"
+#include "frame.h"
+#include "pxl8.h"
+#include "spatial.h"
+#include "zone.h"
+
+/**
+ * @brief A band of light sweeping across the whole installation and back, leaving a trail. Only
+ *        pixels in buckets the band touches are drawn. Bottles not sweeping are skipped, so the
+ *        band lines up across zones running it.
+ */
+class Sweep {
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param pxl8 Pointer to Pxl8 object.
+     * @param spatial Pixel coordinates.
+     */
+    Sweep(Pxl8* pxl8, const SpatialMap* spatial) : pxl8(pxl8), spatial(spatial) {}
+
+    /**
+     * @brief Render bottles, each in its zone's color.
+     *
+     * @param ctx Current frame.
+     * @param bottles index in BOTTLE_LAYOUT of each bottle to draw, as bits
+     * @param zones one per ZONE_LAYOUT zone
+     */
+    void render(const FrameContext& ctx, uint32_t bottles, const zone_t* zones);
+
+  private:
+    /**
+     * @brief Pointer to the pxl8 object for drawing.
+     */
+    Pxl8* pxl8;
+
+    /**
+     * @brief Pixel coordinates.
+     */
+    const SpatialMap* spatial;
+};
+
+#endif
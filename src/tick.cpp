@@ -0,0 +1,90 @@
+#include "tick.h"
+#include "log.h"
+
+// TC3 counts GCLK1 (48 MHz) / 256: 187.5 KHz, 5.33 us per tick, up to 349 ms on 16 bits.
+
+/**
+ * @brief Ticks for a time in microseconds.
+ */
+#define FRAME_TICK_TICKS(us) ((us) * 3 / 16)
+
+/**
+ * @brief Set by the timer interrupt when it fires.
+ */
+static volatile bool tick_fired = false;
+
+static_assert(FRAME_TICK_TICKS(1000000UL / MIN_FPS) <= 0xFFFF, "MIN_FPS frames are too long for the frame timer");
+static_assert(FRAME_TICK_TICKS(1000000UL / IDLE_FPS) <= 0xFFFF, "IDLE_FPS frames are too long for the frame timer");
+
+extern "C" void TC3_Handler(void) {
+  TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+  tick_fired = true;
+}
+
+void FrameTick::begin(void) {
+  GCLK->PCHCTRL[TC3_GCLK_ID].reg = GCLK_PCHCTRL_GEN_GCLK1 | GCLK_PCHCTRL_CHEN;
+  while (!(GCLK->PCHCTRL[TC3_GCLK_ID].reg & GCLK_PCHCTRL_CHEN));
+  MCLK->APBBMASK.bit.TC3_ = 1;
+
+  TC3->COUNT16.CTRLA.reg = TC_CTRLA_SWRST;
+  while (TC3->COUNT16.SYNCBUSY.bit.SWRST);
+  TC3->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_PRESCALER_DIV256 | TC_CTRLA_PRESCSYNC_PRESC;
+  // Count to CC0, then stop until retriggered.
+  TC3->COUNT16.WAVE.reg = TC_WAVE_WAVEGEN_MFRQ;
+  TC3->COUNT16.CTRLBSET.reg = TC_CTRLBSET_ONESHOT;
+  while (TC3->COUNT16.SYNCBUSY.bit.CTRLB);
+  TC3->COUNT16.INTENSET.reg = TC_INTENSET_OVF;
+
+  NVIC_ClearPendingIRQ(TC3_IRQn);
+  NVIC_SetPriority(TC3_IRQn, 3);
+  NVIC_EnableIRQ(TC3_IRQn);
+
+  // Sleep stops the CPU only; clocks, DMA to the pixels, and SPI to the WiFi module keep running.
+  PM->SLEEPCFG.reg = PM_SLEEPCFG_SLEEPMODE_IDLE;
+  while (PM->SLEEPCFG.reg != PM_SLEEPCFG_SLEEPMODE_IDLE);
+
+  TC3->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (TC3->COUNT16.SYNCBUSY.bit.ENABLE);
+  since = micros();
+}
+
+void FrameTick::arm(uint32_t us) {
+  tick_fired = false;
+  TC3->COUNT16.CC[0].reg = FRAME_TICK_TICKS(us);
+  while (TC3->COUNT16.SYNCBUSY.bit.CC0);
+  TC3->COUNT16.CTRLBSET.reg = TC_CTRLBSET_CMD_RETRIGGER;
+  while (TC3->COUNT16.SYNCBUSY.bit.CTRLB);
+}
+
+uint32_t FrameTick::wait(uint32_t start, uint32_t interval) {
+  uint32_t t;
+  // Send queued log records while waiting.
+  while ((t = micros()) - start < interval && logDrain());
+
+  uint32_t remaining = interval - (t - start);
+  if (t - start < interval && remaining > FRAME_TICK_SPIN_US) {
+    arm(remaining - FRAME_TICK_SPIN_US);
+    // With interrupts masked, one that fires between the check and WFI still wakes it.
+    __disable_irq();
+    while (!tick_fired) {
+      __DSB();
+      __WFI();
+      __enable_irq();
+      __disable_irq();
+    }
+    __enable_irq();
+    slept += micros() - t;
+  }
+
+  while ((t = micros()) - start < interval);
+  return t;
+}
+
+uint8_t FrameTick::sleepPercent(void) {
+  uint32_t t = micros();
+  uint32_t elapsed = t - since;
+  uint8_t pct = elapsed ? (uint64_t)slept * 100 / elapsed : 0;
+  slept = 0;
+  since = t;
+  return pct;
+}
@@ -0,0 +1,53 @@
+#ifndef CRYPTID_TICK_H
+#define CRYPTID_TICK_H
+
+#include "def.h"
+
+/**
+ * @brief Paces frames with a one-shot hardware timer (TC3), sleeping the CPU until each frame is
+ *        due instead of spinning on micros(). The timer wakes it FRAME_TICK_SPIN_US early, and the
+ *        rest is spun for an exact start. Other interrupts (USB, SysTick) also wake it briefly.
+ */
+class FrameTick {
+  public:
+    /**
+     * @brief Set up the timer. Call once, before the first frame.
+     */
+    void begin(void);
+
+    /**
+     * @brief Send queued log records, then sleep until a frame is due.
+     *
+     * @param start micros() the previous frame started
+     * @param interval microseconds between frames
+     * @return micros() on waking
+     */
+    uint32_t wait(uint32_t start, uint32_t interval);
+
+    /**
+     * @brief Share of time spent asleep since the last call.
+     *
+     * @return percent
+     */
+    uint8_t sleepPercent(void);
+
+  private:
+    /**
+     * @brief Time spent asleep since sleepPercent() was last called, in us.
+     */
+    uint32_t slept = 0;
+
+    /**
+     * @brief micros() sleepPercent() was last called.
+     */
+    uint32_t since = 0;
+
+    /**
+     * @brief Start the timer, to fire once after a time.
+     *
+     * @param us microseconds, up to a frame at MIN_FPS or IDLE_FPS
+     */
+    void arm(uint32_t us);
+};
+
+#endif
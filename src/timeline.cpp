@@ -0,0 +1,30 @@
+#include "timeline.h"
+
+void Timeline::begin(const keyframe_t* k, uint8_t n, uint32_t now, uint16_t s) {
+  keyframes = k;
+  count = n;
+  step = 0;
+  speed = s ? s : 1;
+  stepStart = now;
+}
+
+uint32_t Timeline::length(const keyframe_t& k) const {
+  uint32_t ms = ((uint32_t)k.duration << 8) / speed;
+  return ms ? ms : 1;
+}
+
+const keyframe_t* Timeline::resume(uint32_t now, uint16_t& progress) {
+  while (step < count) {
+    const keyframe_t& k = keyframes[step];
+    uint32_t ms = length(k);
+    uint32_t elapsed = now - stepStart;
+    if (elapsed < ms) {
+      // Progress within this step, not the whole timeline.
+      progress = easing(k.ease, (uint64_t)elapsed * 65536 / ms);
+      return &k;
+    }
+    stepStart += ms;
+    step++;
+  }
+  return nullptr;
+}
@@ -0,0 +1,109 @@
+#ifndef CRYPTID_TIMELINE_H
+#define CRYPTID_TIMELINE_H
+
+#include "def.h"
+#include "tween.h"
+
+/**
+ * @brief One step of a timeline: an action held for a length of time, its progress eased.
+ */
+typedef struct {
+  // What the effect draws during the step; its meaning is up to the effect.
+  uint8_t action;
+  // Length in ms at speed 1.
+  uint16_t duration;
+  easing_t ease;
+} keyframe_t;
+
+/**
+ * @brief A sequence of keyframes, resumed each frame from where it left off. The only state is the
+ *        step it's on and when that step started, so any number can run with no stack or heap.
+ */
+class Timeline {
+  public:
+    /**
+     * @brief Start from the first step.
+     *
+     * @tparam N
+     * @param keyframes kept for as long as the timeline runs
+     * @param now frame time, ms
+     * @param speed 8.8 fixed point multiplier, 256 is as written
+     */
+    template<size_t N>
+    void start(const keyframe_t (&keyframes)[N], uint32_t now, uint16_t speed = 256) {
+      static_assert(N > 0 && N < 256, "Timeline needs 1-255 keyframes.");
+      begin(keyframes, N, now, speed);
+    }
+
+    /**
+     * @brief Advance to the step due now. Steps finished since the last frame are skipped, and
+     *        time left over from each carries into the next, so the total length is exact.
+     *
+     * @param now frame time, ms
+     * @param progress eased progress through the step, 0-65535
+     * @return the step, or nullptr once done
+     */
+    const keyframe_t* resume(uint32_t now, uint16_t& progress);
+
+    /**
+     * @brief Whether started and not yet done.
+     *
+     * @return bool
+     */
+    bool running(void) const {
+      return step < count;
+    }
+
+    /**
+     * @brief Stop where it is.
+     */
+    void stop(void) {
+      step = count;
+    }
+
+  private:
+    /**
+     * @brief Steps, in order.
+     */
+    const keyframe_t* keyframes = nullptr;
+
+    /**
+     * @brief Number of steps.
+     */
+    uint8_t count = 0;
+
+    /**
+     * @brief Step being shown, count when done.
+     */
+    uint8_t step = 0;
+
+    /**
+     * @brief Speed multiplier, 8.8 fixed point.
+     */
+    uint16_t speed = 256;
+
+    /**
+     * @brief Frame time the current step started, ms.
+     */
+    uint32_t stepStart = 0;
+
+    /**
+     * @brief Start from the first step.
+     *
+     * @param k keyframes
+     * @param n number of keyframes
+     * @param now frame time, ms
+     * @param s speed, 8.8 fixed point
+     */
+    void begin(const keyframe_t* k, uint8_t n, uint32_t now, uint16_t s);
+
+    /**
+     * @brief Length of a step at the current speed, at least 1 ms.
+     *
+     * @param k
+     * @return ms
+     */
+    uint32_t length(const keyframe_t& k) const;
+};
+
+#endif
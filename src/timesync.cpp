@@ -0,0 +1,91 @@
+#include "timesync.h"
+#include "log.h"
+
+TimeSync::TimeSync(MQTT_Looped* interwebs) : interwebs(interwebs) {}
+
+void TimeSync::begin(void) {
+#if BOARD_ID == 0
+  // Keep time for the other boards.
+  interwebs->onMqtt("cryptid/bottles/time/ping", [&](char* payload, uint16_t /*len*/){
+    uint32_t t1 = millis();
+    char* end;
+    unsigned long board = strtoul(payload, &end, 10);
+    unsigned long t0 = strtoul(end, nullptr, 10);
+    static char topic[40];
+    static char reply[40];
+    snprintf(topic, sizeof(topic), "cryptid/bottles/time/pong/%lu", board);
+    snprintf(reply, sizeof(reply), "%lu %lu %lu", t0, (unsigned long)t1, (unsigned long)millis());
+    interwebs->mqttSendMessage(topic, reply);
+  });
+#else
+  interwebs->onMqtt("cryptid/bottles/time/pong/" STRINGIFY(BOARD_ID), [&](char* payload, uint16_t /*len*/){
+    uint32_t t3 = millis();
+    char* p = payload;
+    uint32_t t0 = strtoul(p, &p, 10);
+    uint32_t t1 = strtoul(p, &p, 10);
+    uint32_t t2 = strtoul(p, &p, 10);
+    sample(t0, t1, t2, t3);
+  });
+#endif
+}
+
+void TimeSync::loop(uint32_t local) {
+#if BOARD_ID != 0
+  uint32_t interval = count < TIME_SYNC_SAMPLES ? TIME_SYNC_FAST_MS : TIME_SYNC_INTERVAL_MS;
+  if (!interwebs->mqttIsConnected() || local - lastPing < interval) return;
+  lastPing = local;
+  static char ping[24];
+  snprintf(ping, sizeof(ping), "%u %lu", BOARD_ID, (unsigned long)local);
+  interwebs->mqttSendMessage("cryptid/bottles/time/ping", ping);
+#endif
+}
+
+void TimeSync::sample(uint32_t t0, uint32_t t1, uint32_t t2, uint32_t t3) {
+  int32_t rtt = (int32_t)(t3 - t0) - (int32_t)(t2 - t1);
+  // A reply to an old ping, or from before board 0 restarted.
+  if (rtt < 0 || (uint32_t)rtt > TIME_SYNC_INTERVAL_MS) return;
+  samples[next] = { t3, ((int32_t)(t1 - t0) + (int32_t)(t2 - t3)) / 2, (uint32_t)rtt };
+  next = (next + 1) % TIME_SYNC_SAMPLES;
+  if (count < TIME_SYNC_SAMPLES) count++;
+
+  // The shortest round trip has the least room for the two directions to differ.
+  uint8_t b = 0;
+  for (uint8_t i = 1; i < count; i++) {
+    if (samples[i].delay < samples[b].delay) b = i;
+  }
+  best = samples[b];
+  delay = best.delay;
+  LOG(TIME_SYNC_SAMPLE, best.offset, best.delay);
+
+  if (!synced) {
+    synced = true;
+    anchor = best;
+    return;
+  }
+  // Skew from the drift in offset over a long enough baseline that round trips don't swamp it.
+  uint32_t baseline = best.local - anchor.local;
+  if (baseline >= TIME_SYNC_SKEW_BASELINE_MS) {
+    int32_t s = (int64_t)(best.offset - anchor.offset) * 1000000000LL / baseline;
+    skew = skew ? skew + (s - skew) / 4 : s;
+    anchor = best;
+  }
+}
+
+int32_t TimeSync::predict(uint32_t local) {
+  return best.offset + (int32_t)((int64_t)(int32_t)(local - best.local) * skew / 1000000000LL);
+}
+
+uint32_t TimeSync::now(uint32_t local) {
+  stepped = false;
+  if (!synced) return local;
+  int32_t target = predict(local);
+  int32_t error = target - applied;
+  if (error > TIME_SYNC_STEP_MS || error < -TIME_SYNC_STEP_MS) {
+    applied = target;
+    stepped = true;
+    LOG(TIME_SYNC_STEP, error);
+  } else {
+    applied += constrain(error, -TIME_SYNC_SLEW_MS, TIME_SYNC_SLEW_MS);
+  }
+  return local + applied;
+}
@@ -0,0 +1,139 @@
+#ifndef CRYPTID_TIMESYNC_H
+#define CRYPTID_TIMESYNC_H
+
+#include <MQTT_Looped.h>
+#include "def.h"
+
+// Boards other than 0 publish "<board> <t0>" on cryptid/bottles/time/ping, with t0 their millis().
+// Board 0 replies on cryptid/bottles/time/pong/<board> with "<t0> <t1> <t2>", t1 and t2 being its
+// millis() on receiving the ping and sending the reply. On receiving the reply at t3, as in NTP:
+//   offset = ((t1 - t0) + (t2 - t3)) / 2
+//   delay  = (t3 - t0) - (t2 - t1)
+
+/**
+ * @brief A time sync measurement.
+ */
+typedef struct {
+  // Local time the reply arrived, in ms.
+  uint32_t local;
+  // Board 0's time less local time, in ms.
+  int32_t offset;
+  // Round trip over the network, in ms.
+  uint32_t delay;
+} time_sample_t;
+
+/**
+ * @brief Keeps animation time in step across boards. Board 0 keeps time; the others estimate the
+ *        offset and skew of their clock from it over MQTT, and slew their frame clock toward it.
+ */
+class TimeSync {
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param interwebs Pointer to Interwebs object.
+     */
+    TimeSync(MQTT_Looped* interwebs);
+
+    /**
+     * @brief Set up MQTT topics. Call before connecting interwebs.
+     */
+    void begin(void);
+
+    /**
+     * @brief Send a ping if it's time. Call each loop.
+     *
+     * @param local millis()
+     */
+    void loop(uint32_t local);
+
+    /**
+     * @brief Shared time for a local time. Moves toward board 0's time by at most
+     *        TIME_SYNC_SLEW_MS per call, unless further off than TIME_SYNC_STEP_MS.
+     *
+     * @param local millis()
+     * @return ms
+     */
+    uint32_t now(uint32_t local);
+
+    /**
+     * @brief Add a measurement.
+     *
+     * @param t0 local time the ping was sent
+     * @param t1 board 0 time the ping arrived
+     * @param t2 board 0 time the reply was sent
+     * @param t3 local time the reply arrived
+     */
+    void sample(uint32_t t0, uint32_t t1, uint32_t t2, uint32_t t3);
+
+    /**
+     * @brief Whether the last call to now() stepped rather than slewed.
+     */
+    bool stepped = false;
+
+    /**
+     * @brief Whether any measurement has been made. Always true on board 0.
+     */
+    bool synced = BOARD_ID == 0;
+
+    /**
+     * @brief Round trip of the measurement in use, in ms.
+     */
+    uint32_t delay = 0;
+
+    /**
+     * @brief Estimated clock skew relative to board 0, in parts per billion.
+     */
+    int32_t skew = 0;
+
+  private:
+    /**
+     * @brief Pointer to Interwebs object.
+     */
+    MQTT_Looped* interwebs;
+
+    /**
+     * @brief Recent measurements, the oldest replaced first.
+     */
+    time_sample_t samples[TIME_SYNC_SAMPLES] = {};
+
+    /**
+     * @brief Measurements made, up to TIME_SYNC_SAMPLES.
+     */
+    uint8_t count = 0;
+
+    /**
+     * @brief Next sample slot.
+     */
+    uint8_t next = 0;
+
+    /**
+     * @brief Measurement in use: the shortest round trip of those kept.
+     */
+    time_sample_t best = {};
+
+    /**
+     * @brief Measurement skew was last estimated from.
+     */
+    time_sample_t anchor = {};
+
+    /**
+     * @brief Offset applied to local time, in ms.
+     */
+    int32_t applied = 0;
+
+    /**
+     * @brief Local time the last ping was sent.
+     */
+    uint32_t lastPing = 0;
+
+    /**
+     * @brief Offset predicted for a local time, from the best measurement and skew.
+     *
+     * @param local ms
+     * @return ms
+     */
+    int32_t predict(uint32_t local);
+};
+
+#endif
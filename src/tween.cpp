@@ -0,0 +1,108 @@
+#include "tween.h"
+#include "log.h"
+#include "swar.h"
+
+/**
+ * @brief Easing curves sampled at 32 even steps, 0-65535. Linear isn't looked up.
+ */
+static const uint16_t EASING_LUT[EASE_MAX][33] = {
+  // EASE_LINEAR
+  {},
+  // EASE_IN: t^3
+  { 0, 2, 16, 54, 128, 250, 432, 686, 1024, 1458, 2000, 2662, 3456, 4394, 5488, 6750, 8192,
+    9826, 11664, 13718, 16000, 18522, 21296, 24334, 27648, 31250, 35151, 39365, 43903, 48777,
+    53999, 59581, 65535 },
+  // EASE_OUT: 1 - (1 - t)^3
+  { 0, 5954, 11536, 16758, 21632, 26170, 30384, 34285, 37887, 41201, 44239, 47013, 49535, 51817,
+    53871, 55709, 57343, 58785, 60047, 61141, 62079, 62873, 63535, 64077, 64511, 64849, 65103,
+    65285, 65407, 65481, 65519, 65533, 65535 },
+  // EASE_IN_OUT: (1 - cos(PI * t)) / 2
+  { 0, 158, 630, 1411, 2494, 3869, 5522, 7438, 9597, 11980, 14563, 17321, 20228, 23256, 26375,
+    29556, 32767, 35979, 39160, 42279, 45307, 48214, 50972, 53555, 55938, 58097, 60013, 61666,
+    63041, 64124, 64905, 65377, 65535 },
+};
+
+uint16_t easing(easing_t ease, uint16_t progress) {
+  if (ease == EASE_LINEAR || ease >= EASE_MAX) return progress;
+  // 32 steps of 2048, interpolated.
+  const uint16_t* lut = EASING_LUT[ease];
+  uint8_t i = progress >> 11;
+  uint32_t frac = progress & 0x7FF;
+  return lut[i] + (((int32_t)lut[i + 1] - lut[i]) * (int32_t)frac >> 11);
+}
+
+void TweenPool::to(int16_t* value, int16_t target, uint32_t ms, easing_t ease) {
+  add({ value, *value, target, time, ms, ease, TWEEN_INT16 });
+}
+
+void TweenPool::toColor(uint32_t* value, uint32_t target, uint32_t ms, easing_t ease) {
+  add({ value, (int32_t)*value, (int32_t)target, time, ms, ease, TWEEN_RGB });
+}
+
+void TweenPool::add(const tween_t& t) {
+  cancel(t.value);
+  if (t.duration == 0 || t.from == t.to) {
+    apply(t, 65535);
+    return;
+  }
+  if (count == TWEEN_POOL_SIZE) {
+    LOG(TWEEN_POOL_FULL);
+    apply(t, 65535);
+    return;
+  }
+  tweens[count++] = t;
+}
+
+void TweenPool::cancel(const void* value) {
+  for (uint8_t i = 0; i < count; i++) {
+    if (tweens[i].value == value) {
+      tweens[i] = tweens[--count];
+      return;
+    }
+  }
+}
+
+bool TweenPool::active(const void* value) const {
+  for (uint8_t i = 0; i < count; i++) {
+    if (tweens[i].value == value) return true;
+  }
+  return false;
+}
+
+void TweenPool::update(uint32_t now) {
+  time = now;
+  uint8_t i = 0;
+  while (i < count) {
+    const tween_t& t = tweens[i];
+    uint32_t elapsed = now - t.start;
+    if (elapsed >= t.duration) {
+      apply(t, 65535);
+      // Finished; the last tween takes its place.
+      tweens[i] = tweens[--count];
+      continue;
+    }
+    apply(t, easing(t.ease, (uint64_t)elapsed * 65536 / t.duration));
+    i++;
+  }
+}
+
+void TweenPool::apply(const tween_t& t, uint16_t eased) {
+  if (eased == 65535) {
+    // Exactly the end, whatever the rounding.
+    if (t.kind == TWEEN_RGB) {
+      *(uint32_t*)t.value = (uint32_t)t.to;
+    } else {
+      *(int16_t*)t.value = t.to;
+    }
+    return;
+  }
+  switch (t.kind) {
+    case TWEEN_RGB:
+      *(uint32_t*)t.value = blendPixel((uint32_t)t.from, (uint32_t)t.to, eased >> 8);
+      break;
+    case TWEEN_INT16:
+    default:
+      *(int16_t*)t.value = t.from + (int32_t)(((int64_t)(t.to - t.from) * eased + 32768) >> 16);
+      break;
+  }
+}
@@ -0,0 +1,140 @@
+#ifndef CRYPTID_TWEEN_H
+#define CRYPTID_TWEEN_H
+
+#include "def.h"
+
+/**
+ * @brief Easing curves.
+ */
+typedef enum {
+  EASE_LINEAR,
+  EASE_IN,
+  EASE_OUT,
+  EASE_IN_OUT,
+  EASE_MAX,
+} easing_t;
+
+/**
+ * @brief What a tween writes to.
+ */
+typedef enum {
+  TWEEN_INT16,
+  TWEEN_RGB,
+} tween_kind_t;
+
+/**
+ * @brief A value moving from one number (or packed color) to another.
+ */
+typedef struct {
+  // Value written each frame.
+  void* value;
+  // Start and end, as int16_t, or packed 0x00RRGGBB.
+  int32_t from;
+  int32_t to;
+  // Frame time the tween started, in ms.
+  uint32_t start;
+  // Length in ms.
+  uint32_t duration;
+  easing_t ease;
+  tween_kind_t kind;
+} tween_t;
+
+/**
+ * @brief Eased progress, 0-65535 fixed point, from a 33 point table per curve.
+ *
+ * @param ease
+ * @param progress 0-65535
+ * @return eased progress, 0-65535
+ */
+uint16_t easing(easing_t ease, uint16_t progress);
+
+/**
+ * @brief Pool of values being faded. Each frame, only active tweens are advanced; a finished tween
+ *        writes its end value and leaves the pool.
+ */
+class TweenPool {
+  public:
+    /**
+     * @brief Fade a number. Replaces any tween already on it, starting from its current value.
+     *
+     * @param value
+     * @param target
+     * @param ms length, 0 to set now
+     * @param ease
+     */
+    void to(int16_t* value, int16_t target, uint32_t ms, easing_t ease = EASE_IN_OUT);
+
+    /**
+     * @brief Fade a packed color. Replaces any tween already on it, starting from its current value.
+     *
+     * @param value 0x00RRGGBB
+     * @param target 0x00RRGGBB
+     * @param ms length, 0 to set now
+     * @param ease
+     */
+    void toColor(uint32_t* value, uint32_t target, uint32_t ms, easing_t ease = EASE_IN_OUT);
+
+    /**
+     * @brief Stop fading a value, leaving it where it is.
+     *
+     * @param value
+     */
+    void cancel(const void* value);
+
+    /**
+     * @brief Whether a value is being faded.
+     *
+     * @param value
+     * @return bool
+     */
+    bool active(const void* value) const;
+
+    /**
+     * @brief Advance active tweens. Call once per frame, before rendering.
+     *
+     * @param now frame time, ms
+     */
+    void update(uint32_t now);
+
+    /**
+     * @brief Number of active tweens.
+     *
+     * @return count
+     */
+    uint8_t size(void) const {
+      return count;
+    }
+
+  private:
+    /**
+     * @brief Active tweens, packed at the front.
+     */
+    tween_t tweens[TWEEN_POOL_SIZE] = {};
+
+    /**
+     * @brief Number of active tweens.
+     */
+    uint8_t count = 0;
+
+    /**
+     * @brief Time of the current frame. Tweens started between frames start from it.
+     */
+    uint32_t time = 0;
+
+    /**
+     * @brief Add a tween, replacing any on the same value.
+     *
+     * @param t
+     */
+    void add(const tween_t& t);
+
+    /**
+     * @brief Write a tween's value at eased progress.
+     *
+     * @param t
+     * @param eased 0-65535
+     */
+    static void apply(const tween_t& t, uint16_t eased);
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "whitebalance.h"
+#include "color.h"
+#include "swar.h"
+
+// The table is built by the compiler, so the math is C++11 constexpr: one return statement,
+// recursion instead of loops, and no <cmath>.
+
+/**
+ * @brief ln(2).
+ */
+constexpr double WB_LN2 = 0.69314718055994531;
+
+/**
+ * @brief Sum of y^n / n over odd n, from the term given.
+ *
+ * @param y2 y squared
+ * @param term y^n
+ * @param n odd power
+ * @return sum
+ */
+constexpr double wbAtanhSeries(double y2, double term, int n) {
+  return n > 41 ? 0 : term / n + wbAtanhSeries(y2, term * y2, n + 2);
+}
+
+/**
+ * @brief ln(m) = 2 atanh((m - 1) / (m + 1)), which converges quickly for 1 <= m < 2.
+ *
+ * @param y (m - 1) / (m + 1)
+ * @return ln(m)
+ */
+constexpr double wbLogMantissa(double y) {
+  return 2 * wbAtanhSeries(y * y, y, 1);
+}
+
+/**
+ * @brief Natural log, halving or doubling into 1-2 first.
+ *
+ * @param x > 0
+ * @return ln(x)
+ */
+constexpr double wbLog(double x) {
+  return x >= 2 ? wbLog(x / 2) + WB_LN2
+       : x < 1 ? wbLog(x * 2) - WB_LN2
+       : wbLogMantissa((x - 1) / (x + 1));
+}
+
+/**
+ * @brief Sum of the exponential's Taylor series, from the term given.
+ *
+ * @param x |x| <= 1 or so
+ * @param term x^(n - 1) / (n - 1)!
+ * @param n
+ * @return sum
+ */
+constexpr double wbExpSeries(double x, double term, int n) {
+  return n > 24 ? term : term + wbExpSeries(x, term * x / n, n + 1);
+}
+
+/**
+ * @brief x raised to a power.
+ *
+ * @param x > 0
+ * @param p small, so p ln(x) is near 0
+ * @return x^p
+ */
+constexpr double wbPow(double x, double p) {
+  return wbExpSeries(p * wbLog(x), 1, 1);
+}
+
+/**
+ * @brief Round and clamp to a channel.
+ *
+ * @param v
+ * @return 0-255
+ */
+constexpr uint32_t wbChannel(double v) {
+  return v <= 0 ? 0 : v >= 255 ? 255 : (uint32_t)(v + 0.5);
+}
+
+/**
+ * @brief Tanner Helland's fit of blackbody color, by channel.
+ *
+ * @param t temperature in hundreds of kelvin
+ * @return channel, unclamped
+ *
+ * @see https://tannerhelland.com/2012/09/18/convert-temperature-rgb-algorithm-code.html
+ */
+constexpr double wbRed(double t) {
+  return t <= 66 ? 255 : 329.698727446 * wbPow(t - 60, -0.1332047592);
+}
+constexpr double wbGreen(double t) {
+  return t <= 66 ? 99.4708025861 * wbLog(t) - 161.1195681661
+       : 288.1221695283 * wbPow(t - 60, -0.0755148492);
+}
+constexpr double wbBlue(double t) {
+  return t >= 66 ? 255 : t <= 19 ? 0 : 138.5177312231 * wbLog(t - 10) - 305.0447927307;
+}
+
+/**
+ * @brief Blackbody color.
+ *
+ * @param t temperature in hundreds of kelvin
+ * @return packed 0x00RRGGBB
+ */
+constexpr uint32_t wbPack(double t) {
+  return wbChannel(wbRed(t)) << 16 | wbChannel(wbGreen(t)) << 8 | wbChannel(wbBlue(t));
+}
+
+/**
+ * @brief Blackbody color of a white balance.
+ *
+ * @param mired
+ * @return packed 0x00RRGGBB
+ */
+constexpr uint32_t blackbody(uint16_t mired) {
+  return wbPack(10000.0 / mired);
+}
+
+/**
+ * @brief The table, wrapped so a constexpr function can return it.
+ */
+typedef struct {
+  uint32_t rgb[WB_STEPS];
+} wb_table_t;
+
+/**
+ * @brief 0, 1, ..., N - 1 as a parameter pack (std::index_sequence is C++14).
+ */
+template<size_t... I> struct wb_indices {};
+template<size_t N, size_t... I> struct wb_range : wb_range<N - 1, N - 1, I...> {};
+template<size_t... I> struct wb_range<0, I...> {
+  typedef wb_indices<I...> type;
+};
+
+/**
+ * @brief Blackbody color of each mired from MIN_WB_MIRED.
+ *
+ * @tparam I
+ * @return table
+ */
+template<size_t... I>
+constexpr wb_table_t whiteBalanceTable(wb_indices<I...>) {
+  return wb_table_t{ { blackbody(MIN_WB_MIRED + I)... } };
+}
+
+/**
+ * @brief Color of each whole mired, MIN_WB_MIRED to MAX_WB_MIRED, in flash.
+ */
+static constexpr wb_table_t WB_TABLE = whiteBalanceTable(wb_range<WB_STEPS>::type());
+
+static_assert(blackbody(152) == 0xFFFFFC, "6600K should be about white.");
+static_assert(WB_TABLE.rgb[0] == blackbody(MIN_WB_MIRED), "White balance table starts at MIN_WB_MIRED.");
+
+uint32_t whiteBalanceColor(int32_t mired16) {
+  mired16 = min(max(mired16, (int32_t)MIN_WB_MIRED << 4), (int32_t)MAX_WB_MIRED << 4);
+  uint16_t i = (mired16 >> 4) - MIN_WB_MIRED;
+  uint8_t frac = mired16 & 0xF;
+  if (frac == 0) return WB_TABLE.rgb[i];
+  return blendPixel(WB_TABLE.rgb[i], WB_TABLE.rgb[i + 1], frac << 4);
+}
+
+rgb_t whiteBalanceRGB(white_balance_t mired) {
+  return unpackRGB(whiteBalanceColor((int32_t)mired << 4));
+}
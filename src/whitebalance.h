@@ -0,0 +1,29 @@
+#ifndef CRYPTID_WHITEBALANCE_H
+#define CRYPTID_WHITEBALANCE_H
+
+#include "def.h"
+#include "color.h"
+
+/**
+ * @brief Number of entries in the white balance table, one per mired.
+ */
+constexpr uint16_t WB_STEPS = MAX_WB_MIRED - MIN_WB_MIRED + 1;
+
+/**
+ * @brief Color of a white balance, interpolated between whole mireds. Lookups are O(1), so a fade
+ *        can follow the blackbody curve by tweening the mireds and looking up every frame.
+ *
+ * @param mired16 mireds, 12.4 fixed point, clamped to MIN_WB_MIRED-MAX_WB_MIRED
+ * @return packed 0x00RRGGBB, without gamma
+ */
+uint32_t whiteBalanceColor(int32_t mired16);
+
+/**
+ * @brief Color of a white balance.
+ *
+ * @param mired clamped to MIN_WB_MIRED-MAX_WB_MIRED
+ * @return RGB, without gamma
+ */
+rgb_t whiteBalanceRGB(white_balance_t mired);
+
+#endif
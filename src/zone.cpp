@@ -0,0 +1,51 @@
+#include "zone.h"
+
+uint8_t zoneOf(size_t bottle) {
+  for (uint8_t z = 0; z < LAYOUT_ZONES; z++) {
+    if (ZONE_LAYOUT[z].bottles & (1UL << bottle)) return z;
+  }
+  return 0;
+}
+
+/**
+ * @brief Effect a zone renders.
+ *
+ * @param zone
+ * @return animation
+ */
+static bottle_animation_t zoneAnimation(const zone_t& zone) {
+  return zone.on ? zone.animation : BOTTLE_ANIMATION_OFF;
+}
+
+void ZonePlan::build(const zone_t* zones, const std::vector<Bottle*>& bottles) {
+  count = 0;
+  uint8_t n = 0;
+  bool batched[LAYOUT_ZONES] = {};
+  for (uint8_t z = 0; z < LAYOUT_ZONES; z++) {
+    if (batched[z]) continue;
+    bottle_animation_t animation = zoneAnimation(zones[z]);
+    effect_batch_t& batch = batches[count++];
+    batch = { animation, &order[n], &orderZones[n], 0, 0 };
+    // This zone and every later one running the same effect.
+    for (uint8_t y = z; y < LAYOUT_ZONES; y++) {
+      if (batched[y] || zoneAnimation(zones[y]) != animation) continue;
+      batched[y] = true;
+      for (size_t i = 0; i < bottles.size(); i++) {
+        if (ZONE_LAYOUT[y].bottles & (1UL << i)) {
+          order[n] = bottles[i];
+          orderZones[n] = y;
+          n++;
+          batch.count++;
+          batch.mask |= 1UL << i;
+        }
+      }
+    }
+  }
+}
+
+bool ZonePlan::uses(bottle_animation_t animation) const {
+  for (uint8_t i = 0; i < count; i++) {
+    if (batches[i].animation == animation) return true;
+  }
+  return false;
+}
@@ -0,0 +1,109 @@
+#ifndef CRYPTID_ZONE_H
+#define CRYPTID_ZONE_H
+
+#include <vector>
+#include "def.h"
+#include "layout.h"
+#include "bottle.h"
+
+/**
+ * @brief What a zone shows.
+ */
+typedef struct zone_t {
+  bool on;
+  bottle_animation_t animation;
+  // Color for Illuminate and Sweep.
+  rgb_t color;
+  // White balance the color is from, so Illuminate can calibrate it per bottle, or 0 for RGB.
+  white_balance_t white;
+  zone_t(void)
+    : on(true), animation(BOTTLE_ANIMATION_DEFAULT), color(255, 255, 255), white(0) {}
+} zone_t;
+
+/**
+ * @brief Zone a bottle is in.
+ *
+ * @param bottle index in BOTTLE_LAYOUT
+ * @return index in ZONE_LAYOUT
+ */
+uint8_t zoneOf(size_t bottle);
+
+/**
+ * @brief Bottles running one effect, from every zone that runs it.
+ */
+typedef struct {
+  bottle_animation_t animation;
+  // Bottles, zone by zone.
+  Bottle* const* bottles;
+  // Zone of each bottle.
+  const uint8_t* zones;
+  uint8_t count;
+  // Index in BOTTLE_LAYOUT of each bottle, as bits.
+  uint32_t mask;
+} effect_batch_t;
+
+/**
+ * @brief Bottles grouped by the effect their zone runs, so each effect is dispatched once a frame
+ *        over a contiguous run of bottles and its tables stay in cache while it runs. Rebuilt only
+ *        when a zone's effect changes.
+ */
+class ZonePlan {
+  public:
+    /**
+     * @brief Group bottles by effect.
+     *
+     * @param zones one per ZONE_LAYOUT zone
+     * @param bottles in BOTTLE_LAYOUT order
+     */
+    void build(const zone_t* zones, const std::vector<Bottle*>& bottles);
+
+    /**
+     * @brief Number of effects.
+     *
+     * @return batches
+     */
+    uint8_t size(void) const {
+      return count;
+    }
+
+    /**
+     * @brief Bottles running an effect.
+     *
+     * @param i 0 to size() - 1
+     * @return batch
+     */
+    const effect_batch_t& operator[](uint8_t i) const {
+      return batches[i];
+    }
+
+    /**
+     * @brief Whether any zone runs an effect.
+     *
+     * @param animation
+     * @return bool
+     */
+    bool uses(bottle_animation_t animation) const;
+
+  private:
+    /**
+     * @brief Bottles in batch order.
+     */
+    Bottle* order[LAYOUT_BOTTLES] = {};
+
+    /**
+     * @brief Zone of each bottle in order.
+     */
+    uint8_t orderZones[LAYOUT_BOTTLES] = {};
+
+    /**
+     * @brief One per effect in use, in the order zones first use them.
+     */
+    effect_batch_t batches[LAYOUT_ZONES] = {};
+
+    /**
+     * @brief Number of batches.
+     */
+    uint8_t count = 0;
+};
+
+#endif
@@ -0,0 +1,119 @@
+/**
+ * @brief Micro-benchmark of the color primitives in src/color.h and src/swar.h against the float
+ *        and loop helpers they replaced, on a host. Also checks how far each strays from its
+ *        reference. The time is the host's; COLOR_BENCHMARK times them on the board. See
+ *        colorbench.sh.
+ */
+#include <chrono>
+#include <Arduino.h>
+#include "colorbench.h"
+#include "swar.h"
+
+HostSerial Serial;
+
+/**
+ * @brief Calls timed per primitive.
+ */
+static const uint32_t BENCH_CALLS = 20000000;
+
+/**
+ * @brief Keeps results from being optimized away.
+ */
+static volatile uint32_t sink;
+
+/**
+ * @brief Time a primitive over a spread of inputs.
+ *
+ * @param name
+ * @param f called with 0 to BENCH_CALLS - 1
+ * @return ns per call
+ */
+template<typename F>
+static double bench(const char* name, F f) {
+  uint32_t acc = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < BENCH_CALLS; i++) {
+    acc += f(i);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  sink = acc;
+  ns /= BENCH_CALLS;
+  printf("  %-36s %6.2f ns\n", name, ns);
+  return ns;
+}
+
+/**
+ * @brief Largest difference between two channels.
+ */
+static uint8_t channelDiff(rgb_t a, rgb_t b) {
+  uint8_t dr = a.r > b.r ? a.r - b.r : b.r - a.r;
+  uint8_t dg = a.g > b.g ? a.g - b.g : b.g - a.g;
+  uint8_t db = a.b > b.b ? a.b - b.b : b.b - a.b;
+  return max(dr, max(dg, db));
+}
+
+int main(void) {
+  // Inputs cycle through a range as effects see them: hues a few turns either way, and colors
+  // and alphas over their whole range.
+  printf("Hue wrap, degrees, up to a turn out:\n");
+  bench("colorBefore::normalizeHue(int)", [](uint32_t i) { return (uint32_t)colorBefore::normalizeHue((int)(i * 7919U % 1080) - 360); });
+  bench("normalizeHue(int)", [](uint32_t i) { return (uint32_t)normalizeHue((int)(i * 7919U % 1080) - 360); });
+  printf("Hue wrap, degrees, three turns either way:\n");
+  bench("colorBefore::normalizeHue(int)", [](uint32_t i) { return (uint32_t)colorBefore::normalizeHue((int)(i % 2160) - 1080); });
+  bench("normalizeHue(int)", [](uint32_t i) { return (uint32_t)normalizeHue((int)(i % 2160) - 1080); });
+
+  printf("Hue to 0-65535:\n");
+  bench("colorBefore::normalizeHue16(float)", [](uint32_t i) { return (uint32_t)colorBefore::normalizeHue16((float)(i % 2160) * 0.5f - 540); });
+  bench("normalizeHue16(float)", [](uint32_t i) { return (uint32_t)normalizeHue16((float)(i % 2160) * 0.5f - 540); });
+  bench("normalizeHue16Fixed", [](uint32_t i) { return (uint32_t)normalizeHue16Fixed(((int32_t)(i % 2160) - 1080) * 128); });
+
+  printf("Blend two colors:\n");
+  bench("colorBefore::blendRGB", [](uint32_t i) {
+    rgb_t c = colorBefore::blendRGB(rgb_t{ (uint8_t)i, (uint8_t)40, (uint8_t)200 }, rgb_t{ (uint8_t)10, (uint8_t)(i >> 8), (uint8_t)90 }, (i & 0xFF) / 255.0f);
+    return (uint32_t)c.r + c.g + c.b;
+  });
+  bench("blendRGB", [](uint32_t i) {
+    rgb_t c = blendRGB(rgb_t{ (uint8_t)i, (uint8_t)40, (uint8_t)200 }, rgb_t{ (uint8_t)10, (uint8_t)(i >> 8), (uint8_t)90 }, (i & 0xFF) / 255.0f);
+    return (uint32_t)c.r + c.g + c.b;
+  });
+  bench("lerpRGB(rgb_t)", [](uint32_t i) {
+    rgb_t c = lerpRGB(rgb_t{ (uint8_t)i, (uint8_t)40, (uint8_t)200 }, rgb_t{ (uint8_t)10, (uint8_t)(i >> 8), (uint8_t)90 }, (uint8_t)i);
+    return (uint32_t)c.r + c.g + c.b;
+  });
+  bench("lerpRGB(packed)", [](uint32_t i) { return lerpRGB((i & 0xFF) << 16 | 0x28C8, 0x0A005A | (i & 0xFF00), (uint8_t)i); });
+  bench("blendPixel", [](uint32_t i) { return blendPixel((i & 0xFF) << 16 | 0x28C8, 0x0A005A | (i & 0xFF00), (uint8_t)i); });
+
+  // Every input, against the reference.
+  printf("Largest difference from the reference:\n");
+  uint32_t worst = 0;
+  for (int h = -1080; h <= 1080; h++) {
+    // The loop version left 360 as 360; both agree everywhere else.
+    if (h % 360 == 0) continue;
+    worst = max(worst, (uint32_t)abs((int)normalizeHue(h) - (int)colorBefore::normalizeHue(h)));
+  }
+  printf("  normalizeHue(int)               %u degrees\n", (unsigned)worst);
+  worst = 0;
+  for (int h8 = -540 * 256; h8 < 540 * 256; h8++) {
+    float h = h8 / 256.0f;
+    if (fmodf(h, 360) == 0) continue;
+    worst = max(worst, (uint32_t)abs((int)normalizeHue16(h) - (int)colorBefore::normalizeHue16(h)));
+  }
+  printf("  normalizeHue16(float)           %u of 65535\n", (unsigned)worst);
+  worst = 0;
+  for (uint32_t a = 0; a < 256; a++) {
+    for (uint32_t c = 0; c < 256; c++) {
+      for (uint32_t t = 0; t < 256; t += 5) {
+        float amount = a / 255.0f;
+        worst = max(worst, (uint32_t)channelDiff(blendRGB(rgb_t{ (uint8_t)c, (uint8_t)0, (uint8_t)0 }, rgb_t{ (uint8_t)t, (uint8_t)0, (uint8_t)0 }, amount),
+          colorBefore::blendRGB(rgb_t{ (uint8_t)c, (uint8_t)0, (uint8_t)0 }, rgb_t{ (uint8_t)t, (uint8_t)0, (uint8_t)0 }, amount)));
+      }
+    }
+  }
+  printf("  blendRGB                        %u per channel\n", (unsigned)worst);
+  uint32_t wrong = 0;
+  for (uint32_t x = 0; x <= 65534; x++) {
+    wrong += div255(x) != x / 255;
+  }
+  printf("  div255, 0-65534                 %u wrong\n", (unsigned)wrong);
+  return 0;
+}
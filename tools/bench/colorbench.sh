@@ -0,0 +1,8 @@
+#!/bin/sh
+# Build the color primitive benchmark with the host's compiler and run it.
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+bin="${TMPDIR:-/tmp}/cryptid-colorbench"
+${CXX:-g++} -std=gnu++11 -O2 -Wall $CXXFLAGS -DCOLOR_BENCHMARK -I"$here/../golden/host" -I"$here/../../src" \
+  "$here/colorbench.cpp" -o "$bin"
+exec "$bin"
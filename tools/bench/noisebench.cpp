@@ -0,0 +1,74 @@
+/**
+ * @brief Benchmark of noise8() on a host, and a check of how far it strays from noiseReference(),
+ *        the same noise in floating point, and that it's smooth from one step to the next. The
+ *        time is the host's; NOISE_BENCHMARK times it on the board. See noisebench.sh.
+ */
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "noise.h"
+
+HostSerial Serial;
+
+/**
+ * @brief Samples timed, and compared with the reference.
+ */
+static const uint32_t BENCH_SAMPLES = 10000000;
+static const uint32_t BENCH_CHECKED = 200000;
+
+/**
+ * @brief Most noise8() may differ from the reference, out of 255: rounding the fade curve and
+ *        interpolation to 8.8, and the result to a whole step.
+ */
+static const float BENCH_MAX_ERROR = 3;
+
+/**
+ * @brief Most neighbouring samples 1/256 of a cell apart may differ by.
+ */
+static const int BENCH_MAX_STEP = 4;
+
+/**
+ * @brief Keeps results from being optimized away.
+ */
+static volatile uint32_t sink;
+
+int main(void) {
+  // Steps that don't line up with the lattice, as noiseBenchmark() takes.
+  uint32_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+    sum += noise8(i * 37, i * 91, i * 13);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  sink = sum;
+  printf("noise8: %.2f ns per sample on this host\n", ns / BENCH_SAMPLES);
+
+  float worst = 0;
+  std::vector<float> reference;
+  uint32_t clamped = 0;
+  for (uint32_t i = 0; i < BENCH_CHECKED; i++) {
+    uint16_t x = i * 37, y = i * 91, z = i * 13;
+    uint8_t n = noise8(x, y, z);
+    float r = noiseReference(x / 256.0f, y / 256.0f, z / 256.0f);
+    worst = max(worst, fabsf(n - r));
+    reference.push_back(r);
+    clamped += n == 0 || n == 255;
+  }
+  std::sort(reference.begin(), reference.end());
+  printf("Largest difference from the reference over %u samples: %.2f of 255\n",
+    (unsigned)BENCH_CHECKED, worst);
+  printf("Reference 1st, 50th and 99th percentiles: %.1f, %.1f, %.1f; %u samples clamped\n",
+    reference[BENCH_CHECKED / 100], reference[BENCH_CHECKED / 2], reference[BENCH_CHECKED * 99 / 100],
+    (unsigned)clamped);
+
+  int step = 0;
+  for (uint32_t x = 0; x < 65535; x++) {
+    step = max(step, abs((int)noise8(x, 1234, 777) - (int)noise8(x + 1, 1234, 777)));
+  }
+  printf("Largest step between neighbouring samples along x: %d\n", step);
+
+  bool ok = worst <= BENCH_MAX_ERROR && step <= BENCH_MAX_STEP;
+  printf(ok ? "ok\n" : "FAILED: over %.0f from the reference, or steps over %d.\n", BENCH_MAX_ERROR,
+    BENCH_MAX_STEP);
+  return ok ? 0 : 1;
+}
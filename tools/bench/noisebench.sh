@@ -0,0 +1,9 @@
+#!/bin/sh
+# Build the noise benchmark with the host's compiler and run it.
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+src="$here/../../src"
+bin="${TMPDIR:-/tmp}/cryptid-noisebench"
+${CXX:-g++} -std=gnu++11 -O2 -Wall $CXXFLAGS -DNOISE_BENCHMARK -I"$here/../golden/host" -I"$src" \
+  "$here/noisebench.cpp" "$src/noise.cpp" "$src/log.cpp" -o "$bin"
+exec "$bin"
@@ -0,0 +1,485 @@
+/**
+ * @brief Golden-frame check for the effects, on a Linux host. Each effect renders a fixed run of
+ *        frames at injected times from seeded random streams, over the bottles in src/layout.h,
+ *        and every committed frame is hashed. See golden.sh.
+ *
+ *   golden [--effect name]                  compare with the checked-in hashes
+ *   golden --update                         rewrite the checked-in hashes
+ *   golden --record frames.bin              save every frame, e.g. before changing an effect
+ *   golden --compare frames.bin [--tolerance n]
+ *                                           compare with saved frames, allowing each channel to
+ *                                           differ by n, e.g. after a fixed point rewrite
+ */
+#include <string>
+#include <vector>
+#include "bottle.h"
+#include "palette.h"
+#include "pxl8.h"
+#include "random.h"
+#include "spatial.h"
+#include "sweep.h"
+#include "tween.h"
+#include "zone.h"
+
+HostSerial Serial;
+
+/**
+ * @brief Seed for every run's random streams.
+ */
+static const uint32_t GOLDEN_SEED = 0xC0FFEE;
+
+/**
+ * @brief Frames rendered per effect, and the time between them in ms: 4 s at about 60 fps, long
+ *        enough for a faerie's flight and a few hue fades.
+ */
+static const uint16_t GOLDEN_FRAMES = 240;
+static const uint32_t GOLDEN_FRAME_MS = 17;
+
+/**
+ * @brief How often a bottle's hue or white balance changes in glow effects, in ms.
+ */
+static const uint32_t GOLDEN_GLOW_CHANGE_MS = 700;
+
+/**
+ * @brief Everything an effect draws with, made new for each effect so none sees another's state.
+ */
+class Run {
+  public:
+    Pxl8 pxl8;
+    TweenPool tweens;
+    RandomStreams streams;
+    FrameContext frame;
+    std::vector<Bottle*> bottles;
+    zone_t zones[LAYOUT_ZONES];
+    Sweep sweep;
+
+    Run(const SpatialMap* spatial) : frame(&streams.get(RANDOM_FRAME), &tweens), sweep(&pxl8, spatial) {
+      for (size_t i = 0; i < LAYOUT_BOTTLES; i++) {
+        const bottle_layout_t& b = BOTTLE_LAYOUT[i];
+        bottles.push_back(new Bottle(&pxl8, b.pin, b.start, b.length, i));
+        bottles[i]->setCoords(spatial->bottle(i));
+        bottles[i]->setWhiteOffset(b.wbOffset);
+      }
+      pxl8.init();
+      pxl8.setOverlay(OVERLAY_PARTICLES, 255, BLEND_NORMAL);
+      pxl8.setOverlay(OVERLAY_ALERTS, ALERT_OPACITY, BLEND_NORMAL);
+      streams.seed(GOLDEN_SEED);
+      // Starting hues as setup() picks them.
+      Random& r = streams.get(RANDOM_GLOW);
+      for (auto & bottle : bottles) {
+        uint16_t hue = r.range(0, 360);
+        bottle->setHue(hue, hue + r.range(30, 40));
+      }
+    }
+
+    ~Run() {
+      for (auto & bottle : bottles) {
+        delete bottle;
+      }
+    }
+};
+
+/**
+ * @brief One effect: what it draws each frame, and the palette it draws from.
+ */
+typedef struct {
+  const char* name;
+  const Palette* palette;
+  void (*render)(Run& run);
+} golden_effect_t;
+
+static SpatialMap spatialMap;
+static Palette rainbowPalette;
+static Palette rainPalette;
+static Palette whitePalette;
+
+/**
+ * @brief Change a random bottle's hue every so often, as Control does.
+ *
+ * @param run
+ */
+static void changeHue(Run& run) {
+  if (run.frame.time % GOLDEN_GLOW_CHANGE_MS >= GOLDEN_FRAME_MS) return;
+  Random& r = run.streams.get(RANDOM_GLOW);
+  uint8_t id = r.range(0, run.bottles.size());
+  uint16_t hueStart = r.range(0, 360);
+  run.bottles[id]->setHue(run.frame, hueStart, hueStart + r.range(30, 40), r.range(1500, 2500));
+}
+
+/**
+ * @brief Change a random bottle's white balance every so often, as Control does.
+ *
+ * @param run
+ */
+static void changeWhiteBalance(Run& run) {
+  if (run.frame.time % GOLDEN_GLOW_CHANGE_MS >= GOLDEN_FRAME_MS) return;
+  Random& r = run.streams.get(RANDOM_GLOW);
+  uint8_t id = r.range(0, run.bottles.size());
+  white_balance_t mired = r.range(MIN_WB_MIRED, MAX_WB_MIRED + 1);
+  run.bottles[id]->setWhiteBalance(run.frame, mired, r.range(1500, 2500));
+}
+
+static const golden_effect_t EFFECTS[] = {
+  { "glow", nullptr, [](Run& run) {
+    changeHue(run);
+    for (auto & b : run.bottles) b->glow(run.frame);
+  } },
+  { "glow-sawtooth", nullptr, [](Run& run) {
+    changeHue(run);
+    for (auto & b : run.bottles) b->glow(run.frame, 1.25, 1, SAWTOOTH);
+  } },
+  { "glow-color", nullptr, [](Run& run) {
+    changeWhiteBalance(run);
+    for (auto & b : run.bottles) b->glowColor(run.frame);
+  } },
+  { "noise", nullptr, [](Run& run) {
+    changeHue(run);
+    for (auto & b : run.bottles) b->noise(run.frame);
+  } },
+  { "noise-color", nullptr, [](Run& run) {
+    changeWhiteBalance(run);
+    for (auto & b : run.bottles) b->noiseColor(run.frame);
+  } },
+  { "rain", &rainPalette, [](Run& run) {
+    for (auto & b : run.bottles) b->rain(run.frame);
+  } },
+  { "rainbow", &rainbowPalette, [](Run& run) {
+    for (auto & b : run.bottles) b->rainbow(run.frame);
+  } },
+  { "faeries", nullptr, [](Run& run) {
+    for (auto & b : run.bottles) b->glow(run.frame);
+    // One flight from the first frame, then another from a second bottle once it lands.
+    static uint8_t flying;
+    if (run.frame.index == 1) {
+      flying = 0;
+      run.bottles[flying]->spawnFaerie(run.frame, 320);
+    }
+    if (!run.bottles[flying]->showFaerie(run.frame) && flying == 0) {
+      flying = run.bottles.size() - 1;
+      run.bottles[flying]->spawnFaerie(run.frame, 384, rgb_t{ 255, 160, 40 });
+    }
+  } },
+  { "sweep", nullptr, [](Run& run) {
+    run.sweep.render(run.frame, (1UL << LAYOUT_BOTTLES) - 1, run.zones);
+  } },
+  { "warning", nullptr, [](Run& run) {
+    for (auto & b : run.bottles) b->warning(run.frame);
+  } },
+  { "alerts", nullptr, [](Run& run) {
+    for (auto & b : run.bottles) b->glow(run.frame);
+    for (auto & b : run.bottles) {
+      if (run.frame.time < 2000) b->warningWiFi(run.frame);
+      else b->warningMQTT(run.frame);
+    }
+  } },
+  { "loop-colors", &whitePalette, [](Run& run) {
+    for (auto & b : run.bottles) b->loopColors(run.frame, TEST_WB_STEPS);
+  } },
+  { "test-blink", nullptr, [](Run& run) {
+    for (auto & b : run.bottles) b->testBlink(run.frame);
+  } },
+  { "illuminate", nullptr, [](Run& run) {
+    for (size_t i = 0; i < run.bottles.size(); i++) {
+      if (i & 1) run.bottles[i]->illuminateWhite(DEFAULT_WB_MIRED + 40);
+      else run.bottles[i]->illuminate(rgb_t{ 255, 120, 30 });
+    }
+  } },
+};
+
+static const size_t NUM_EFFECTS = sizeof(EFFECTS) / sizeof(EFFECTS[0]);
+
+/**
+ * @brief Bytes in a committed frame.
+ *
+ * @param run
+ * @return bytes
+ */
+static uint32_t frameBytes(Run& run) {
+  return (uint32_t)run.pxl8.longestStrand() * NEOPIXEL_NUM_PINS * 3;
+}
+
+/**
+ * @brief Render an effect, handing each committed frame on.
+ *
+ * @param effect
+ * @param onFrame called with the frame number, the driver's pixels, and their size
+ */
+template<typename F>
+static void render(const golden_effect_t& effect, F onFrame) {
+  Run* run = new Run(&spatialMap);
+  for (uint16_t f = 0; f < GOLDEN_FRAMES; f++) {
+    run->frame.advance(f * GOLDEN_FRAME_MS);
+    run->tweens.update(run->frame.time);
+    run->pxl8.setPalette(effect.palette);
+    run->pxl8.clearOverlay(OVERLAY_PARTICLES);
+    run->pxl8.clearOverlay(OVERLAY_ALERTS);
+    effect.render(*run);
+    run->pxl8.show();
+    onFrame(f, run->pxl8.committedFrame(), frameBytes(*run));
+  }
+  delete run;
+}
+
+/**
+ * @brief Hash of an effect's frames: FNV-1a over each frame, chained.
+ *
+ * @param effect
+ * @return hash
+ */
+static uint32_t hashEffect(const golden_effect_t& effect) {
+  uint32_t hash = 2166136261UL;
+  render(effect, [&](uint16_t, const uint8_t* p, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+      hash = (hash ^ p[i]) * 16777619UL;
+    }
+  });
+  return hash;
+}
+
+/**
+ * @brief Read the checked-in hashes.
+ *
+ * @param path
+ * @param names
+ * @param hashes
+ * @return false if the file can't be read
+ */
+static bool readGolden(const char* path, std::vector<std::string>& names, std::vector<uint32_t>& hashes) {
+  FILE* f = fopen(path, "r");
+  if (f == nullptr) return false;
+  char line[128];
+  char name[64];
+  unsigned long hash;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%63s %lx", name, &hash) == 2) {
+      names.push_back(name);
+      hashes.push_back(hash);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+/**
+ * @brief Whether an effect was asked for.
+ *
+ * @param effect
+ * @param only name, or nullptr for all
+ * @return bool
+ */
+static bool selected(const golden_effect_t& effect, const char* only) {
+  return only == nullptr || strcmp(effect.name, only) == 0;
+}
+
+/**
+ * @brief Compare every effect with the checked-in hashes, or rewrite them.
+ *
+ * @param path golden.txt
+ * @param update
+ * @param only effect name, or nullptr for all
+ * @return exit status
+ */
+static int checkHashes(const char* path, bool update, const char* only) {
+  std::vector<std::string> names;
+  std::vector<uint32_t> hashes;
+  if (!readGolden(path, names, hashes) && !update) {
+    fprintf(stderr, "Can't read %s; run with --update to write it.\n", path);
+    return 2;
+  }
+  int failed = 0;
+  FILE* out = nullptr;
+  if (update) {
+    out = fopen(path, "w");
+    if (out == nullptr) {
+      fprintf(stderr, "Can't write %s.\n", path);
+      return 2;
+    }
+    fprintf(out, "# Golden frame hashes, from tools/golden/golden.sh --update. %u frames at %u ms, seed 0x%X.\n",
+      GOLDEN_FRAMES, (unsigned)GOLDEN_FRAME_MS, (unsigned)GOLDEN_SEED);
+  }
+  for (auto const& effect : EFFECTS) {
+    if (!update && !selected(effect, only)) continue;
+    uint32_t hash = hashEffect(effect);
+    if (update) {
+      fprintf(out, "%s %08x\n", effect.name, (unsigned)hash);
+      continue;
+    }
+    size_t i = 0;
+    while (i < names.size() && names[i] != effect.name) i++;
+    if (i == names.size()) {
+      printf("%-14s %08x  NEW\n", effect.name, (unsigned)hash);
+      failed++;
+    } else if (hashes[i] != hash) {
+      printf("%-14s %08x  CHANGED, was %08x\n", effect.name, (unsigned)hash, (unsigned)hashes[i]);
+      failed++;
+    } else {
+      printf("%-14s %08x  ok\n", effect.name, (unsigned)hash);
+    }
+  }
+  if (update) {
+    fclose(out);
+    printf("Wrote %s.\n", path);
+    return 0;
+  }
+  return failed ? 1 : 0;
+}
+
+/**
+ * @brief Header of a file of saved frames. Each effect follows as its name, NUL padded to 32
+ *        bytes, then GOLDEN_FRAMES frames of frameBytes each.
+ */
+typedef struct {
+  char magic[4];
+  uint32_t effects;
+  uint32_t frames;
+  uint32_t frameBytes;
+} golden_record_t;
+
+static const size_t GOLDEN_NAME_BYTES = 32;
+
+/**
+ * @brief Save every frame of every effect.
+ *
+ * @param path
+ * @return exit status
+ */
+static int record(const char* path) {
+  FILE* f = fopen(path, "wb");
+  if (f == nullptr) {
+    fprintf(stderr, "Can't write %s.\n", path);
+    return 2;
+  }
+  golden_record_t header = { { 'C', 'G', 'F', '1' }, (uint32_t)NUM_EFFECTS, GOLDEN_FRAMES, 0 };
+  fwrite(&header, sizeof(header), 1, f);
+  for (auto const& effect : EFFECTS) {
+    char name[GOLDEN_NAME_BYTES] = {};
+    strncpy(name, effect.name, GOLDEN_NAME_BYTES - 1);
+    fwrite(name, sizeof(name), 1, f);
+    render(effect, [&](uint16_t, const uint8_t* p, uint32_t n) {
+      header.frameBytes = n;
+      fwrite(p, 1, n, f);
+    });
+  }
+  // Frame size is known once something has rendered.
+  fseek(f, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, f);
+  fclose(f);
+  printf("Saved %u frames of %u effects to %s.\n", GOLDEN_FRAMES, (unsigned)NUM_EFFECTS, path);
+  return 0;
+}
+
+/**
+ * @brief Compare every effect with saved frames, allowing each channel some difference.
+ *
+ * @param path
+ * @param tolerance most a channel may differ by
+ * @param only effect name, or nullptr for all
+ * @return exit status
+ */
+static int compare(const char* path, uint8_t tolerance, const char* only) {
+  FILE* f = fopen(path, "rb");
+  golden_record_t header;
+  if (f == nullptr || fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "CGF1", 4) != 0) {
+    fprintf(stderr, "Can't read saved frames from %s.\n", path);
+    return 2;
+  }
+  if (header.frames != GOLDEN_FRAMES) {
+    fprintf(stderr, "%s has %u frames per effect, not %u.\n", path, (unsigned)header.frames, GOLDEN_FRAMES);
+    return 2;
+  }
+  std::vector<uint8_t> saved((size_t)header.frames * header.frameBytes);
+  int failed = 0;
+  for (uint32_t e = 0; e < header.effects; e++) {
+    char name[GOLDEN_NAME_BYTES];
+    if (fread(name, sizeof(name), 1, f) != 1 || fread(saved.data(), 1, saved.size(), f) != saved.size()) {
+      fprintf(stderr, "%s is cut short.\n", path);
+      return 2;
+    }
+    name[GOLDEN_NAME_BYTES - 1] = 0;
+    const golden_effect_t* effect = nullptr;
+    for (auto const& candidate : EFFECTS) {
+      if (strcmp(candidate.name, name) == 0) effect = &candidate;
+    }
+    if (effect == nullptr || !selected(*effect, only)) continue;
+    uint8_t worst = 0;
+    uint32_t over = 0;
+    int32_t firstFrame = -1;
+    uint32_t firstByte = 0;
+    bool sized = true;
+    render(*effect, [&](uint16_t frame, const uint8_t* p, uint32_t n) {
+      if (n != header.frameBytes) {
+        sized = false;
+        return;
+      }
+      const uint8_t* s = &saved[(size_t)frame * n];
+      for (uint32_t i = 0; i < n; i++) {
+        uint8_t d = p[i] > s[i] ? p[i] - s[i] : s[i] - p[i];
+        if (d > worst) worst = d;
+        if (d > tolerance) {
+          if (over++ == 0) {
+            firstFrame = frame;
+            firstByte = i;
+          }
+        }
+      }
+    });
+    if (!sized) {
+      printf("%-14s LAYOUT CHANGED, frames are %u bytes\n", name, (unsigned)header.frameBytes);
+      failed++;
+    } else if (over) {
+      // The byte is a channel of a pixel, laid out as the framebuffer.
+      uint32_t pixel = firstByte / 3;
+      printf("%-14s max diff %u  FAILED: %u channels over %u, first in frame %d, lane %u pixel %u\n",
+        name, worst, (unsigned)over, tolerance, (int)firstFrame,
+        (unsigned)(pixel / LAYOUT_LONGEST_STRAND), (unsigned)(pixel % LAYOUT_LONGEST_STRAND));
+      failed++;
+    } else {
+      printf("%-14s max diff %u  ok\n", name, worst);
+    }
+  }
+  fclose(f);
+  return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  const char* golden = "golden.txt";
+  const char* recordPath = nullptr;
+  const char* comparePath = nullptr;
+  const char* only = nullptr;
+  bool update = false;
+  int tolerance = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--golden" && hasValue) {
+      golden = argv[++i];
+    } else if (arg == "--update") {
+      update = true;
+    } else if (arg == "--record" && hasValue) {
+      recordPath = argv[++i];
+    } else if (arg == "--compare" && hasValue) {
+      comparePath = argv[++i];
+    } else if (arg == "--tolerance" && hasValue) {
+      tolerance = atoi(argv[++i]);
+    } else if (arg == "--effect" && hasValue) {
+      only = argv[++i];
+    } else {
+      fprintf(stderr, "Usage: golden [--update | --record file | --compare file [--tolerance n]] [--effect name]\n");
+      return 2;
+    }
+  }
+  if (tolerance < 0 || tolerance > 255) {
+    fprintf(stderr, "Tolerance is per channel, 0-255.\n");
+    return 2;
+  }
+
+  spatialMap.begin();
+  rainbowPalette.hues();
+  rainPalette.ramp(rgb_t{ 2, 160, 255 });
+  whitePalette.whites();
+
+  if (recordPath != nullptr) return record(recordPath);
+  if (comparePath != nullptr) return compare(comparePath, tolerance, only);
+  return checkHashes(golden, update, only);
+}
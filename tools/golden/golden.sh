@@ -0,0 +1,19 @@
+#!/bin/sh
+# Build the golden-frame check with the host's compiler and run it. Arguments are passed on:
+#
+#   tools/golden/golden.sh                    compare every effect with golden.txt
+#   tools/golden/golden.sh --update           rewrite golden.txt, after an intended change
+#   tools/golden/golden.sh --record f.bin     save every frame, before a change
+#   tools/golden/golden.sh --compare f.bin --tolerance 1
+#                                             compare with them after it, a channel at a time
+#
+# Build options are passed in CXXFLAGS, e.g. CXXFLAGS=-DPALETTE_PIXELS, and should match the hashes.
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+src="$here/../../src"
+bin="${TMPDIR:-/tmp}/cryptid-golden"
+${CXX:-g++} -std=gnu++11 -O2 -Wall -Wno-unused-function -Wno-reorder $CXXFLAGS -I"$here/host" -I"$src" \
+  "$here/golden.cpp" "$src/bottle.cpp" "$src/log.cpp" "$src/noise.cpp" "$src/palette.cpp" \
+  "$src/pxl8.cpp" "$src/spatial.cpp" "$src/sweep.cpp" "$src/timeline.cpp" "$src/tween.cpp" \
+  "$src/whitebalance.cpp" "$src/zone.cpp" -o "$bin"
+exec "$bin" --golden "$here/golden.txt" "$@"
@@ -0,0 +1,114 @@
+// Adafruit_NeoPixel's color helpers, as the library computes them, and a pixel buffer.
+#ifndef GOLDEN_NEOPIXEL_H
+#define GOLDEN_NEOPIXEL_H
+
+#include <Arduino.h>
+
+typedef uint16_t neoPixelType;
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_RGB ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel {
+  public:
+    Adafruit_NeoPixel(uint16_t n = 0, int16_t pin = 6, neoPixelType t = NEO_GRB)
+      : pixels((uint8_t*)calloc(n ? n * 3 : 1, 1)), count(n),
+        rOffset((t >> 4) & 0b11), gOffset((t >> 2) & 0b11), bOffset(t & 0b11) {}
+    ~Adafruit_NeoPixel() { free(pixels); }
+    void begin(void) {}
+    void show(void) {}
+    uint8_t* getPixels(void) const { return pixels; }
+    uint16_t numPixels(void) const { return count; }
+
+    // Brightness, pixel access and fill as the library does them, for Pxl8 from before it kept its
+    // own framebuffer: brightness scales pixels as they're set, and rescales those already set.
+    void setBrightness(uint8_t b) {
+      uint8_t newBrightness = b + 1;
+      if (newBrightness == brightness) return;
+      uint8_t oldBrightness = brightness - 1;
+      uint16_t scale;
+      if (oldBrightness == 0) scale = 0;
+      else if (b == 255) scale = 65535 / oldBrightness;
+      else scale = (((uint16_t)newBrightness << 8) - 1) / oldBrightness;
+      for (uint32_t i = 0; i < (uint32_t)count * 3; i++) pixels[i] = (pixels[i] * scale) >> 8;
+      brightness = newBrightness;
+    }
+    void setPixelColor(uint16_t n, uint32_t c) {
+      setPixelColor(n, (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c);
+    }
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+      if (n >= count) return;
+      if (brightness) {
+        r = (r * brightness) >> 8;
+        g = (g * brightness) >> 8;
+        b = (b * brightness) >> 8;
+      }
+      uint8_t* p = &pixels[(uint32_t)n * 3];
+      p[rOffset] = r;
+      p[gOffset] = g;
+      p[bOffset] = b;
+    }
+    uint32_t getPixelColor(uint16_t n) const {
+      if (n >= count) return 0;
+      const uint8_t* p = &pixels[(uint32_t)n * 3];
+      if (brightness) {
+        return (((uint32_t)(p[rOffset] << 8) / brightness) << 16)
+          | (((uint32_t)(p[gOffset] << 8) / brightness) << 8) | ((uint32_t)(p[bOffset] << 8) / brightness);
+      }
+      return (uint32_t)p[rOffset] << 16 | (uint32_t)p[gOffset] << 8 | p[bOffset];
+    }
+    void fill(uint32_t c = 0, uint16_t first = 0, uint16_t n = 0) {
+      uint16_t end = n == 0 || first + n > count ? count : first + n;
+      for (uint16_t i = first; i < end; i++) setPixelColor(i, c);
+    }
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+      return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    }
+    // The library's table is x^2.6.
+    static uint8_t gamma8(uint8_t x) {
+      static uint8_t table[256];
+      static bool built = false;
+      if (!built) {
+        for (int i = 0; i < 256; i++) table[i] = (uint8_t)(pow(i / 255.0, 2.6) * 255 + 0.5);
+        built = true;
+      }
+      return table[x];
+    }
+    static uint32_t gamma32(uint32_t x) {
+      return (uint32_t)gamma8(x >> 16) << 16 | (uint32_t)gamma8(x >> 8) << 8 | gamma8(x);
+    }
+    static uint32_t ColorHSV(uint16_t hue, uint8_t sat = 255, uint8_t val = 255) {
+      uint8_t r, g, b;
+      hue = (hue * 1530L + 32768) / 65536;
+      if (hue < 510) {
+        b = 0;
+        if (hue < 255) { r = 255; g = hue; } else { r = 510 - hue; g = 255; }
+      } else if (hue < 1020) {
+        r = 0;
+        if (hue < 765) { g = 255; b = hue - 510; } else { g = 1020 - hue; b = 255; }
+      } else if (hue < 1530) {
+        g = 0;
+        if (hue < 1275) { r = hue - 1020; b = 255; } else { r = 255; b = 1530 - hue; }
+      } else {
+        r = 255;
+        g = b = 0;
+      }
+      uint32_t v1 = 1 + val;
+      uint16_t s1 = 1 + sat;
+      uint8_t s2 = 255 - sat;
+      return ((((((r * s1) >> 8) + s2) * v1) & 0xff00) << 8) |
+             (((((g * s1) >> 8) + s2) * v1) & 0xff00) |
+             (((((b * s1) >> 8) + s2) * v1) >> 8);
+    }
+
+  protected:
+    uint8_t* pixels;
+    uint16_t count;
+    uint8_t rOffset;
+    uint8_t gOffset;
+    uint8_t bOffset;
+    // 0 is full; otherwise brightness + 1, as the library keeps it.
+    uint8_t brightness = 0;
+};
+
+#endif
@@ -0,0 +1,20 @@
+// Adafruit_SPIFlash with no flash behind it. The store runs on RamStoreBackend on the host.
+#ifndef GOLDEN_SPIFLASH_H
+#define GOLDEN_SPIFLASH_H
+
+#include <Arduino.h>
+
+class Adafruit_FlashTransport_QSPI {};
+
+class Adafruit_SPIFlash {
+  public:
+    Adafruit_SPIFlash(Adafruit_FlashTransport_QSPI*) {}
+    bool begin(void) { return false; }
+    uint32_t size(void) { return 0; }
+    uint32_t readBuffer(uint32_t, uint8_t*, uint32_t) { return 0; }
+    uint32_t writeBuffer(uint32_t, const uint8_t*, uint32_t) { return 0; }
+    bool eraseSector(uint32_t) { return false; }
+    uint8_t readStatus(void) { return 0; }
+};
+
+#endif
@@ -0,0 +1,90 @@
+// Just enough of Arduino to build the effects on a Linux host. See tools/golden/golden.sh.
+#ifndef GOLDEN_ARDUINO_H
+#define GOLDEN_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+// The standard headers the sketch uses, before min() and max() are defined over them.
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define PI 3.1415926535897932384626433832795
+#define A0 14
+// Feather M4 pins that NEOPIXEL_PINS names.
+#define PIN_SERIAL1_RX 1
+#define PIN_SERIAL1_TX 0
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+/**
+ * @brief Arduino's String, as far as older revisions' tables of names use it.
+ */
+class String : public std::string {
+  public:
+    String(void) {}
+    String(const char* s) : std::string(s) {}
+    String(const std::string& s) : std::string(s) {}
+    template<typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    explicit String(T n) : std::string(std::to_string(n)) {}
+};
+#define F(s) (s)
+
+/**
+ * @brief Serial, discarding everything. Logs aren't part of a frame.
+ */
+class HostSerial {
+  public:
+    void begin(long) {}
+    size_t write(const uint8_t*, size_t n) { return n; }
+    int availableForWrite(void) { return 64; }
+    void flush(void) {}
+    template<typename T> size_t print(const T&) { return 0; }
+    template<typename T> size_t println(const T&) { return 0; }
+    size_t println(void) { return 0; }
+    explicit operator bool(void) { return true; }
+};
+extern HostSerial Serial;
+
+/**
+ * @brief Time is injected through FrameContext, so the clock only moves when a tool sets it, for
+ *        effects from before FrameContext. See replay.sh.
+ */
+inline uint32_t& hostMillis(void) {
+  static uint32_t ms = 0;
+  return ms;
+}
+inline uint32_t millis(void) { return hostMillis(); }
+inline uint32_t micros(void) { return hostMillis() * 1000; }
+inline void delay(uint32_t) {}
+
+/**
+ * @brief Arduino's random(), for effects from before RandomStreams, from a seeded generator so
+ *        runs repeat.
+ */
+inline uint32_t& hostRandom(void) {
+  static uint32_t state = 1;
+  return state;
+}
+inline void randomSeed(unsigned long seed) { hostRandom() = seed; }
+inline long random(long howbig) {
+  if (howbig <= 0) return 0;
+  hostRandom() = hostRandom() * 1664525UL + 1013904223UL;
+  return (hostRandom() >> 8) % howbig;
+}
+inline long random(long howsmall, long howbig) {
+  return howsmall >= howbig ? howsmall : random(howbig - howsmall) + howsmall;
+}
+
+#endif
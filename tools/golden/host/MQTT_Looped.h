@@ -0,0 +1,23 @@
+// MQTT_Looped with no network behind it. Messages sent are kept so a host tool can deliver them.
+#ifndef GOLDEN_MQTT_LOOPED_H
+#define GOLDEN_MQTT_LOOPED_H
+
+#include <Arduino.h>
+
+class MQTT_Looped {
+  public:
+    // Last message sent, and how many have been.
+    std::string topic;
+    std::string payload;
+    uint32_t sent = 0;
+
+    void onMqtt(const char*, std::function<void(char*, uint16_t)>) {}
+    void mqttSendMessage(const char* t, const char* p, bool /*retain*/ = false) {
+      topic = t;
+      payload = p;
+      sent++;
+    }
+    bool mqttIsConnected(void) { return true; }
+};
+
+#endif
@@ -0,0 +1,62 @@
+// WiFiNINA with no radio behind it: always connected, and UDP packets are queued by port in memory
+// so a host tool can send them.
+#ifndef GOLDEN_WIFININA_H
+#define GOLDEN_WIFININA_H
+
+#include <Arduino.h>
+
+#define WL_CONNECTED 3
+
+class WiFiUDP {
+  public:
+    /**
+     * @brief Packets waiting on a port, oldest first.
+     *
+     * @param port
+     * @return queue
+     */
+    static std::vector<std::vector<uint8_t>>& queue(uint16_t port) {
+      static std::map<uint16_t, std::vector<std::vector<uint8_t>>> queues;
+      return queues[port];
+    }
+
+    uint8_t begin(uint16_t p) {
+      port = p;
+      return 1;
+    }
+
+    void stop(void) {
+      queue(port).clear();
+      port = 0;
+      parsed = false;
+    }
+
+    // Any of the last packet left unread is discarded.
+    int parsePacket(void) {
+      if (parsed) queue(port).erase(queue(port).begin());
+      parsed = port != 0 && !queue(port).empty();
+      return parsed ? queue(port).front().size() : 0;
+    }
+
+    int read(uint8_t* buf, size_t len) {
+      if (!parsed) return 0;
+      std::vector<uint8_t>& packet = queue(port).front();
+      len = min(len, packet.size());
+      memcpy(buf, packet.data(), len);
+      queue(port).erase(queue(port).begin());
+      parsed = false;
+      return len;
+    }
+
+  private:
+    uint16_t port = 0;
+    bool parsed = false;
+};
+
+class WiFiClass {
+  public:
+    uint8_t status(void) { return WL_CONNECTED; }
+};
+extern WiFiClass WiFi;
+
+#endif
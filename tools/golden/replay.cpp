@@ -0,0 +1,329 @@
+/**
+ * @brief Golden frames for an older revision of the effects, so a change can be compared with the
+ *        renderer from before it. Only uses what every revision since the frame hash has: Bottle,
+ *        Pxl8, and the four example bottles. Built by replay.sh with a flag for each part a
+ *        revision has, since their APIs moved:
+ *
+ *   HAS_FRAME    effects take a FrameContext and draw from its Random, rather than millis() and
+ *                random()
+ *   HAS_TWEENS   fades run in a TweenPool
+ *   HAS_PALETTE  rain and rainbow draw from a palette Pxl8 holds
+ *
+ *   replay --record frames.bin              save every frame
+ *   replay --compare frames.bin [--tolerance n]
+ *                                           compare with saved frames, allowing each channel to
+ *                                           differ by n
+ */
+#include <string>
+#include <vector>
+#include "bottle.h"
+#ifdef HAS_PALETTE
+#include "palette.h"
+#endif
+
+HostSerial Serial;
+
+/**
+ * @brief Frames rendered per effect and the time between them in ms, as golden.cpp, from a start
+ *        time away from zero.
+ */
+static const uint16_t REPLAY_FRAMES = 240;
+static const uint32_t REPLAY_FRAME_MS = 17;
+static const uint32_t REPLAY_START_MS = 1000;
+
+/**
+ * @brief Frame a hue or color fade starts on, and its length in ms.
+ */
+static const uint16_t REPLAY_FADE_FRAME = 60;
+static const uint32_t REPLAY_FADE_MS = 1500;
+
+static const uint32_t REPLAY_SEED = 0xC0FFEE;
+
+/**
+ * @brief The example layout, as every revision has it.
+ */
+static const struct {
+  uint8_t pin;
+  uint16_t start;
+  uint16_t length;
+} REPLAY_BOTTLES[] = { { 0, 0, 25 }, { 0, 25, 25 }, { 1, 0, 20 }, { 1, 20, 30 } };
+
+#ifdef HAS_FRAME
+#define CTX run.frame
+#define CTX_ run.frame,
+#else
+#define CTX
+#define CTX_
+#endif
+
+/**
+ * @brief Everything an effect draws with, made new for each effect.
+ */
+class Run {
+  public:
+    Pxl8 pxl8;
+#ifdef HAS_TWEENS
+    TweenPool tweens;
+#endif
+#ifdef HAS_FRAME
+    Random random;
+    FrameContext frame;
+#endif
+    std::vector<Bottle*> bottles;
+
+#if defined(HAS_TWEENS)
+    Run(void) : random(REPLAY_SEED), frame(&random, &tweens) {
+#elif defined(HAS_FRAME)
+    Run(void) : random(REPLAY_SEED), frame(&random) {
+#else
+    Run(void) {
+#endif
+      randomSeed(REPLAY_SEED);
+      for (auto const& b : REPLAY_BOTTLES) {
+        bottles.push_back(new Bottle(&pxl8, b.pin, b.start, b.length));
+      }
+      pxl8.init();
+      for (size_t i = 0; i < bottles.size(); i++) {
+        bottles[i]->setHue(i * 90, i * 90 + 35);
+        bottles[i]->setColor(rgb_t{ 255, 180, (uint8_t)(100 + i * 20) });
+      }
+    }
+
+    ~Run() {
+      for (auto & bottle : bottles) {
+        delete bottle;
+      }
+    }
+
+    /**
+     * @brief Move time on to a frame.
+     *
+     * @param ms
+     */
+    void advance(uint32_t ms) {
+      hostMillis() = ms;
+#ifdef HAS_FRAME
+      frame.advance(ms);
+#endif
+#ifdef HAS_TWEENS
+      tweens.update(ms);
+#endif
+    }
+};
+
+/**
+ * @brief One effect: what it draws each frame, and whether from the rain or rainbow palette.
+ */
+typedef struct {
+  const char* name;
+  uint8_t palette;
+  void (*render)(Run& run, uint16_t f);
+} replay_effect_t;
+
+#ifdef HAS_PALETTE
+static Palette palettes[3];
+#endif
+
+/**
+ * @brief Fade every bottle's hue on REPLAY_FADE_FRAME.
+ *
+ * @param run
+ * @param f frame
+ */
+static void fadeHue(Run& run, uint16_t f) {
+  if (f != REPLAY_FADE_FRAME) return;
+  for (size_t i = 0; i < run.bottles.size(); i++) {
+    run.bottles[i]->setHue(CTX_ i * 90 + 120, i * 90 + 160, REPLAY_FADE_MS);
+  }
+}
+
+static const replay_effect_t EFFECTS[] = {
+  { "glow", 0, [](Run& run, uint16_t f) {
+    fadeHue(run, f);
+    for (auto & b : run.bottles) b->glow(CTX);
+  } },
+  { "glow-sawtooth", 0, [](Run& run, uint16_t f) {
+    fadeHue(run, f);
+    for (auto & b : run.bottles) b->glow(CTX_ 1.25, 1, SAWTOOTH);
+  } },
+  { "glow-color", 0, [](Run& run, uint16_t f) {
+    if (f == REPLAY_FADE_FRAME) {
+      for (auto & b : run.bottles) b->setColor(CTX_ rgb_t{ 120, 200, 255 }, REPLAY_FADE_MS);
+    }
+    for (auto & b : run.bottles) b->glowColor(CTX);
+  } },
+  { "rain", 1, [](Run& run, uint16_t) {
+    for (auto & b : run.bottles) b->rain(CTX);
+  } },
+  { "rainbow", 2, [](Run& run, uint16_t) {
+    for (auto & b : run.bottles) b->rainbow(CTX);
+  } },
+  { "warning", 0, [](Run& run, uint16_t) {
+    for (auto & b : run.bottles) b->warning(CTX);
+  } },
+  { "test-blink", 0, [](Run& run, uint16_t) {
+    for (auto & b : run.bottles) b->testBlink(CTX);
+  } },
+  { "illuminate", 0, [](Run& run, uint16_t) {
+    for (auto & b : run.bottles) b->illuminate(rgb_t{ 255, 120, 30 });
+  } },
+};
+
+/**
+ * @brief Render an effect, handing on what the driver would send after each frame.
+ *
+ * @param effect
+ * @param onFrame called with the frame number, the driver's pixels, and their size
+ */
+template<typename F>
+static void render(const replay_effect_t& effect, F onFrame) {
+  Run* run = new Run();
+  for (uint16_t f = 0; f < REPLAY_FRAMES; f++) {
+    run->advance(REPLAY_START_MS + f * REPLAY_FRAME_MS);
+#ifdef HAS_PALETTE
+    run->pxl8.setPalette(effect.palette ? &palettes[effect.palette] : nullptr);
+#endif
+    effect.render(*run, f);
+    run->pxl8.show();
+    Adafruit_NeoPXL8* driver = Adafruit_NeoPXL8::last();
+    onFrame(f, driver->getPixels(), (uint32_t)driver->numPixels() * 3);
+  }
+  delete run;
+}
+
+/**
+ * @brief Header of a file of saved frames. Each effect follows as its name, NUL padded to 32
+ *        bytes, then REPLAY_FRAMES frames of frameBytes each.
+ */
+typedef struct {
+  char magic[4];
+  uint32_t effects;
+  uint32_t frames;
+  uint32_t frameBytes;
+} replay_record_t;
+
+static const size_t REPLAY_NAME_BYTES = 32;
+
+/**
+ * @brief Save every frame of every effect.
+ *
+ * @param path
+ * @return exit status
+ */
+static int record(const char* path) {
+  FILE* f = fopen(path, "wb");
+  if (f == nullptr) {
+    fprintf(stderr, "Can't write %s.\n", path);
+    return 2;
+  }
+  replay_record_t header = { { 'C', 'R', 'P', '1' }, (uint32_t)(sizeof(EFFECTS) / sizeof(EFFECTS[0])),
+    REPLAY_FRAMES, 0 };
+  fwrite(&header, sizeof(header), 1, f);
+  for (auto const& effect : EFFECTS) {
+    char name[REPLAY_NAME_BYTES] = {};
+    strncpy(name, effect.name, REPLAY_NAME_BYTES - 1);
+    fwrite(name, sizeof(name), 1, f);
+    render(effect, [&](uint16_t, const uint8_t* p, uint32_t n) {
+      header.frameBytes = n;
+      fwrite(p, 1, n, f);
+    });
+  }
+  fseek(f, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, f);
+  fclose(f);
+  return 0;
+}
+
+/**
+ * @brief Compare every effect with saved frames, allowing each channel some difference.
+ *
+ * @param path
+ * @param tolerance most a channel may differ by
+ * @return exit status
+ */
+static int compare(const char* path, uint8_t tolerance) {
+  FILE* f = fopen(path, "rb");
+  replay_record_t header;
+  if (f == nullptr || fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, "CRP1", 4) != 0
+      || header.frames != REPLAY_FRAMES) {
+    fprintf(stderr, "Can't read saved frames from %s.\n", path);
+    return 2;
+  }
+  std::vector<uint8_t> saved((size_t)header.frames * header.frameBytes);
+  int failed = 0;
+  for (uint32_t e = 0; e < header.effects; e++) {
+    char name[REPLAY_NAME_BYTES];
+    if (fread(name, sizeof(name), 1, f) != 1 || fread(saved.data(), 1, saved.size(), f) != saved.size()) {
+      fprintf(stderr, "%s is cut short.\n", path);
+      return 2;
+    }
+    name[REPLAY_NAME_BYTES - 1] = 0;
+    const replay_effect_t* effect = nullptr;
+    for (auto const& candidate : EFFECTS) {
+      if (strcmp(candidate.name, name) == 0) effect = &candidate;
+    }
+    if (effect == nullptr) continue;
+    uint8_t worst = 0;
+    uint32_t over = 0;
+    uint32_t channels = 0;
+    int32_t first = -1;
+    int32_t last = -1;
+    render(*effect, [&](uint16_t frame, const uint8_t* p, uint32_t n) {
+      const uint8_t* s = &saved[(size_t)frame * header.frameBytes];
+      for (uint32_t i = 0; i < min(n, header.frameBytes); i++) {
+        uint8_t d = p[i] > s[i] ? p[i] - s[i] : s[i] - p[i];
+        if (d > worst) worst = d;
+        if (d > tolerance) {
+          if (first < 0) first = frame;
+          last = frame;
+          over++;
+        }
+        channels++;
+      }
+    });
+    printf("  %-14s max diff %3u, %6u of %u channels over %u", name, worst, (unsigned)over,
+      (unsigned)channels, tolerance);
+    if (over) {
+      printf(", frames %d-%d  CHANGED\n", (int)first, (int)last);
+    } else {
+      printf("  ok\n");
+    }
+    if (over) failed++;
+  }
+  fclose(f);
+  return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  const char* recordPath = nullptr;
+  const char* comparePath = nullptr;
+  int tolerance = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--record" && hasValue) {
+      recordPath = argv[++i];
+    } else if (arg == "--compare" && hasValue) {
+      comparePath = argv[++i];
+    } else if (arg == "--tolerance" && hasValue) {
+      tolerance = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "Usage: replay --record file | --compare file [--tolerance n]\n");
+      return 2;
+    }
+  }
+  if (tolerance < 0 || tolerance > 255) {
+    fprintf(stderr, "Tolerance is per channel, 0-255.\n");
+    return 2;
+  }
+
+#ifdef HAS_PALETTE
+  palettes[1].ramp(rgb_t{ 2, 160, 255 });
+  palettes[2].hues();
+#endif
+
+  if (recordPath != nullptr) return record(recordPath);
+  if (comparePath != nullptr) return compare(comparePath, tolerance);
+  fprintf(stderr, "Usage: replay --record file | --compare file [--tolerance n]\n");
+  return 2;
+}
@@ -0,0 +1,56 @@
+#!/bin/sh
+# Replay the effects across each optimization: frames are recorded from the renderer before the
+# commit, then compared with the commit's, a channel at a time. replay.cpp only draws through the
+# API every revision has, so it builds against each one. Arguments are the tolerance and, optionally,
+# the commits to check, by request id:
+#
+#   tools/golden/replay.sh                    tolerance 1, over every optimization
+#   tools/golden/replay.sh 2 user-043         tolerance 2, over one
+#
+# Effects listed as CHANGED differ by more than the tolerance. With no arguments the report is
+# compared with replay.txt, which holds the intended changes, explained in README.md.
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+repo=$(cd "$here/../.." && pwd)
+args=$#
+tolerance=${1:-1}
+[ $# -gt 0 ] && shift
+requests=${*:-user-028 user-029 user-043 user-044 user-045 user-046}
+work=$(mktemp -d "${TMPDIR:-/tmp}/cryptid-replay.XXXXXX")
+trap 'rm -rf "$work"; git -C "$repo" worktree prune' EXIT
+
+# Build the harness against a revision checked out at $1, into $2.
+build() {
+  flags=""
+  [ -f "$1/src/frame.h" ] && flags="$flags -DHAS_FRAME"
+  [ -f "$1/src/tween.h" ] && flags="$flags -DHAS_TWEENS"
+  [ -f "$1/src/palette.h" ] && flags="$flags -DHAS_PALETTE"
+  sources=""
+  for f in bottle log noise palette pxl8 spatial sweep timeline tween whitebalance zone; do
+    [ -f "$1/src/$f.cpp" ] && sources="$sources $1/src/$f.cpp"
+  done
+  ${CXX:-g++} -std=gnu++11 -O2 -w $CXXFLAGS $flags -I"$here/host" -I"$1/src" "$here/replay.cpp" \
+    $sources -o "$2"
+}
+
+for request in $requests; do
+  rev=$(git -C "$repo" log --format=%h --grep="^\[$request\] " | tail -1)
+  if [ -z "$rev" ]; then
+    echo "No commit for $request."
+    exit 2
+  fi
+  for side in before after; do
+    [ $side = before ] && at="$rev^" || at="$rev"
+    git -C "$repo" worktree add --detach --quiet "$work/tree-$side" "$at"
+    build "$work/tree-$side" "$work/replay-$side"
+    git -C "$repo" worktree remove --force "$work/tree-$side"
+  done
+  echo "$request ($rev), tolerance $tolerance:" >> "$work/report"
+  "$work/replay-before" --record "$work/frames.bin"
+  "$work/replay-after" --compare "$work/frames.bin" --tolerance "$tolerance" >> "$work/report" || true
+done
+cat "$work/report"
+if [ $args -eq 0 ]; then
+  diff -u "$here/replay.txt" "$work/report" > "$work/diff" || { cat "$work/diff"; exit 1; }
+  echo "ok"
+fi
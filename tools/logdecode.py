@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Decode binary log records from the bottles' USB serial port into text.
+
+Usage:
+  tools/logdecode.py /dev/ttyACM0     (needs pyserial)
+  tools/logdecode.py capture.bin
+  cat capture.bin | tools/logdecode.py -
+"""
+
+import os
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+RECORD = struct.Struct("<BBIII")
+LEVELS = {"ERROR": "E", "WARN": "W", "INFO": "I", "DEBUG": "D"}
+
+
+def load_formats():
+    """Read the message table from src/log.h. Ids are positions in the table."""
+    path = os.path.join(os.path.dirname(__file__), "..", "src", "log.h")
+    with open(path) as f:
+        entries = re.findall(r'X\((\w+), (\w+), "((?:[^"\\]|\\.)*)"\)', f.read())
+    return [(name, LEVELS.get(level, "?"), fmt) for name, level, fmt in entries]
+
+
+def format_message(fmt, args):
+    args = list(args)
+
+    def arg(match):
+        value = args.pop(0) if args else 0
+        spec = match.group(1)
+        if spec == "d":
+            return str(value - (1 << 32) if value & 0x80000000 else value)
+        if spec == "x":
+            return "%X" % value
+        if spec == "s":
+            return value.to_bytes(4, "little").rstrip(b"\0").decode("ascii", "replace")
+        return str(value)
+
+    return re.sub(r"%([udxs])", arg, fmt)
+
+
+def decode(stream, formats):
+    buf = b""
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            return
+        buf += chunk
+        while len(buf) >= RECORD.size:
+            # Resync on a corrupt or partial record.
+            if buf[0] != SYNC or buf[1] >= len(formats):
+                buf = buf[1:]
+                continue
+            _, id, time, a, b = RECORD.unpack_from(buf)
+            buf = buf[RECORD.size:]
+            name, level, fmt = formats[id]
+            print("%10.3f %s %s" % (time / 1000, level, format_message(fmt, (a, b))), flush=True)
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__.strip(), file=sys.stderr)
+        sys.exit(1)
+    source = sys.argv[1]
+    formats = load_formats()
+    if source == "-":
+        decode(sys.stdin.buffer, formats)
+    elif source.startswith("/dev/") or source.upper().startswith("COM"):
+        import serial
+        decode(serial.Serial(source, 9600, timeout=None), formats)
+    else:
+        with open(source, "rb") as f:
+            decode(f, formats)
+
+
+if __name__ == "__main__":
+    main()
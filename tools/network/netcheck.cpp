@@ -0,0 +1,236 @@
+/**
+ * @brief Check the Network effect on a Linux host: DDP and E1.31 packets, built as tools/sender.py
+ *        sends them, are queued on an in-memory socket, and the frames shown, the jitter buffer's
+ *        holds and drops, and lost packet counts are checked. See netcheck.sh.
+ */
+#include "network.h"
+
+HostSerial Serial;
+WiFiClass WiFi;
+
+typedef std::vector<uint8_t> packet_t;
+
+/**
+ * @brief Failures so far.
+ */
+static uint32_t failures = 0;
+
+/**
+ * @brief Count and report a failed check.
+ *
+ * @param ok
+ * @param what
+ */
+static void expect(bool ok, const char* what) {
+  if (ok) return;
+  printf("FAILED: %s\n", what);
+  failures++;
+}
+
+/**
+ * @brief A frame of pixels in bottle order, every pixel a color from the seed.
+ *
+ * @param seed
+ * @return RGB bytes
+ */
+static packet_t pattern(uint8_t seed) {
+  packet_t rgb(LAYOUT_PIXELS * 3);
+  for (uint32_t i = 0; i < rgb.size(); i++) rgb[i] = seed + i * 7;
+  return rgb;
+}
+
+/**
+ * @brief A DDP packet.
+ *
+ * @param sequence 1-15, or 0 for none
+ * @param offset byte offset into the frame
+ * @param data RGB bytes
+ * @param push whether it completes a frame
+ * @return packet
+ */
+static packet_t ddpPacket(uint8_t sequence, uint32_t offset, const packet_t& data, bool push) {
+  packet_t p = { (uint8_t)(0x40 | (push ? 0x01 : 0)), sequence, 0x0B, 1,
+    (uint8_t)(offset >> 24), (uint8_t)(offset >> 16), (uint8_t)(offset >> 8), (uint8_t)offset,
+    (uint8_t)(data.size() >> 8), (uint8_t)data.size() };
+  p.insert(p.end(), data.begin(), data.end());
+  return p;
+}
+
+/**
+ * @brief An E1.31 data packet.
+ *
+ * @param universe
+ * @param sequence
+ * @param data up to 512 channels
+ * @param options 0x80 for preview data
+ * @return packet
+ */
+static packet_t e131Packet(uint16_t universe, uint8_t sequence, const packet_t& data, uint8_t options = 0) {
+  packet_t p(126, 0);
+  uint16_t channels = data.size() + 1;
+  p[1] = 0x10;
+  memcpy(&p[4], "ASC-E1.17\0\0\0", 12);
+  p[16] = 0x70 | (uint8_t)((110 + channels) >> 8);
+  p[17] = (uint8_t)(110 + channels);
+  p[21] = 0x04;
+  p[38] = 0x70 | (uint8_t)((88 + channels) >> 8);
+  p[39] = (uint8_t)(88 + channels);
+  p[43] = 0x02;
+  memcpy(&p[44], "netcheck", 8);
+  p[108] = 100;
+  p[111] = sequence;
+  p[112] = options;
+  p[113] = universe >> 8;
+  p[114] = universe;
+  p[115] = 0x70 | (uint8_t)((11 + channels) >> 8);
+  p[116] = (uint8_t)(11 + channels);
+  p[117] = 0x02;
+  p[118] = 0xA1;
+  p[122] = 1;
+  p[123] = channels >> 8;
+  p[124] = channels;
+  p.insert(p.end(), data.begin(), data.end());
+  return p;
+}
+
+/**
+ * @brief Send a packet to the effect's socket.
+ *
+ * @param port
+ * @param p
+ */
+static void send(uint16_t port, const packet_t& p) {
+  WiFiUDP::queue(port).push_back(p);
+}
+
+/**
+ * @brief Bottles as setup() adds them, and the effect over them.
+ */
+class Run {
+  public:
+    Pxl8 pxl8;
+    TweenPool tweens;
+    RandomStreams streams;
+    FrameContext frame;
+    std::vector<Bottle*> bottles;
+    NetworkPixels network;
+
+    Run(void) : frame(&streams.get(RANDOM_FRAME), &tweens), network(&pxl8, &bottles) {
+      for (size_t i = 0; i < LAYOUT_BOTTLES; i++) {
+        const bottle_layout_t& b = BOTTLE_LAYOUT[i];
+        bottles.push_back(new Bottle(&pxl8, b.pin, b.start, b.length, i));
+      }
+      pxl8.init();
+    }
+
+    ~Run() {
+      network.end();
+      for (auto & bottle : bottles) {
+        delete bottle;
+      }
+    }
+
+    /**
+     * @brief Render a frame.
+     *
+     * @param ms frame time
+     */
+    void render(uint32_t ms) {
+      frame.advance(ms);
+      network.render(frame);
+    }
+
+    /**
+     * @brief Whether the framebuffer shows a frame of pixels.
+     *
+     * @param rgb in bottle order
+     * @return bool
+     */
+    bool shows(const packet_t& rgb) {
+      uint32_t i = 0;
+      for (auto & bottle : bottles) {
+        for (uint16_t n = 0; n < bottle->getLength(); n++, i += 3) {
+          uint32_t c = (uint32_t)rgb[i] << 16 | (uint32_t)rgb[i + 1] << 8 | rgb[i + 2];
+          if (pxl8.getPixel(bottle->getPin(), bottle->getStartPixel() + n) != c) return false;
+        }
+      }
+      return true;
+    }
+};
+
+int main(void) {
+  static_assert(LAYOUT_PIXELS * 3 <= 510, "The E1.31 checks send the layout in one universe");
+
+  // DDP, split over two packets; held NETWORK_JITTER_MS, then shown.
+  {
+    Run run;
+    run.render(0);
+    packet_t a = pattern(1);
+    uint32_t half = a.size() / 2;
+    send(NETWORK_DDP_PORT, ddpPacket(1, 0, packet_t(a.begin(), a.begin() + half), false));
+    send(NETWORK_DDP_PORT, ddpPacket(2, half, packet_t(a.begin() + half, a.end()), true));
+    run.render(100);
+    run.render(100 + NETWORK_JITTER_MS - 1);
+    expect(!run.shows(a), "DDP frame held for the jitter buffer");
+    run.render(100 + NETWORK_JITTER_MS);
+    expect(run.shows(a), "DDP frame shown");
+    expect(run.network.latency == NETWORK_JITTER_MS, "latency is the hold");
+    expect(run.network.packetsLost == 0, "no DDP packets lost");
+
+    // A gap in sequence numbers, wrapping past 15.
+    packet_t b = pattern(2);
+    send(NETWORK_DDP_PORT, ddpPacket(5, 0, b, true));
+    send(NETWORK_DDP_PORT, ddpPacket(1, 0, b, true));
+    run.render(200);
+    expect(run.network.packetsLost == 2 + 10, "DDP sequence gaps counted");
+
+    // Queries, and packets for status or config ids, aren't pixels.
+    packet_t c = pattern(3);
+    packet_t query = ddpPacket(0, 0, c, true);
+    query[0] |= 0x02;
+    packet_t status = ddpPacket(0, 0, c, true);
+    status[3] = 251;
+    send(NETWORK_DDP_PORT, query);
+    send(NETWORK_DDP_PORT, status);
+    run.render(300);
+    run.render(300 + NETWORK_JITTER_MS);
+    expect(run.shows(b), "DDP queries and status ignored");
+  }
+
+  // More complete frames than the jitter buffer holds: the oldest go, and the newest is shown.
+  {
+    Run run;
+    run.render(0);
+    uint32_t frames = NETWORK_JITTER_FRAMES + 2;
+    for (uint32_t i = 0; i < frames; i++) {
+      send(NETWORK_DDP_PORT, ddpPacket(0, 0, pattern(10 + i), true));
+    }
+    run.render(100);
+    run.render(100 + NETWORK_JITTER_MS);
+    expect(run.shows(pattern(10 + frames - 1)), "newest frame shown after a burst");
+    expect(run.network.framesDropped == frames - 1, "burst frames dropped");
+  }
+
+  // E1.31: one universe completes the frame; gaps count, and late or preview packets are dropped.
+  {
+    Run run;
+    run.render(0);
+    packet_t a = pattern(20);
+    send(NETWORK_E131_PORT, e131Packet(NETWORK_E131_UNIVERSE, 10, a));
+    run.render(100);
+    run.render(100 + NETWORK_JITTER_MS);
+    expect(run.shows(a), "E1.31 frame shown");
+
+    send(NETWORK_E131_PORT, e131Packet(NETWORK_E131_UNIVERSE, 13, a));
+    send(NETWORK_E131_PORT, e131Packet(NETWORK_E131_UNIVERSE, 12, pattern(21)));
+    send(NETWORK_E131_PORT, e131Packet(NETWORK_E131_UNIVERSE, 14, pattern(22), 0x80));
+    send(NETWORK_E131_PORT, e131Packet(NETWORK_E131_UNIVERSE + NETWORK_E131_UNIVERSES, 15, pattern(23)));
+    run.render(200);
+    run.render(200 + NETWORK_JITTER_MS);
+    expect(run.network.packetsLost == 2, "E1.31 sequence gap counted");
+    expect(run.shows(a), "late, preview and other universes' packets ignored");
+  }
+
+  printf(failures ? "%u checks failed.\n" : "ok\n", (unsigned)failures);
+  return failures ? 1 : 0;
+}
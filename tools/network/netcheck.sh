@@ -0,0 +1,12 @@
+#!/bin/sh
+# Build the Network effect check with the host's compiler and run it, with packets sent in memory.
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+src="$here/../../src"
+bin="${TMPDIR:-/tmp}/cryptid-netcheck"
+${CXX:-g++} -std=gnu++11 -O2 -Wall -Wno-unused-function -Wno-reorder $CXXFLAGS -DNETWORK_PIXELS \
+  -I"$here/../golden/host" -I"$src" \
+  "$here/netcheck.cpp" "$src/network.cpp" "$src/bottle.cpp" "$src/log.cpp" "$src/noise.cpp" \
+  "$src/palette.cpp" "$src/pxl8.cpp" "$src/spatial.cpp" "$src/timeline.cpp" "$src/tween.cpp" \
+  "$src/whitebalance.cpp" "$src/zone.cpp" -o "$bin"
+exec "$bin"
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""Send a moving rainbow to the Network effect over DDP or E1.31, as a show controller would.
+
+Build with NETWORK_PIXELS defined in src/def.h and select the Network effect, then:
+
+  tools/sender.py board [ddp|e131] [pixels] [loss] [jitter] [seconds]
+
+Pixels defaults to the 100 in the example layout. Loss is the fraction of packets to skip, with
+their sequence numbers still used, so the board should count them in `net_packets_lost`. Jitter
+is the most each frame is sent late, in ms, which the board's jitter buffer should absorb; its
+`net_latency` shows how long frames wait to be shown. tools/network/netcheck.sh checks the board's
+side of this on the host.
+"""
+
+import colorsys
+import random
+import socket
+import struct
+import sys
+import time
+
+DDP_PORT = 4048
+E131_PORT = 5568
+E131_UNIVERSE = 1
+FPS = 40
+# Bytes of pixels per DDP packet, and per E1.31 universe.
+DDP_CHUNK = 1440
+UNIVERSE_BYTES = 510
+
+
+def rainbow(pixels, t):
+    """One frame of RGB bytes, the hues moving along the pixels."""
+    out = bytearray()
+    for i in range(pixels):
+        r, g, b = colorsys.hsv_to_rgb((i / pixels + t / 4) % 1, 1, 1)
+        out += bytes((int(r * 255), int(g * 255), int(b * 255)))
+    return out
+
+
+def ddp_packets(frame, sequence):
+    """A frame as DDP packets; the last pushes it."""
+    packets = []
+    for offset in range(0, len(frame), DDP_CHUNK):
+        data = frame[offset:offset + DDP_CHUNK]
+        push = offset + DDP_CHUNK >= len(frame)
+        sequence = sequence % 15 + 1
+        header = struct.pack(">BBBBIH", 0x40 | push, sequence, 0x0B, 1, offset, len(data))
+        packets.append(header + data)
+    return packets, sequence
+
+
+def e131_packet(universe, sequence, data):
+    """An E1.31 data packet for one universe."""
+    channels = len(data) + 1
+    root = struct.pack(">HH12sHI16s", 0x0010, 0, b"ASC-E1.17\0\0\0", 0x7000 | (110 + channels), 4,
+                       b"cryptid-sender\0\0")
+    framing = struct.pack(">HI64sBHBBH", 0x7000 | (88 + channels), 2, b"cryptid-sender", 100, 0,
+                          sequence, 0, universe)
+    dmp = struct.pack(">HBBHHHB", 0x7000 | (11 + channels), 2, 0xA1, 0, 1, channels, 0)
+    return root + framing + dmp + data
+
+
+def e131_packets(frame, sequences):
+    """A frame as E1.31 packets, one per universe; the universe with the last pixel completes it."""
+    packets = []
+    for u, offset in enumerate(range(0, len(frame), UNIVERSE_BYTES)):
+        sequences[u] = (sequences.get(u, 0) + 1) % 256
+        packets.append(e131_packet(E131_UNIVERSE + u, sequences[u], frame[offset:offset + UNIVERSE_BYTES]))
+    return packets
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    board = sys.argv[1]
+    protocol = sys.argv[2] if len(sys.argv) > 2 else "ddp"
+    pixels = int(sys.argv[3]) if len(sys.argv) > 3 else 100
+    loss = float(sys.argv[4]) if len(sys.argv) > 4 else 0
+    jitter = float(sys.argv[5]) if len(sys.argv) > 5 else 0
+    seconds = float(sys.argv[6]) if len(sys.argv) > 6 else 10
+    if protocol not in ("ddp", "e131"):
+        sys.exit("Protocol is ddp or e131.")
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    port = DDP_PORT if protocol == "ddp" else E131_PORT
+    ddp_sequence = 0
+    e131_sequences = {}
+    sent = skipped = frames = 0
+    start = time.time()
+    while time.time() - start < seconds:
+        due = start + frames / FPS
+        time.sleep(max(0, due - time.time()) + random.uniform(0, jitter) / 1000)
+        frame = rainbow(pixels, time.time() - start)
+        if protocol == "ddp":
+            packets, ddp_sequence = ddp_packets(frame, ddp_sequence)
+        else:
+            packets = e131_packets(frame, e131_sequences)
+        for packet in packets:
+            if random.random() < loss:
+                skipped += 1
+                continue
+            sock.sendto(packet, (board, port))
+            sent += 1
+        frames += 1
+
+    print("%d frames at %d fps over %s: %d packets sent, %d skipped" % (
+        frames, FPS, protocol.upper(), sent, skipped))
+
+
+if __name__ == "__main__":
+    main()
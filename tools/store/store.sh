@@ -0,0 +1,9 @@
+#!/bin/sh
+# Build the state store check with the host's compiler and run it, on RAM in place of QSPI flash.
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+src="$here/../../src"
+bin="${TMPDIR:-/tmp}/cryptid-storecheck"
+${CXX:-g++} -std=gnu++11 -O2 -Wall $CXXFLAGS -I"$here/../golden/host" -I"$src" \
+  "$here/storecheck.cpp" "$src/store.cpp" -o "$bin"
+exec "$bin"
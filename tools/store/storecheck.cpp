@@ -0,0 +1,196 @@
+/**
+ * @brief Check the state store on a Linux host, on RAM standing in for the QSPI flash: values
+ *        survive restarts, erases are spread over the sectors and done ahead of time rather than
+ *        when writing, nothing waits on a running erase, a torn write loses only the value being
+ *        written, and unsettled changes aren't written. See store.sh.
+ */
+#include "store.h"
+
+HostSerial Serial;
+
+/**
+ * @brief Restarts to simulate, each setting a few values.
+ */
+static const uint16_t CHECK_RESTARTS = 3000;
+
+/**
+ * @brief RAM storage that counts writes and erases, can tear a write, and stays busy for a few
+ *        calls after an erase, as flash does.
+ */
+class CheckBackend : public RamStoreBackend {
+  public:
+    uint8_t bytes[STORE_SECTORS * STORE_SECTOR_SIZE];
+    uint32_t erases[STORE_SECTORS] = {};
+    uint32_t writes = 0;
+    // Write to tear: only its first byte is written, and it fails.
+    int32_t tearAt = -1;
+    // Calls to busy() left that report an erase running.
+    uint8_t busyFor = 0;
+
+    CheckBackend(void) : RamStoreBackend(bytes, sizeof(bytes)) {
+      // Flash that has never been erased holds anything.
+      memset(bytes, 0x5C, sizeof(bytes));
+    }
+
+    bool write(uint32_t addr, const void* buf, uint32_t len) override {
+      if ((int32_t)writes++ == tearAt) {
+        RamStoreBackend::write(addr, buf, 1);
+        return false;
+      }
+      return RamStoreBackend::write(addr, buf, len);
+    }
+
+    bool erase(uint32_t addr) override {
+      erases[addr / STORE_SECTOR_SIZE]++;
+      busyFor = 2;
+      return RamStoreBackend::erase(addr);
+    }
+
+    bool busy(void) override {
+      if (!busyFor) return false;
+      busyFor--;
+      return true;
+    }
+
+    uint32_t totalErases(void) {
+      uint32_t total = 0;
+      for (auto e : erases) total += e;
+      return total;
+    }
+};
+
+/**
+ * @brief Failures so far.
+ */
+static uint32_t failures = 0;
+
+/**
+ * @brief Count and report a failed check.
+ *
+ * @param ok
+ * @param what
+ * @param n restart, or key
+ */
+static void expect(bool ok, const char* what, uint32_t n = 0) {
+  if (ok) return;
+  printf("FAILED: %s (%u)\n", what, (unsigned)n);
+  failures++;
+}
+
+/**
+ * @brief Run the store's loop, checking it never erases in a loop that writes: a sector moved to
+ *        should have been erased ahead of time.
+ *
+ * @param store
+ * @param flash
+ * @param now ms
+ * @param n restart
+ */
+static void loopStore(StateStore& store, CheckBackend& flash, uint32_t now, uint32_t n) {
+  uint32_t writes = flash.writes;
+  uint32_t erases = flash.totalErases();
+  store.loop(now);
+  expect(flash.writes == writes || flash.totalErases() == erases, "no erase while writing", n);
+}
+
+int main(void) {
+  static CheckBackend flash;
+  uint32_t now = 0;
+  uint32_t v;
+  {
+    StateStore store(&flash);
+    expect(store.begin(), "starts on unerased flash");
+    expect(!store.get(STORE_KEY_EFFECT, v), "nothing stored at first");
+  }
+
+  // Restart after every few changes; every value should come back as last set.
+  uint32_t truth[STORE_KEYS] = {};
+  uint32_t rand = 1;
+  for (uint16_t restart = 0; restart < CHECK_RESTARTS; restart++) {
+    StateStore store(&flash);
+    expect(store.begin(), "starts", restart);
+    for (uint8_t k = 0; restart > 0 && k < STORE_KEYS; k++) {
+      expect(store.get((store_key_t)k, v) && v == truth[k], "value restored", restart);
+    }
+    if (restart == 0) {
+      for (uint8_t k = 0; k < STORE_KEYS; k++) {
+        store.set((store_key_t)k, truth[k] = k, now);
+      }
+    }
+    for (uint8_t i = 0; i < 5; i++) {
+      rand = rand * 1103515245 + 12345;
+      uint8_t k = (rand >> 16) % STORE_KEYS;
+      store.set((store_key_t)k, truth[k] = rand, now);
+      now += 100;
+      loopStore(store, flash, now, restart);
+    }
+    now += STORE_SETTLE_MS;
+    loopStore(store, flash, now, restart);
+    // Frames carry on after the write, with time to erase ahead.
+    for (uint8_t i = 0; i < 4; i++) {
+      now += 10;
+      loopStore(store, flash, now, restart);
+    }
+  }
+  uint32_t least = flash.erases[0], most = flash.erases[0];
+  for (auto e : flash.erases) {
+    least = min(least, e);
+    most = max(most, e);
+  }
+  printf("Erases per sector after %u restarts: %u to %u\n", CHECK_RESTARTS, (unsigned)least, (unsigned)most);
+  expect(most - least <= 1, "erases spread evenly");
+
+  // A torn write loses the value being written, and nothing else.
+  {
+    StateStore store(&flash);
+    store.begin();
+    flash.tearAt = flash.writes;
+    store.set(STORE_KEY_COLOR, 0x123456, now);
+    now += STORE_SETTLE_MS;
+    store.loop(now);
+  }
+  {
+    StateStore store(&flash);
+    store.begin();
+    for (uint8_t k = 0; k < STORE_KEYS; k++) {
+      expect(store.get((store_key_t)k, v) && v == truth[k], "value kept after a torn write", k);
+    }
+    store.set(STORE_KEY_COLOR, 0xABCDEF, now);
+    now += STORE_SETTLE_MS;
+    store.loop(now);
+  }
+  {
+    StateStore store(&flash);
+    store.begin();
+    expect(store.get(STORE_KEY_COLOR, v) && v == 0xABCDEF, "written after a torn write");
+  }
+
+  // Nothing waits on a running erase.
+  {
+    StateStore store(&flash);
+    store.begin();
+    uint32_t writes = flash.writes;
+    flash.busyFor = 1;
+    store.set(STORE_KEY_ON, 9, now);
+    now += STORE_SETTLE_MS;
+    store.loop(now);
+    expect(flash.writes == writes, "nothing written while an erase runs");
+    store.loop(now);
+    expect(flash.writes == writes + 1, "written once the erase is done");
+  }
+
+  // Changes are only written once they settle.
+  {
+    uint32_t writes = flash.writes;
+    StateStore store(&flash);
+    store.begin();
+    store.set(STORE_KEY_ON, 7, now);
+    store.loop(now + STORE_SETTLE_MS - 1);
+    expect(flash.writes == writes, "unsettled change not written");
+    store.loop(now + STORE_SETTLE_MS);
+    expect(flash.writes == writes + 1, "settled change written");
+  }
+
+  printf(failures ? "%u checks failed.\n" : "ok\n", (unsigned)failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Flood the bottles with MQTT commands and report how long they took to show.
+
+Each command is timestamped as it's published and followed by an id on `cryptid/bottles/mark/set`,
+which the board echoes on `cryptid/bottles/mark/<board>` once the next frame is shown. A command's
+latency runs from its publish to the first echo of its id or a later one, so it covers the broker
+and network both ways as well as the board. The board's own figures, from a command arriving to
+the frame shown after it, are read from `cryptid/bottles/sensor/state` alongside, as the
+breakdown. Each scenario clears those stats, sends its commands, then prints both:
+
+  tools/storm.py [scenario] [broker] [port]     (needs paho-mqtt)
+
+Scenarios:
+  slider      brightness dragged back and forth, 50 messages a second
+  ha-restart  Home Assistant announcing itself repeatedly, resending discovery each time
+  mixed       effects, colors, and brightness interleaved
+  all         each of the above in turn (default)
+"""
+
+import json
+import sys
+import threading
+import time
+
+DURATION = 10
+SETTLE = 2
+EFFECTS = ["Glow", "Rainbow", "Rain", "Faeries", "Glow White"]
+
+
+class Marks:
+    """Commands published, by mark id, and when each was first seen shown."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.next_id = 0
+        self.published = {}
+        self.shown = {}
+
+    def clear(self):
+        with self.lock:
+            self.published.clear()
+            self.shown.clear()
+
+    def send(self, client, topic, payload):
+        """Publish a command, then a mark the board echoes once it's shown."""
+        with self.lock:
+            self.next_id += 1
+            mark = self.next_id
+            self.published[mark] = time.time()
+        client.publish(topic, payload)
+        client.publish("cryptid/bottles/mark/set", str(mark))
+
+    def echoed(self, mark):
+        """Every command up to an echoed mark has been shown."""
+        now = time.time()
+        with self.lock:
+            for m, t in self.published.items():
+                if m <= mark and m not in self.shown:
+                    self.shown[m] = now - t
+
+    def latencies(self):
+        """Publish to photon times in ms, and how many commands were never seen shown."""
+        with self.lock:
+            ms = sorted(t * 1000 for t in self.shown.values())
+            return ms, len(self.published) - len(ms)
+
+
+def percentile(values, pct):
+    """The value at a percentile of sorted values, or 0 if there are none."""
+    if not values:
+        return 0
+    return values[min(len(values) - 1, (len(values) * pct + 99) // 100 - 1)]
+
+
+def slider(client, marks):
+    """Brightness up and down, as a dragged slider sends it."""
+    end = time.time() + DURATION
+    b, step = 0, 5
+    while time.time() < end:
+        marks.send(client, "cryptid/bottles/brightness/set", str(b))
+        b += step
+        if b >= 255 or b <= 0:
+            step = -step
+            b = max(0, min(255, b))
+        time.sleep(1 / 50)
+
+
+def ha_restart(client, marks):
+    """Home Assistant restarting, or several of them, each asking for discovery."""
+    end = time.time() + DURATION
+    while time.time() < end:
+        client.publish("homeassistant/status", "online")
+        marks.send(client, "cryptid/bottles/brightness/set", "200")
+        time.sleep(0.5)
+
+
+def mixed(client, marks):
+    """Effect, color, and brightness changes back to back."""
+    end = time.time() + DURATION
+    n = 0
+    while time.time() < end:
+        marks.send(client, "cryptid/bottles/effect/set", EFFECTS[n % len(EFFECTS)])
+        marks.send(client, "cryptid/bottles/rgb/set", "%d,%d,%d" % ((n * 40) % 256, 128, 255 - (n * 40) % 256))
+        marks.send(client, "cryptid/bottles/brightness/set", str(64 + (n * 16) % 192))
+        n += 1
+        time.sleep(0.1)
+
+
+SCENARIOS = {"slider": slider, "ha-restart": ha_restart, "mixed": mixed}
+
+
+def main():
+    import paho.mqtt.client as mqtt
+
+    names = [sys.argv[1]] if len(sys.argv) > 1 and sys.argv[1] != "all" else list(SCENARIOS)
+    broker = sys.argv[2] if len(sys.argv) > 2 else "localhost"
+    port = int(sys.argv[3]) if len(sys.argv) > 3 else 1883
+    received = threading.Event()
+    sensors = {}
+    marks = Marks()
+
+    def on_connect(client, userdata, flags, rc, *args):
+        client.subscribe("cryptid/bottles/sensor/state")
+        client.subscribe("cryptid/bottles/mark/+")
+
+    def on_message(client, userdata, msg):
+        if msg.topic.startswith("cryptid/bottles/mark/"):
+            marks.echoed(int(msg.payload))
+            return
+        sensors.clear()
+        sensors.update(json.loads(msg.payload))
+        received.set()
+
+    def request(client, payload=""):
+        received.clear()
+        client.publish("cryptid/bottles/sensor/get", payload)
+        if not received.wait(5):
+            sys.exit("No sensors from the bottles; are they on %s:%d?" % (broker, port))
+        return dict(sensors)
+
+    client = mqtt.Client()
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(broker, port)
+    client.loop_start()
+    time.sleep(1)
+
+    print("%-11s %9s %6s %6s %6s %8s %8s %7s %8s %9s" % (
+        "scenario", "shown", "p50", "p95", "max", "board50", "board95", "worst", "dropped", "interlace"))
+    for name in names:
+        before = request(client, "reset")
+        marks.clear()
+        SCENARIOS[name](client, marks)
+        time.sleep(SETTLE)
+        after = request(client)
+        ms, unseen = marks.latencies()
+        print("%-11s %9s %4dms %4dms %4dms %6dms %6dms %5dms %8d %9d" % (
+            name,
+            "%d/%d" % (len(ms), len(ms) + unseen),
+            percentile(ms, 50),
+            percentile(ms, 95),
+            ms[-1] if ms else 0,
+            after["cmd_latency_p50"],
+            after["cmd_latency_p95"],
+            after["worst_frame"],
+            after["dropped_frames"] - before["dropped_frames"],
+            after["interlace"]))
+
+    client.loop_stop()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,141 @@
+/**
+ * @brief Stress check for a full layout on a Linux host: 8 lanes of STRESS_STRAND pixels, from
+ *        stress_layout.h. Reports the RAM and send time src/layout.h budgets for it, renders a few
+ *        effects over every pixel, and checks the last pixel of the last lane lands where NeoPXL8
+ *        sends it. See stress.sh.
+ */
+#include <chrono>
+#include <vector>
+#include "bottle.h"
+#include "palette.h"
+#include "pxl8.h"
+#include "random.h"
+#include "spatial.h"
+
+HostSerial Serial;
+
+static_assert(NEOPIXEL_NUM_PINS == 8, "The stress check needs all 8 lanes; build with NO_AIRLIFT");
+
+/**
+ * @brief Frames rendered per effect, and the time between them in ms.
+ */
+static const uint16_t STRESS_FRAMES = 240;
+static const uint32_t STRESS_FRAME_MS = 17;
+
+static SpatialMap spatialMap;
+static Palette rainPalette;
+static Palette rainbowPalette;
+
+/**
+ * @brief Failures so far.
+ */
+static uint32_t failures = 0;
+
+/**
+ * @brief Count and report a failed check.
+ *
+ * @param ok
+ * @param what
+ */
+static void expect(bool ok, const char* what) {
+  if (ok) return;
+  printf("FAILED: %s\n", what);
+  failures++;
+}
+
+/**
+ * @brief Bottles over the whole layout, as setup() adds them.
+ */
+class Run {
+  public:
+    Pxl8 pxl8;
+    TweenPool tweens;
+    RandomStreams streams;
+    FrameContext frame;
+    std::vector<Bottle*> bottles;
+
+    Run(void) : frame(&streams.get(RANDOM_FRAME), &tweens) {
+      for (size_t i = 0; i < LAYOUT_BOTTLES; i++) {
+        const bottle_layout_t& b = BOTTLE_LAYOUT[i];
+        bottles.push_back(new Bottle(&pxl8, b.pin, b.start, b.length, i));
+        bottles[i]->setCoords(spatialMap.bottle(i));
+      }
+      pxl8.init();
+      streams.seed(1);
+      for (auto & bottle : bottles) bottle->setHue(200, 240);
+    }
+
+    ~Run() {
+      for (auto & bottle : bottles) {
+        delete bottle;
+      }
+    }
+};
+
+/**
+ * @brief Render an effect and commit each frame, and report the time taken per frame.
+ *
+ * @param name
+ * @param palette
+ * @param render
+ */
+static void renderEffect(const char* name, const Palette* palette, void (*render)(Run& run)) {
+  Run* run = new Run();
+  auto start = std::chrono::steady_clock::now();
+  for (uint16_t f = 0; f < STRESS_FRAMES; f++) {
+    run->frame.advance(f * STRESS_FRAME_MS);
+    run->tweens.update(run->frame.time);
+    run->pxl8.setPalette(palette);
+    render(*run);
+    run->pxl8.show();
+  }
+  std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - start;
+  printf("  %-8s %7.1f us per frame on this host\n", name, took.count() / STRESS_FRAMES);
+  delete run;
+}
+
+int main(void) {
+  spatialMap.begin();
+  rainPalette.ramp(rgb_t{ 2, 160, 255 });
+  rainbowPalette.hues();
+
+  uint32_t ram = LAYOUT_PIXEL_RAM + sizeof(SpatialMap);
+  printf("8 lanes of %u pixels, %u bottles\n", (unsigned)LAYOUT_LONGEST_STRAND, (unsigned)LAYOUT_BOTTLES);
+  printf("  pixel RAM %u B (%u B per pixel per lane) + spatial map %u B = %u B of %u B\n",
+    (unsigned)LAYOUT_PIXEL_RAM, (unsigned)(LAYOUT_PIXEL_RAM / LAYOUT_LONGEST_STRAND),
+    (unsigned)sizeof(SpatialMap), (unsigned)ram, (unsigned)PIXEL_RAM_BUDGET);
+  printf("  send %.1f ms per frame, at most %.0f fps\n", LAYOUT_FRAME_US / 1000.0,
+    1000000.0 / LAYOUT_FRAME_US);
+
+  renderEffect("glow", nullptr, [](Run& run) {
+    for (auto & b : run.bottles) b->glow(run.frame);
+  });
+  renderEffect("rain", &rainPalette, [](Run& run) {
+    for (auto & b : run.bottles) b->rain(run.frame);
+  });
+  renderEffect("rainbow", &rainbowPalette, [](Run& run) {
+    for (auto & b : run.bottles) b->rainbow(run.frame);
+  });
+
+  // Only the last bottle lit: its last pixel is the last in NeoPXL8's buffer, and nothing before
+  // the bottle is touched.
+  Run* run = new Run();
+  run->bottles.back()->illuminate(rgb_t{ 255, 255, 255 });
+  run->pxl8.show();
+  const uint8_t* p = run->pxl8.committedFrame();
+  uint32_t stride = run->pxl8.longestStrand();
+  expect(stride == LAYOUT_LONGEST_STRAND, "longest strand matches the layout");
+  const bottle_layout_t& last = BOTTLE_LAYOUT[LAYOUT_BOTTLES - 1];
+  uint32_t first = last.pin * stride + last.start;
+  uint32_t end = last.pin * stride + last.start + last.length;
+  expect(end == NEOPIXEL_NUM_PINS * stride, "last bottle ends the buffer");
+  expect(p[(end - 1) * 3] && p[(end - 1) * 3 + 1] && p[(end - 1) * 3 + 2], "last pixel of lane 7 lit");
+  expect(p[first * 3] != 0, "first pixel of the last bottle lit");
+  bool dark = true;
+  for (uint32_t i = 0; i < first * 3; i++) dark = dark && p[i] == 0;
+  expect(dark, "pixels before the last bottle dark");
+  delete run;
+
+  printf(failures ? "%u checks failed.\n" : "ok\n", (unsigned)failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Build the layout stress check with the host's compiler for 8 lanes of each strand length the
+# README gives, and run it. 8 lanes of 500 pixels aren't supported, and should fail to build on
+# PIXEL_RAM_BUDGET.
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+src="$here/../../src"
+bin="${TMPDIR:-/tmp}/cryptid-stress"
+
+build() {
+  ${CXX:-g++} -std=gnu++11 -O2 -Wall -Wno-unused-function -Wno-reorder $CXXFLAGS -DNO_AIRLIFT \
+    -DLAYOUT_CONFIG='"stress_layout.h"' "$@" -I"$here/../golden/host" -I"$here" -I"$src" \
+    "$here/stress.cpp" "$src/bottle.cpp" "$src/log.cpp" "$src/noise.cpp" "$src/palette.cpp" \
+    "$src/pxl8.cpp" "$src/spatial.cpp" "$src/timeline.cpp" "$src/tween.cpp" \
+    "$src/whitebalance.cpp" "$src/zone.cpp" -o "$bin"
+}
+
+build -DSTRESS_STRAND=383
+"$bin"
+build -DSTRESS_STRAND=438 -DNO_CROSSFADE
+echo "With NO_CROSSFADE:"
+"$bin"
+if build -DSTRESS_STRAND=500 2>"$bin.log"; then
+  echo "FAILED: 8 lanes of 500 pixels built, but should be over PIXEL_RAM_BUDGET."
+  exit 1
+fi
+if ! grep -q "PIXEL_RAM_BUDGET" "$bin.log"; then
+  cat "$bin.log"
+  exit 1
+fi
+echo "8 lanes of 500 pixels: over PIXEL_RAM_BUDGET, so not supported, as expected."
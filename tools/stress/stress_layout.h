@@ -0,0 +1,35 @@
+// Layout for the stress check: all 8 lanes, each STRESS_STRAND pixels long in two bottles. See
+// stress.sh.
+#ifndef STRESS_STRAND
+#define STRESS_STRAND 383
+#endif
+
+#define STRESS_HALF (STRESS_STRAND / 2)
+
+constexpr bottle_layout_t BOTTLE_LAYOUT[] = {
+  // pin  1st          len                          x    y    z  height  wb
+  {   0,  0,           STRESS_HALF,                  60, 200,  20,    400,   0 },
+  {   0,  STRESS_HALF, STRESS_STRAND - STRESS_HALF,  60, 700,  20,    400,   0 },
+  {   1,  0,           STRESS_HALF,                 180, 200,  20,    400,   0 },
+  {   1,  STRESS_HALF, STRESS_STRAND - STRESS_HALF, 180, 700,  20,    400,   0 },
+  {   2,  0,           STRESS_HALF,                 300, 200,  20,    400,   0 },
+  {   2,  STRESS_HALF, STRESS_STRAND - STRESS_HALF, 300, 700,  20,    400,   0 },
+  {   3,  0,           STRESS_HALF,                 420, 200,  20,    400,   0 },
+  {   3,  STRESS_HALF, STRESS_STRAND - STRESS_HALF, 420, 700,  20,    400,   0 },
+  {   4,  0,           STRESS_HALF,                 540, 200,  20,    400,   0 },
+  {   4,  STRESS_HALF, STRESS_STRAND - STRESS_HALF, 540, 700,  20,    400,   0 },
+  {   5,  0,           STRESS_HALF,                 660, 200,  20,    400,   0 },
+  {   5,  STRESS_HALF, STRESS_STRAND - STRESS_HALF, 660, 700,  20,    400,   0 },
+  {   6,  0,           STRESS_HALF,                 780, 200,  20,    400,   0 },
+  {   6,  STRESS_HALF, STRESS_STRAND - STRESS_HALF, 780, 700,  20,    400,   0 },
+  {   7,  0,           STRESS_HALF,                 900, 200,  20,    400,   0 },
+  {   7,  STRESS_HALF, STRESS_STRAND - STRESS_HALF, 900, 700,  20,    400,   0 },
+};
+
+constexpr uint32_t LAYOUT_SPAN_MM = 1000;
+
+constexpr zone_layout_t ZONE_LAYOUT[] = {
+  // id       name             bottles
+  { "front", "Front Bottles", 0x5555 },
+  { "back",  "Back Bottles",  0xAAAA },
+};
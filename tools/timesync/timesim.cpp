@@ -0,0 +1,149 @@
+/**
+ * @brief Simulate time sync across boards on a Linux host. Board 0 and a few others run from
+ *        clocks with their own skew and boot time, over a network with jittery one-way delays and
+ *        occasional spikes, and each board's frame clock is compared with board 0's every frame.
+ *        See timesync.sh.
+ */
+// Before Arduino.h defines min and max.
+#include <random>
+#include "def.h"
+
+// Every simulated board is one other than 0.
+#undef BOARD_ID
+#define BOARD_ID 1
+#include "timesync.cpp"
+
+HostSerial Serial;
+
+/**
+ * @brief Seed for the network's delays.
+ */
+static const uint32_t SIM_SEED = 7;
+
+/**
+ * @brief Simulated time, and how long boards get to sync before their error counts, in us.
+ */
+static const double SIM_LENGTH_US = 3600e6;
+static const double SIM_SETTLE_US = 120e6;
+
+/**
+ * @brief Fixed one-way delay, mean jitter on top, and the chance and size of a spike, in us.
+ */
+static const double SIM_DELAY_US = 1500;
+static const double SIM_JITTER_US = 6000;
+static const double SIM_SPIKE_CHANCE = 0.05;
+static const double SIM_SPIKE_US = 100000;
+
+/**
+ * @brief A board's clock.
+ */
+typedef struct {
+  // Skew from true time, in parts per million.
+  double ppm;
+  // Clock at true time 0, in us.
+  double boot;
+} sim_clock_t;
+
+/**
+ * @brief Board 0, then the others. One wraps its millis() partway through.
+ */
+static const sim_clock_t SIM_CLOCKS[] = {
+  { 0, 123456789.0 },
+  { 95, 1e6 },
+  { -80, 5e9 },
+  { 40, (4294967296.0 - 1800000) * 1000 },
+  { 0, 7e8 },
+};
+static const uint8_t SIM_BOARDS = sizeof(SIM_CLOCKS) / sizeof(SIM_CLOCKS[0]);
+
+/**
+ * @brief A reply from board 0 on its way.
+ */
+typedef struct {
+  // True time it arrives, in us.
+  double arrives;
+  uint32_t t0;
+  uint32_t t1;
+  uint32_t t2;
+} sim_reply_t;
+
+/**
+ * @brief A board's millis() at a true time.
+ *
+ * @param c
+ * @param t true time, us
+ * @return ms
+ */
+static uint32_t simMillis(const sim_clock_t& c, double t) {
+  return (uint32_t)(uint64_t)floor((t * (1 + c.ppm * 1e-6) + c.boot) / 1000);
+}
+
+int main(void) {
+  std::mt19937 rng(SIM_SEED);
+  std::exponential_distribution<double> jitter(1 / SIM_JITTER_US);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  auto oneWay = [&](void) {
+    return SIM_DELAY_US + jitter(rng) + (uniform(rng) < SIM_SPIKE_CHANCE ? SIM_SPIKE_US : 0);
+  };
+
+  MQTT_Looped mqtt[SIM_BOARDS];
+  std::vector<TimeSync> boards;
+  for (uint8_t i = 0; i < SIM_BOARDS; i++) boards.emplace_back(&mqtt[i]);
+  std::vector<sim_reply_t> replies[SIM_BOARDS];
+  uint32_t sent[SIM_BOARDS] = {};
+  uint32_t steps[SIM_BOARDS] = {};
+  int32_t worst[SIM_BOARDS] = {};
+
+  const double frame = 1e6 / MAX_FPS;
+  for (double t = 0; t < SIM_LENGTH_US; t += frame) {
+    uint32_t master = simMillis(SIM_CLOCKS[0], t);
+    for (uint8_t i = 1; i < SIM_BOARDS; i++) {
+      const sim_clock_t& c = SIM_CLOCKS[i];
+      TimeSync& ts = boards[i];
+
+      // Replies that have arrived, timestamped when they did.
+      auto& pending = replies[i];
+      for (size_t r = 0; r < pending.size();) {
+        if (pending[r].arrives > t) {
+          r++;
+          continue;
+        }
+        ts.sample(pending[r].t0, pending[r].t1, pending[r].t2, simMillis(c, pending[r].arrives));
+        pending.erase(pending.begin() + r);
+      }
+
+      // A ping sent now is answered by board 0 when it arrives.
+      ts.loop(simMillis(c, t));
+      if (mqtt[i].sent != sent[i]) {
+        sent[i] = mqtt[i].sent;
+        uint32_t t0 = strtoul(mqtt[i].payload.c_str() + mqtt[i].payload.find(' '), nullptr, 10);
+        double received = t + oneWay();
+        double replied = received + uniform(rng) * 3000;
+        pending.push_back({ replied + oneWay(), t0, simMillis(SIM_CLOCKS[0], received),
+          simMillis(SIM_CLOCKS[0], replied) });
+      }
+
+      int32_t error = (int32_t)(ts.now(simMillis(c, t)) - master);
+      if (t < SIM_SETTLE_US) continue;
+      if (ts.stepped) steps[i]++;
+      if (abs(error) > abs(worst[i])) worst[i] = error;
+    }
+  }
+
+  int32_t limit = 1000 / MAX_FPS;
+  bool ok = true;
+  for (uint8_t i = 1; i < SIM_BOARDS; i++) {
+    // Skew is board 0's clock against this one's.
+    printf("Board %u: skew %+4.0f ppm, estimated %+6.1f ppm, round trip %3u ms, worst error %+3d ms, "
+      "%u steps\n", i, SIM_CLOCKS[0].ppm - SIM_CLOCKS[i].ppm, boards[i].skew / 1000.0, (unsigned)boards[i].delay,
+      (int)worst[i], (unsigned)steps[i]);
+    if (abs(worst[i]) > limit || steps[i]) ok = false;
+  }
+  if (!ok) {
+    printf("FAILED: a board strayed more than a frame (%d ms) after %.0f s.\n", (int)limit,
+      SIM_SETTLE_US / 1e6);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,9 @@
+#!/bin/sh
+# Build the multi-board time sync simulation with the host's compiler and run it.
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+src="$here/../../src"
+bin="${TMPDIR:-/tmp}/cryptid-timesim"
+${CXX:-g++} -std=gnu++11 -O2 -Wall $CXXFLAGS -I"$here/../golden/host" -I"$src" \
+  "$here/timesim.cpp" "$src/log.cpp" -o "$bin"
+exec "$bin"
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Draw the bottles from the framebuffer streamed over MQTT.
+
+Turn streaming on with FRAME_STREAM defined in src/def.h and a message of `ON` to
+`cryptid/bottles/stream/set`, then:
+
+  tools/viewer.py [broker] [port]     (needs paho-mqtt)
+"""
+
+import base64
+import json
+import struct
+import sys
+import tkinter
+
+HEADER = struct.Struct("<cBHBHB")
+PIXEL = 10
+GAP = 24
+
+
+class Frame:
+    """Framebuffer as decoded from the stream."""
+
+    def __init__(self):
+        self.pins = 0
+        self.strand = 0
+        self.brightness = 255
+        self.pixels = []
+        self.sequence = None
+        self.lost = 0
+
+    def apply(self, payload):
+        """Apply one encoded frame. See src/stream.h for the format."""
+        data = base64.b64decode(payload)
+        _, kind, sequence, pins, strand, brightness = HEADER.unpack_from(data)
+        keyframe = kind == ord("K")
+        if keyframe or (pins, strand) != (self.pins, self.strand):
+            self.pins, self.strand = pins, strand
+            self.pixels = [0] * (pins * strand)
+        if self.sequence is not None and (sequence - self.sequence) & 0xFFFF != 1:
+            self.lost += 1
+        self.sequence = sequence
+        self.brightness = brightness
+        i, o = 0, HEADER.size
+        while o < len(data):
+            token = data[o]
+            o += 1
+            count = (token & 0x3F) + 1
+            if token < 0x80:
+                i += token + 1
+            elif token < 0xC0:
+                color = int.from_bytes(data[o:o + 3], "big")
+                o += 3
+                self.pixels[i:i + count] = [color] * count
+                i += count
+            else:
+                for _ in range(count):
+                    self.pixels[i] = int.from_bytes(data[o:o + 3], "big")
+                    o += 3
+                    i += 1
+
+    def screen_color(self, pin, pixel):
+        """Pixel as seen: brightness applied, gamma undone for the screen."""
+        c = self.pixels[pin * self.strand + pixel]
+        scale = (self.brightness + 1) / 256
+        channels = ((c >> 16) & 0xFF, (c >> 8) & 0xFF, c & 0xFF)
+        return "#%02x%02x%02x" % tuple(int(255 * (v * scale / 255) ** (1 / 2.6)) for v in channels)
+
+
+class Viewer:
+    def __init__(self, root):
+        self.canvas = tkinter.Canvas(root, width=640, height=400, background="black")
+        self.canvas.pack(fill="both", expand=True)
+        self.frame = Frame()
+        self.bottles = []
+
+    def layout(self, payload):
+        self.bottles = json.loads(payload)["bottles"]
+
+    def draw(self):
+        self.canvas.delete("all")
+        # Without a layout, draw each strand as one bottle.
+        bottles = self.bottles or [[p, 0, self.frame.strand] for p in range(self.frame.pins)]
+        x = GAP
+        for pin, start, length in bottles:
+            if pin >= self.frame.pins:
+                continue
+            for n in range(length):
+                y = GAP + (length - n - 1) * PIXEL
+                color = self.frame.screen_color(pin, start + n)
+                self.canvas.create_rectangle(x, y, x + PIXEL, y + PIXEL, fill=color, width=0)
+            self.canvas.create_text(x + PIXEL / 2, GAP / 2, text=str(pin), fill="gray")
+            x += PIXEL + GAP
+        self.canvas.create_text(GAP, 390, anchor="w", fill="gray",
+                                text="frame %s, lost %d" % (self.frame.sequence, self.frame.lost))
+
+
+def main():
+    import paho.mqtt.client as mqtt
+
+    broker = sys.argv[1] if len(sys.argv) > 1 else "localhost"
+    port = int(sys.argv[2]) if len(sys.argv) > 2 else 1883
+    root = tkinter.Tk()
+    root.title("Cryptid Bottles")
+    viewer = Viewer(root)
+
+    def on_connect(client, userdata, flags, rc, *args):
+        client.subscribe("cryptid/bottles/stream/#")
+
+    def on_message(client, userdata, msg):
+        # Hand off to the UI thread.
+        if msg.topic == "cryptid/bottles/stream/layout":
+            root.after(0, viewer.layout, msg.payload)
+        elif msg.topic == "cryptid/bottles/stream":
+            root.after(0, lambda: (viewer.frame.apply(msg.payload), viewer.draw()))
+
+    client = mqtt.Client()
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(broker, port)
+    client.loop_start()
+    root.mainloop()
+
+
+if __name__ == "__main__":
+    main()